@@ -0,0 +1,166 @@
+#include <cstring>
+#include <algorithm>
+
+#include "debug.hpp"
+#include "batch.hpp"
+
+// NOTE: the same SPIR-V code, even if mapped twice.
+static bool same_code(const nv::vulkan::spirv &x, const nv::vulkan::spirv &y)
+{
+	return (&x == &y)
+	    || ((x.hash == y.hash) && (x.size == y.size) && (std::memcmp(x.data, y.data, x.size) == 0));
+}
+
+// NOTE: pipelines only differing by their fixed function state, told by the
+// content of their shaders rather than by the handles of their modules and
+// layouts, which pipelines need not share.
+static bool is_variant(const nv::vulkan::pipeline &x, const nv::vulkan::pipeline &y)
+{
+	if ((x.setup.subpass != y.setup.subpass)
+	 || (x.setup.renderPass != y.setup.renderPass)
+	 || (x.stage.size() != y.stage.size())) return false;
+
+	for (size_t n = 0; n < x.stage.size(); ++n)
+	{
+		if ((x.stage[n].stage != y.stage[n].stage)
+		 || !same_code(*x.code[n], *y.code[n])
+		 || !(x.constants[n] == y.constants[n])
+		 || (std::strcmp(x.stage[n].pName, y.stage[n].pName) != 0)) return false;
+	}
+
+	return true;
+}
+
+// NOTE: creates every pipeline of the list in slices, one slice per job.
+static void create_slices(const nv::vulkan::device &d, VkPipelineCache cache, nv::workers &w,
+                          const std::vector<nv::vulkan::pipeline*> &list)
+{
+	if (list.size() == 0) return;
+
+	std::vector<VkPipeline> handle(list.size(), VK_NULL_HANDLE);
+	std::vector<VkGraphicsPipelineCreateInfo> info(list.size());
+
+	for (size_t n = 0; n < list.size(); ++n)
+	{
+		list[n]->prepare();
+		info[n] = list[n]->setup;
+	}
+
+	const uint32_t count = std::min<uint32_t>(w.size(), list.size());
+	const uint32_t length = (list.size() + count - 1)/count;
+
+	w.run(count, [&](const uint32_t t)
+	{
+		const size_t first = t*length;
+		const size_t last = std::min<size_t>(first + length, list.size());
+
+		if (first >= last) return;
+
+		VkResult error = vkCreateGraphicsPipelines(d.handle, cache, last - first,
+		                                           &info[first], nullptr, &handle[first]);
+		NV_VULKAN_ERROR("vkCreateGraphicsPipelines()", error)
+	});
+
+	for (size_t n = 0; n < list.size(); ++n)
+	{
+		list[n]->cache = cache;
+		list[n]->handle = handle[n];
+		list[n]->store_variant();
+	}
+}
+
+nv::vulkan::pipeline_batch::pipeline_batch()
+{
+}
+
+void nv::vulkan::pipeline_batch::add(nv::vulkan::pipeline &p)
+{
+	ASSERT(p.handle == nullptr)
+	ASSERT(!p.is_compute())
+
+	this->list.push_back(&p);
+}
+
+uint32_t nv::vulkan::pipeline_batch::size() const
+{
+	return this->list.size();
+}
+
+uint32_t nv::vulkan::pipeline_batch::derivative_count() const
+{
+	return std::count_if(this->parent.begin(), this->parent.end(), [](const int32_t p) { return p >= 0; });
+}
+
+void nv::vulkan::pipeline_batch::create(const nv::vulkan::device &d, VkPipelineCache cache, nv::workers &w)
+{
+	ASSERT(d.handle != nullptr)
+
+	// Each pipeline becomes a derivative of the first compatible parent:
+
+	this->parent.assign(this->list.size(), -1);
+
+	std::vector<nv::vulkan::pipeline*> base;
+	std::vector<nv::vulkan::pipeline*> derived;
+
+	for (size_t n = 0; n < this->list.size(); ++n)
+	{
+		for (size_t m = 0; m < n; ++m)
+		{
+			if ((this->parent[m] < 0) && is_variant(*this->list[m], *this->list[n]))
+			{
+				this->parent[n] = m;
+				break;
+			}
+		}
+	}
+
+	for (size_t n = 0; n < this->list.size(); ++n)
+	{
+		nv::vulkan::pipeline &p = *this->list[n];
+
+		p.setup.basePipelineIndex = -1;
+		p.setup.basePipelineHandle = VK_NULL_HANDLE;
+		p.setup.flags &= ~(VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | VK_PIPELINE_CREATE_DERIVATIVE_BIT);
+
+		if (this->parent[n] < 0)
+			base.push_back(&p);
+		else
+		{
+			this->list[this->parent[n]]->setup.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+			p.setup.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			derived.push_back(&p);
+		}
+	}
+
+	// NOTE: derivatives reference their parent by handle rather than by index,
+	// since parents and derivatives go to different calls.
+
+	create_slices(d, cache, w, base);
+
+	for (size_t n = 0; n < this->list.size(); ++n)
+	{
+		if (this->parent[n] >= 0)
+			this->list[n]->setup.basePipelineHandle = this->list[this->parent[n]]->handle;
+	}
+
+	create_slices(d, cache, w, derived);
+
+	// NOTE: the variants created later on their own derive from nothing.
+
+	for (auto p : this->list)
+	{
+		p->setup.basePipelineIndex = -1;
+		p->setup.basePipelineHandle = VK_NULL_HANDLE;
+		p->setup.flags &= ~(VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | VK_PIPELINE_CREATE_DERIVATIVE_BIT);
+	}
+}
+
+void nv::vulkan::pipeline_batch::clear()
+{
+	this->list.clear();
+	this->parent.clear();
+}
+
+nv::vulkan::pipeline_batch::~pipeline_batch()
+{
+}
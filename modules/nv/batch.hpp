@@ -0,0 +1,40 @@
+#if !defined(NV_BATCH_HEADER)
+	#define NV_BATCH_HEADER
+	#include <vector>
+
+	#include "vulkan.hpp"
+	#include "workers.hpp"
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a set of graphics pipelines created at once. Pipelines that only
+			// differ from an earlier one of the batch in fixed function state (same
+			// shader stages, layout and render pass) become its derivatives. Parents
+			// are created first, then derivatives, each step split in slices among
+			// the threads of a nv::workers with a single vkCreateGraphicsPipelines()
+			// call per slice.
+
+			struct pipeline_batch
+			{
+				pipeline_batch();
+
+				void add(nv::vulkan::pipeline &p);
+
+				uint32_t size() const;
+
+				uint32_t derivative_count() const;
+
+				void create(const nv::vulkan::device &d, VkPipelineCache cache, nv::workers &w);
+
+				void clear();
+
+				~pipeline_batch();
+
+				std::vector<nv::vulkan::pipeline*> list;
+				std::vector<int32_t> parent;
+			};
+		}
+	}
+#endif
@@ -0,0 +1,213 @@
+#include <cstdio>
+#include <cstring>
+
+#include "debug.hpp"
+#include "cache.hpp"
+
+#define NV_PIPELINE_CACHE_MAGIC 0x4350564E
+#define NV_PIPELINE_CACHE_VERSION 1
+
+// NOTE: FNV-1a, enough to detect a truncated or otherwise damaged file.
+static uint64_t checksum(const uint8_t *data, const size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (size_t n = 0; n < size; ++n)
+	{
+		hash ^= data[n];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &data)
+{
+	FILE *input = std::fopen(path.c_str(), "rb");
+
+	if (input == nullptr) return false;
+
+	std::fseek(input, 0, SEEK_END);
+	const long size = std::ftell(input);
+	std::fseek(input, 0, SEEK_SET);
+
+	if (size > 0)
+	{
+		data.resize(size);
+		data.resize(std::fread(data.data(), 1, size, input));
+	}
+
+	std::fclose(input);
+	return (size > 0) && (data.size() == static_cast<size_t>(size));
+}
+
+nv::vulkan::pipeline_cache::pipeline_cache():
+	warm(false),
+	loaded(0),
+	handle(nullptr)
+{
+	this->setup.flags = 0;
+	this->setup.pNext = nullptr;
+	this->setup.initialDataSize = 0;
+	this->setup.pInitialData = nullptr;
+	this->setup.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	std::memset(&this->signature, 0, sizeof(header));
+}
+
+void nv::vulkan::pipeline_cache::create(const nv::vulkan::device &d,
+                                        const nv::vulkan::physical_device &pd,
+                                        const uint32_t index,
+                                        const std::string &directory)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(index < pd.properties.size())
+
+	const VkPhysicalDeviceProperties &p = pd.properties[index];
+
+	this->signature.magic = NV_PIPELINE_CACHE_MAGIC;
+	this->signature.version = NV_PIPELINE_CACHE_VERSION;
+	this->signature.vendor = p.vendorID;
+	this->signature.device = p.deviceID;
+	this->signature.driver = p.driverVersion;
+	std::memcpy(this->signature.uuid, p.pipelineCacheUUID, VK_UUID_SIZE);
+
+	char name[64];
+	std::snprintf(name, sizeof(name), "/nv_pipeline_%08x_%08x.cache", p.vendorID, p.deviceID);
+	this->path = directory + name;
+
+	// Loading of a previous cache, if any and if built by this very driver:
+
+	std::vector<uint8_t> data;
+
+	this->warm = false;
+
+	if (read_file(this->path, data) && (data.size() > sizeof(header)))
+	{
+		header h;
+		std::memcpy(&h, data.data(), sizeof(header));
+
+		const uint8_t *body = data.data() + sizeof(header);
+		const size_t length = data.size() - sizeof(header);
+
+		this->warm = (h.magic == this->signature.magic)
+		          && (h.version == this->signature.version)
+		          && (h.vendor == this->signature.vendor)
+		          && (h.device == this->signature.device)
+		          && (h.driver == this->signature.driver)
+		          && (std::memcmp(h.uuid, this->signature.uuid, VK_UUID_SIZE) == 0)
+		          && (h.size == length)
+		          && (h.checksum == checksum(body, length));
+
+		// NOTE: Vulkan validates its own header as well, but some drivers are
+		// known to crash on stale data rather than to ignore it.
+
+		VkPipelineCacheHeaderVersionOne inner;
+
+		if (this->warm && (length >= sizeof(inner)))
+		{
+			std::memcpy(&inner, body, sizeof(inner));
+
+			this->warm = (inner.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+			          && (inner.vendorID == p.vendorID)
+			          && (inner.deviceID == p.deviceID)
+			          && (std::memcmp(inner.pipelineCacheUUID, p.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+		}
+		else
+			this->warm = false;
+
+		if (this->warm)
+		{
+			this->setup.initialDataSize = length;
+			this->setup.pInitialData = body;
+		}
+		else
+			PRINT_ERROR("warning: discarding the stale pipeline cache %s\n", this->path.c_str())
+	}
+
+	VkResult error = vkCreatePipelineCache(d.handle, &this->setup, nullptr, &this->handle);
+	NV_VULKAN_ERROR("vkCreatePipelineCache()", error)
+
+	this->loaded = this->setup.initialDataSize;
+	this->setup.initialDataSize = 0;
+	this->setup.pInitialData = nullptr;
+}
+
+bool nv::vulkan::pipeline_cache::is_warm() const
+{
+	return this->warm;
+}
+
+bool nv::vulkan::pipeline_cache::save(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(this->handle != nullptr)
+
+	size_t size = 0;
+
+	VkResult error = vkGetPipelineCacheData(d.handle, this->handle, &size, nullptr);
+	NV_VULKAN_ERROR("vkGetPipelineCacheData()", error)
+
+	// NOTE: a cache never shrinks, thus the same size means no new pipelines.
+	if ((size == 0) || (this->warm && (size == this->loaded))) return true;
+
+	std::vector<uint8_t> data(sizeof(header) + size);
+
+	error = vkGetPipelineCacheData(d.handle, this->handle, &size, data.data() + sizeof(header));
+	NV_VULKAN_ERROR("vkGetPipelineCacheData()", error)
+
+	data.resize(sizeof(header) + size);
+
+	this->signature.size = size;
+	this->signature.checksum = checksum(data.data() + sizeof(header), size);
+	std::memcpy(data.data(), &this->signature, sizeof(header));
+
+	// NOTE: written to a temporary file first and then renamed, thus a crash
+	// midway never leaves a partial cache behind.
+
+	const std::string temporary = this->path + ".tmp";
+
+	FILE *output = std::fopen(temporary.c_str(), "wb");
+
+	if (output == nullptr)
+	{
+		PRINT_ERROR("warning: unable to write the pipeline cache %s\n", temporary.c_str())
+		return false;
+	}
+
+	const bool written = (std::fwrite(data.data(), 1, data.size(), output) == data.size())
+	                  && (std::fflush(output) == 0);
+
+	std::fclose(output);
+
+	if (!written || (std::rename(temporary.c_str(), this->path.c_str()) != 0))
+	{
+		PRINT_ERROR("warning: unable to write the pipeline cache %s\n", this->path.c_str())
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	this->warm = true;
+	this->loaded = size;
+
+	return true;
+}
+
+void nv::vulkan::pipeline_cache::destroy(const nv::vulkan::device &d)
+{
+	if (this->handle == nullptr) return;
+
+	ASSERT(d.handle != nullptr)
+
+	vkDestroyPipelineCache(d.handle, this->handle, nullptr);
+	this->handle = nullptr;
+}
+
+nv::vulkan::pipeline_cache::~pipeline_cache()
+{
+	if (this->handle != nullptr)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::pipeline_cache instance before calling nv::vulkan::pipeline_cache::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,59 @@
+#if !defined(NV_CACHE_HEADER)
+	#define NV_CACHE_HEADER
+	#include <string>
+	#include <vector>
+
+	#include "vulkan.hpp"
+
+	#if !defined(NV_PIPELINE_CACHE_DIRECTORY)
+		#define NV_PIPELINE_CACHE_DIRECTORY "."
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a pipeline cache stored on disk in between runs. The file starts
+			// with a header of its own that records the device it was built by, so
+			// a cache from another driver (or driver version) is discarded rather
+			// than handed over to Vulkan.
+
+			struct pipeline_cache
+			{
+				struct header
+				{
+					uint32_t magic;
+					uint32_t version;
+					uint32_t vendor;
+					uint32_t device;
+					uint32_t driver;
+					uint8_t uuid[VK_UUID_SIZE];
+					uint64_t size;
+					uint64_t checksum;
+				};
+
+				pipeline_cache();
+
+				void create(const nv::vulkan::device &d,
+				            const nv::vulkan::physical_device &pd,
+				            const uint32_t index,
+				            const std::string &directory = NV_PIPELINE_CACHE_DIRECTORY);
+
+				bool is_warm() const;
+
+				bool save(const nv::vulkan::device &d);
+
+				void destroy(const nv::vulkan::device &d);
+
+				~pipeline_cache();
+
+				bool warm;
+				size_t loaded;
+				std::string path;
+				header signature;
+				VkPipelineCache handle;
+				VkPipelineCacheCreateInfo setup;
+			};
+		}
+	}
+#endif
@@ -25,6 +25,15 @@
 	  }                                               \
 	}
 
+	#define NV_VULKAN_ERROR(name, code)                                 \
+	{                                                                   \
+	  if (code != VK_SUCCESS)                                           \
+	  {                                                                 \
+	    PRINT_ERROR("%s failed with error code %d\n", name, (int) code) \
+	    exit(EXIT_FAILURE);                                             \
+	  }                                                                 \
+	}
+
 	#define AS_STRING(macro) #macro
 
 	#define PRINT_MACRO(macro) AS_STRING(macro)
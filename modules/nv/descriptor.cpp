@@ -0,0 +1,512 @@
+#include <algorithm>
+
+#include "debug.hpp"
+#include "descriptor.hpp"
+
+// NOTE: FNV-1a over the fields that tell two entries apart, collisions being
+// resolved by a comparison of the whole entries.
+
+static uint64_t mix(uint64_t hash, const uint64_t value)
+{
+	for (uint32_t n = 0; n < 8; ++n)
+	{
+		hash ^= (value >> (8*n)) & 0xFF;
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static uint64_t handle_bits(const void *h)
+{
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(h));
+}
+
+static bool is_same(const VkDescriptorSetLayoutBinding &x, const VkDescriptorSetLayoutBinding &y)
+{
+	return (x.binding == y.binding) && (x.descriptorType == y.descriptorType)
+	    && (x.descriptorCount == y.descriptorCount) && (x.stageFlags == y.stageFlags)
+	    && (x.pImmutableSamplers == y.pImmutableSamplers);
+}
+
+//
+// nv::vulkan::descriptor_binding
+//
+
+nv::vulkan::descriptor_binding::descriptor_binding(const uint32_t binding, const VkDescriptorType type,
+                                                   VkBuffer b, const VkDeviceSize offset, const VkDeviceSize range):
+	binding(binding),
+	type(type)
+{
+	this->buffer.buffer = b;
+	this->buffer.offset = offset;
+	this->buffer.range = range;
+
+	this->image.sampler = VK_NULL_HANDLE;
+	this->image.imageView = VK_NULL_HANDLE;
+	this->image.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+nv::vulkan::descriptor_binding::descriptor_binding(const uint32_t binding, const VkDescriptorType type,
+                                                   VkImageView v, VkSampler s, const VkImageLayout layout):
+	binding(binding),
+	type(type)
+{
+	this->buffer.buffer = VK_NULL_HANDLE;
+	this->buffer.offset = 0;
+	this->buffer.range = 0;
+
+	this->image.sampler = s;
+	this->image.imageView = v;
+	this->image.imageLayout = layout;
+}
+
+bool nv::vulkan::descriptor_binding::is_image() const
+{
+	return (this->type == VK_DESCRIPTOR_TYPE_SAMPLER)
+	    || (this->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+	    || (this->type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE)
+	    || (this->type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+	    || (this->type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+}
+
+bool nv::vulkan::descriptor_binding::operator ==(const descriptor_binding &other) const
+{
+	return (this->binding == other.binding) && (this->type == other.type)
+	    && (this->buffer.buffer == other.buffer.buffer)
+	    && (this->buffer.offset == other.buffer.offset)
+	    && (this->buffer.range == other.buffer.range)
+	    && (this->image.sampler == other.image.sampler)
+	    && (this->image.imageView == other.image.imageView)
+	    && (this->image.imageLayout == other.image.imageLayout);
+}
+
+//
+// nv::vulkan::descriptor_layout_cache
+//
+
+nv::vulkan::descriptor_layout_cache::descriptor_layout_cache():
+	count(0)
+{
+	this->setup.flags = 0;
+	this->setup.pNext = nullptr;
+	this->setup.bindingCount = 0;
+	this->setup.pBindings = nullptr;
+	this->setup.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+}
+
+VkDescriptorSetLayout nv::vulkan::descriptor_layout_cache::get(const nv::vulkan::device &d,
+                                                               const std::vector<VkDescriptorSetLayoutBinding> &binding)
+{
+	ASSERT(d.handle != nullptr)
+
+	// NOTE: the order of the bindings does not matter to Vulkan, thus they
+	// are sorted to share a layout between lists that only differ by it.
+
+	std::vector<VkDescriptorSetLayoutBinding> sorted(binding);
+
+	std::sort(sorted.begin(), sorted.end(),
+		[](const VkDescriptorSetLayoutBinding &x, const VkDescriptorSetLayoutBinding &y) { return x.binding < y.binding; });
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (const auto &b : sorted)
+	{
+		hash = mix(hash, b.binding);
+		hash = mix(hash, b.descriptorType);
+		hash = mix(hash, b.descriptorCount);
+		hash = mix(hash, b.stageFlags);
+		hash = mix(hash, handle_bits(b.pImmutableSamplers));
+	}
+
+	auto &bucket = this->table[hash];
+
+	for (const auto &e : bucket)
+		if (std::equal(e.binding.begin(), e.binding.end(), sorted.begin(), sorted.end(), is_same))
+			return e.handle;
+
+	entry e;
+
+	this->setup.bindingCount = sorted.size();
+	this->setup.pBindings = sorted.data();
+
+	const VkResult error = vkCreateDescriptorSetLayout(d.handle, &this->setup, nullptr, &e.handle);
+	NV_VULKAN_ERROR("vkCreateDescriptorSetLayout()", error)
+
+	this->setup.bindingCount = 0;
+	this->setup.pBindings = nullptr;
+
+	e.binding.swap(sorted);
+	bucket.push_back(std::move(e));
+
+	++this->count;
+	return bucket.back().handle;
+}
+
+uint32_t nv::vulkan::descriptor_layout_cache::size() const
+{
+	return this->count;
+}
+
+void nv::vulkan::descriptor_layout_cache::destroy(const nv::vulkan::device &d)
+{
+	if (this->count == 0) return;
+
+	ASSERT(d.handle != nullptr)
+
+	for (const auto &bucket : this->table)
+		for (const auto &e : bucket.second)
+			vkDestroyDescriptorSetLayout(d.handle, e.handle, nullptr);
+
+	this->table.clear();
+	this->count = 0;
+}
+
+nv::vulkan::descriptor_layout_cache::~descriptor_layout_cache()
+{
+	if (this->count > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::descriptor_layout_cache instance before calling nv::vulkan::descriptor_layout_cache::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
+//
+// nv::vulkan::pipeline_layout_cache
+//
+
+nv::vulkan::pipeline_layout_cache::pipeline_layout_cache():
+	count(0)
+{
+}
+
+VkPipelineLayout nv::vulkan::pipeline_layout_cache::get(const nv::vulkan::device &d, const nv::vulkan::layout &l)
+{
+	ASSERT(d.handle != nullptr)
+
+	const auto same_range = [](const VkPushConstantRange &x, const VkPushConstantRange &y)
+	{
+		return (x.stageFlags == y.stageFlags) && (x.offset == y.offset) && (x.size == y.size);
+	};
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (const auto s : l.sets)
+		hash = mix(hash, handle_bits(s));
+
+	for (const auto &r : l.ranges)
+	{
+		hash = mix(hash, r.stageFlags);
+		hash = mix(hash, r.offset);
+		hash = mix(hash, r.size);
+	}
+
+	auto &bucket = this->table[hash];
+
+	for (const auto &e : bucket)
+		if ((e.sets == l.sets) && std::equal(e.ranges.begin(), e.ranges.end(), l.ranges.begin(), l.ranges.end(), same_range))
+			return e.handle;
+
+	entry e;
+
+	e.sets = l.sets;
+	e.ranges = l.ranges;
+
+	VkPipelineLayoutCreateInfo setup = l.setup;
+
+	setup.setLayoutCount = e.sets.size();
+	setup.pSetLayouts = e.sets.data();
+	setup.pushConstantRangeCount = e.ranges.size();
+	setup.pPushConstantRanges = e.ranges.data();
+
+	const VkResult error = vkCreatePipelineLayout(d.handle, &setup, nullptr, &e.handle);
+	NV_VULKAN_ERROR("vkCreatePipelineLayout()", error)
+
+	bucket.push_back(std::move(e));
+
+	++this->count;
+	return bucket.back().handle;
+}
+
+uint32_t nv::vulkan::pipeline_layout_cache::size() const
+{
+	return this->count;
+}
+
+void nv::vulkan::pipeline_layout_cache::destroy(const nv::vulkan::device &d)
+{
+	if (this->count == 0) return;
+
+	ASSERT(d.handle != nullptr)
+
+	for (const auto &bucket : this->table)
+		for (const auto &e : bucket.second)
+			vkDestroyPipelineLayout(d.handle, e.handle, nullptr);
+
+	this->table.clear();
+	this->count = 0;
+}
+
+nv::vulkan::pipeline_layout_cache::~pipeline_layout_cache()
+{
+	if (this->count > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::pipeline_layout_cache instance before calling nv::vulkan::pipeline_layout_cache::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
+//
+// nv::vulkan::descriptor_allocator
+//
+
+nv::vulkan::descriptor_allocator::descriptor_allocator():
+	capacity(0)
+{
+	// NOTE: descriptors of each type per set, a guess that only affects how
+	// soon a pool runs out.
+
+	this->ratio =
+	{
+		{VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1},
+		{VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+		{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1}
+	};
+
+	this->setup.flags = 0;
+	this->setup.pNext = nullptr;
+	this->setup.maxSets = 0;
+	this->setup.poolSizeCount = 0;
+	this->setup.pPoolSizes = nullptr;
+	this->setup.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+
+	this->info.pNext = nullptr;
+	this->info.descriptorSetCount = 1;
+	this->info.pSetLayouts = nullptr;
+	this->info.descriptorPool = nullptr;
+	this->info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+}
+
+void nv::vulkan::descriptor_allocator::create(const nv::vulkan::device &d, const uint32_t frames,
+                                              const uint32_t sets)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(frames > 0)
+	ASSERT(sets > 0)
+
+	this->capacity = sets;
+	this->used.assign(frames, {});
+}
+
+VkDescriptorPool nv::vulkan::descriptor_allocator::grow(const nv::vulkan::device &d)
+{
+	if (this->spare.size() > 0)
+	{
+		VkDescriptorPool p = this->spare.back();
+		this->spare.pop_back();
+		return p;
+	}
+
+	this->size = this->ratio;
+
+	for (auto &s : this->size)
+		s.descriptorCount *= this->capacity;
+
+	this->setup.maxSets = this->capacity;
+	this->setup.poolSizeCount = this->size.size();
+	this->setup.pPoolSizes = this->size.data();
+
+	VkDescriptorPool p = VK_NULL_HANDLE;
+
+	const VkResult error = vkCreateDescriptorPool(d.handle, &this->setup, nullptr, &p);
+	NV_VULKAN_ERROR("vkCreateDescriptorPool()", error)
+
+	this->capacity = std::min<uint32_t>(2*this->capacity, NV_DESCRIPTOR_POOL_MAX_SIZE);
+	return p;
+}
+
+VkDescriptorSet nv::vulkan::descriptor_allocator::allocate(const nv::vulkan::device &d, const uint32_t n,
+                                                           VkDescriptorSetLayout l)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(n < this->used.size())
+	ASSERT(l != nullptr)
+
+	auto &pools = this->used[n];
+
+	if (pools.empty()) pools.push_back(this->grow(d));
+
+	VkDescriptorSet s = VK_NULL_HANDLE;
+
+	this->info.pSetLayouts = &l;
+	this->info.descriptorPool = pools.back();
+
+	VkResult error = vkAllocateDescriptorSets(d.handle, &this->info, &s);
+
+	// NOTE: a full pool is only left behind, it is reused after its reset.
+
+	if ((error == VK_ERROR_OUT_OF_POOL_MEMORY) || (error == VK_ERROR_FRAGMENTED_POOL))
+	{
+		pools.push_back(this->grow(d));
+		this->info.descriptorPool = pools.back();
+
+		error = vkAllocateDescriptorSets(d.handle, &this->info, &s);
+	}
+
+	NV_VULKAN_ERROR("vkAllocateDescriptorSets()", error)
+
+	this->info.pSetLayouts = nullptr;
+	return s;
+}
+
+void nv::vulkan::descriptor_allocator::write(const nv::vulkan::device &d, VkDescriptorSet s,
+                                             const std::vector<nv::vulkan::descriptor_binding> &binding)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(s != nullptr)
+
+	this->change.resize(binding.size());
+
+	for (uint32_t k = 0; k < binding.size(); ++k)
+	{
+		VkWriteDescriptorSet &w = this->change[k];
+
+		w.pNext = nullptr;
+		w.dstSet = s;
+		w.dstBinding = binding[k].binding;
+		w.dstArrayElement = 0;
+		w.descriptorCount = 1;
+		w.descriptorType = binding[k].type;
+		w.pImageInfo = binding[k].is_image()? &binding[k].image : nullptr;
+		w.pBufferInfo = binding[k].is_image()? nullptr : &binding[k].buffer;
+		w.pTexelBufferView = nullptr;
+		w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	}
+
+	vkUpdateDescriptorSets(d.handle, this->change.size(), this->change.data(), 0, nullptr);
+}
+
+void nv::vulkan::descriptor_allocator::reset(const nv::vulkan::device &d, const uint32_t n)
+{
+	ASSERT(n < this->used.size())
+
+	for (auto p : this->used[n])
+	{
+		const VkResult error = vkResetDescriptorPool(d.handle, p, 0);
+		NV_VULKAN_ERROR("vkResetDescriptorPool()", error)
+
+		this->spare.push_back(p);
+	}
+
+	this->used[n].clear();
+}
+
+void nv::vulkan::descriptor_allocator::destroy(const nv::vulkan::device &d)
+{
+	for (auto &pools : this->used)
+	{
+		this->spare.insert(this->spare.end(), pools.begin(), pools.end());
+		pools.clear();
+	}
+
+	if (this->spare.size() > 0)
+	{
+		ASSERT(d.handle != nullptr)
+
+		for (auto p : this->spare)
+			vkDestroyDescriptorPool(d.handle, p, nullptr);
+	}
+
+	this->spare.clear();
+	this->used.clear();
+	this->capacity = 0;
+}
+
+nv::vulkan::descriptor_allocator::~descriptor_allocator()
+{
+	bool pending = (this->spare.size() > 0);
+
+	for (const auto &pools : this->used)
+		pending = pending || (pools.size() > 0);
+
+	if (pending)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::descriptor_allocator instance before calling nv::vulkan::descriptor_allocator::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
+//
+// nv::vulkan::descriptor_set_cache
+//
+
+nv::vulkan::descriptor_set_cache::descriptor_set_cache():
+	count(0)
+{
+}
+
+void nv::vulkan::descriptor_set_cache::create(const nv::vulkan::device &d)
+{
+	// NOTE: a single slot, never reset.
+	this->pool.create(d, 1);
+}
+
+VkDescriptorSet nv::vulkan::descriptor_set_cache::get(const nv::vulkan::device &d, VkDescriptorSetLayout l,
+                                                      const std::vector<nv::vulkan::descriptor_binding> &binding)
+{
+	uint64_t hash = mix(0xCBF29CE484222325ull, handle_bits(l));
+
+	for (const auto &b : binding)
+	{
+		hash = mix(hash, b.binding);
+		hash = mix(hash, b.type);
+		hash = mix(hash, handle_bits(b.buffer.buffer));
+		hash = mix(hash, b.buffer.offset);
+		hash = mix(hash, b.buffer.range);
+		hash = mix(hash, handle_bits(b.image.sampler));
+		hash = mix(hash, handle_bits(b.image.imageView));
+		hash = mix(hash, b.image.imageLayout);
+	}
+
+	auto &bucket = this->table[hash];
+
+	for (const auto &e : bucket)
+		if ((e.layout == l) && (e.binding == binding)) return e.handle;
+
+	entry e;
+
+	e.layout = l;
+	e.binding = binding;
+	e.handle = this->pool.allocate(d, 0, l);
+
+	this->pool.write(d, e.handle, binding);
+
+	bucket.push_back(std::move(e));
+
+	++this->count;
+	return bucket.back().handle;
+}
+
+uint32_t nv::vulkan::descriptor_set_cache::size() const
+{
+	return this->count;
+}
+
+void nv::vulkan::descriptor_set_cache::destroy(const nv::vulkan::device &d)
+{
+	this->pool.destroy(d);
+	this->table.clear();
+	this->count = 0;
+}
+
+nv::vulkan::descriptor_set_cache::~descriptor_set_cache()
+{
+}
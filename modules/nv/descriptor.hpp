@@ -0,0 +1,167 @@
+#if !defined(NV_DESCRIPTOR_HEADER)
+	#define NV_DESCRIPTOR_HEADER
+	#include <vector>
+	#include <unordered_map>
+
+	#include "vulkan.hpp"
+
+	// NOTE: the number of sets of the first pool, every other pool being twice
+	// as large as the one before, up to the maximum size.
+
+	#if !defined(NV_DESCRIPTOR_POOL_SIZE)
+		#define NV_DESCRIPTOR_POOL_SIZE 64
+	#endif
+
+	#if !defined(NV_DESCRIPTOR_POOL_MAX_SIZE)
+		#define NV_DESCRIPTOR_POOL_MAX_SIZE 4096
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a single descriptor written to a set, either a buffer or an image
+			// depending on its type.
+
+			struct descriptor_binding
+			{
+				descriptor_binding(const uint32_t binding, const VkDescriptorType type,
+				                   VkBuffer b, const VkDeviceSize offset = 0, const VkDeviceSize range = VK_WHOLE_SIZE);
+
+				descriptor_binding(const uint32_t binding, const VkDescriptorType type,
+				                   VkImageView v, VkSampler s = VK_NULL_HANDLE,
+				                   const VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+				bool is_image() const;
+
+				bool operator ==(const descriptor_binding &other) const;
+
+				uint32_t binding;
+				VkDescriptorType type;
+				VkDescriptorBufferInfo buffer;
+				VkDescriptorImageInfo image;
+			};
+
+			// NOTE: set layouts are created once per distinct list of bindings and
+			// shared by every pipeline layout that uses them, until destroy().
+
+			struct descriptor_layout_cache
+			{
+				descriptor_layout_cache();
+
+				VkDescriptorSetLayout get(const nv::vulkan::device &d,
+				                          const std::vector<VkDescriptorSetLayoutBinding> &binding);
+
+				uint32_t size() const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~descriptor_layout_cache();
+
+				struct entry
+				{
+					std::vector<VkDescriptorSetLayoutBinding> binding;
+					VkDescriptorSetLayout handle;
+				};
+
+				uint32_t count;
+				VkDescriptorSetLayoutCreateInfo setup;
+				std::unordered_map<uint64_t, std::vector<entry>> table;
+			};
+
+			// NOTE: pipeline layouts are created once per distinct list of set
+			// layouts and push constant ranges, thus pipelines of the same layout
+			// keep their descriptor sets and push constants bound when switched.
+
+			struct pipeline_layout_cache
+			{
+				pipeline_layout_cache();
+
+				VkPipelineLayout get(const nv::vulkan::device &d, const nv::vulkan::layout &l);
+
+				uint32_t size() const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~pipeline_layout_cache();
+
+				struct entry
+				{
+					std::vector<VkDescriptorSetLayout> sets;
+					std::vector<VkPushConstantRange> ranges;
+					VkPipelineLayout handle;
+				};
+
+				uint32_t count;
+				std::unordered_map<uint64_t, std::vector<entry>> table;
+			};
+
+			// NOTE: every frame slot allocates from pools of its own, all of them
+			// reset at once by reset() when the slot is recorded again, rather than
+			// freeing its sets one by one. A pool that runs out is followed by a
+			// spare one, or a new one if there is no spare left.
+
+			struct descriptor_allocator
+			{
+				descriptor_allocator();
+
+				void create(const nv::vulkan::device &d, const uint32_t frames,
+				            const uint32_t sets = NV_DESCRIPTOR_POOL_SIZE);
+
+				VkDescriptorSet allocate(const nv::vulkan::device &d, const uint32_t n,
+				                         VkDescriptorSetLayout l);
+
+				void write(const nv::vulkan::device &d, VkDescriptorSet s,
+				           const std::vector<nv::vulkan::descriptor_binding> &binding);
+
+				void reset(const nv::vulkan::device &d, const uint32_t n);
+
+				void destroy(const nv::vulkan::device &d);
+
+				~descriptor_allocator();
+
+				VkDescriptorPool grow(const nv::vulkan::device &d);
+
+				uint32_t capacity;
+				std::vector<std::vector<VkDescriptorPool>> used;
+				std::vector<VkDescriptorPool> spare;
+				std::vector<VkDescriptorPoolSize> ratio;
+				std::vector<VkDescriptorPoolSize> size;
+				std::vector<VkWriteDescriptorSet> change;
+				VkDescriptorPoolCreateInfo setup;
+				VkDescriptorSetAllocateInfo info;
+			};
+
+			// NOTE: descriptor sets that never change after being written (e.g. the
+			// textures and parameters of a material), allocated once per distinct
+			// layout and list of bindings, and kept until destroy().
+
+			struct descriptor_set_cache
+			{
+				descriptor_set_cache();
+
+				void create(const nv::vulkan::device &d);
+
+				VkDescriptorSet get(const nv::vulkan::device &d, VkDescriptorSetLayout l,
+				                    const std::vector<nv::vulkan::descriptor_binding> &binding);
+
+				uint32_t size() const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~descriptor_set_cache();
+
+				struct entry
+				{
+					VkDescriptorSetLayout layout;
+					std::vector<nv::vulkan::descriptor_binding> binding;
+					VkDescriptorSet handle;
+				};
+
+				uint32_t count;
+				nv::vulkan::descriptor_allocator pool;
+				std::unordered_map<uint64_t, std::vector<entry>> table;
+			};
+		}
+	}
+#endif
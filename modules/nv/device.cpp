@@ -3,10 +3,63 @@
 #include "renderer.hpp"
 #include "device.hpp"
 #include "pipeline.hpp"
+#include "batch.hpp"
 
 static nv::vulkan::instance vk;
 static nv::vulkan::physical_device list;
 
+// NOTE: the bytes of a texel of the color formats read back, 0 otherwise.
+static VkDeviceSize texel_size(const VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R8_UNORM: case VK_FORMAT_R8_SNORM: case VK_FORMAT_R8_UINT: case VK_FORMAT_R8_SINT:
+			return 1;
+
+		case VK_FORMAT_R8G8_UNORM: case VK_FORMAT_R8G8_SNORM: case VK_FORMAT_R8G8_UINT: case VK_FORMAT_R8G8_SINT:
+		case VK_FORMAT_R16_UNORM: case VK_FORMAT_R16_SNORM: case VK_FORMAT_R16_UINT: case VK_FORMAT_R16_SINT:
+		case VK_FORMAT_R16_SFLOAT:
+			return 2;
+
+		case VK_FORMAT_R8G8B8_UNORM: case VK_FORMAT_R8G8B8_SNORM: case VK_FORMAT_R8G8B8_UINT: case VK_FORMAT_R8G8B8_SINT:
+			return 3;
+
+		case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SNORM: case VK_FORMAT_R8G8B8A8_UINT:
+		case VK_FORMAT_R8G8B8A8_SINT: case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R16G16_UNORM: case VK_FORMAT_R16G16_SNORM: case VK_FORMAT_R16G16_UINT:
+		case VK_FORMAT_R16G16_SINT: case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R32_UINT: case VK_FORMAT_R32_SINT: case VK_FORMAT_R32_SFLOAT:
+			return 4;
+
+		case VK_FORMAT_R16G16B16_UNORM: case VK_FORMAT_R16G16B16_SNORM: case VK_FORMAT_R16G16B16_UINT:
+		case VK_FORMAT_R16G16B16_SINT: case VK_FORMAT_R16G16B16_SFLOAT:
+			return 6;
+
+		case VK_FORMAT_R16G16B16A16_UNORM: case VK_FORMAT_R16G16B16A16_SNORM: case VK_FORMAT_R16G16B16A16_UINT:
+		case VK_FORMAT_R16G16B16A16_SINT: case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R32G32_UINT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32_SFLOAT:
+		case VK_FORMAT_R64_SFLOAT:
+			return 8;
+
+		case VK_FORMAT_R32G32B32_UINT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32_SFLOAT:
+			return 12;
+
+		case VK_FORMAT_R32G32B32A32_UINT: case VK_FORMAT_R32G32B32A32_SINT: case VK_FORMAT_R32G32B32A32_SFLOAT:
+		case VK_FORMAT_R64G64_SFLOAT:
+			return 16;
+
+		case VK_FORMAT_R64G64B64_SFLOAT:
+			return 24;
+
+		case VK_FORMAT_R64G64B64A64_SFLOAT:
+			return 32;
+
+		default:
+			return 0;
+	}
+}
+
 void nv::device::startup()
 {
 	vk.create();
@@ -77,10 +130,14 @@ nv::device::device(const uint32_t d, const uint32_t f):
 {
 	ASSERT(vk.handle != nullptr)
 
-	this->interface.info.queueFamilyIndex = f;
+	this->interface.family_index[nv::vulkan::NV_QUEUE_GRAPHICS] = f;
 
 	this->interface.create(list, d);
-	this->pool.create(this->interface);
+	this->memory.create(list, d);
+	this->cache.create(this->interface, list, d);
+	this->materials.create(this->interface);
+
+	this->pool.create(this->interface, nv::vulkan::NV_QUEUE_GRAPHICS);
 	this->buffer.allocate(this->interface, this->pool);
 }
 
@@ -124,12 +181,14 @@ void nv::device::attach_surface(nv::window &w) const
 
 	// Query of KHR support by the physical device's family queue:
 
+	const uint32_t f = this->interface.family_index[nv::vulkan::NV_QUEUE_GRAPHICS];
+
 	VkBool32 supported = VK_FALSE;
-	vkGetPhysicalDeviceSurfaceSupportKHR(list.handle[index], this->interface.info.queueFamilyIndex, w.surface.handle, &supported);
+	vkGetPhysicalDeviceSurfaceSupportKHR(list.handle[index], f, w.surface.handle, &supported);
 
 	if (!supported)
 	{
-		PRINT_ERROR("error: queue family %d has no KHR support for this surface\n", (int) this->interface.info.queueFamilyIndex)
+		PRINT_ERROR("error: queue family %d has no KHR support for this surface\n", (int) f)
 		exit(EXIT_FAILURE);
 	}
 }
@@ -142,18 +201,158 @@ void nv::device::detach_surface(nv::window &w) const
 		w.surface.destroy(vk);
 }
 
+void nv::device::create_layout(const nv::vulkan::reflection &r, nv::vulkan::layout &l) const
+{
+	std::lock_guard<std::mutex> guard(this->shared);
+
+	for (const auto &b : r.sets)
+		l.add(this->layouts.get(this->interface, b));
+
+	for (const auto &c : r.ranges)
+		l.add(c.stageFlags, c.offset, c.size);
+
+	l.share(this->pipeline_layouts.get(this->interface, l));
+}
+
+void nv::device::acquire_modules(nv::vulkan::pipeline &pl) const
+{
+	std::lock_guard<std::mutex> guard(this->shared);
+
+	pl.acquire(this->interface, this->modules);
+}
+
+void nv::device::release_modules(nv::vulkan::pipeline &pl) const
+{
+	std::lock_guard<std::mutex> guard(this->shared);
+
+	pl.release(this->interface, this->modules);
+}
+
+void nv::device::create_pipeline(nv::pipeline &pl, const nv::renderer &r) const
+{
+	if (pl.interface.is_compute())
+	{
+		this->create_pipeline(pl);
+		return;
+	}
+
+	// NOTE: a new variant of a pipeline created before, see nv::pipeline::specialize().
+
+	if (pl.layout.handle != nullptr)
+	{
+		if (pl.interface.handle == nullptr) pl.interface.create(this->interface);
+		return;
+	}
+
+	ASSERT(r.pass.handle != nullptr)
+
+	// NOTE: the viewport is set by the renderer at every bind.
+
+	pl.interface.add(r.pass);
+	pl.interface.use_dynamic_state(this->interface);
+
+	nv::vulkan::reflection shaders;
+
+	pl.reflect(shaders);
+	this->create_layout(shaders, pl.layout);
+	pl.interface.add(pl.layout);
+	this->acquire_modules(pl.interface);
+	pl.interface.cache = this->cache.handle;
+	pl.interface.create(this->interface);
+}
+
 void nv::device::create_pipeline(nv::pipeline &pl) const
 {
-	pl.layout.create(this->interface);
+	ASSERT(pl.interface.is_compute())
+
+	if (pl.layout.handle != nullptr)
+	{
+		if (pl.interface.handle == nullptr) pl.interface.create(this->interface);
+		return;
+	}
+
+	nv::vulkan::reflection shaders;
+
+	pl.reflect(shaders);
+	this->create_layout(shaders, pl.layout);
+	pl.interface.add(pl.layout);
+	this->acquire_modules(pl.interface);
+	pl.interface.cache = this->cache.handle;
 	pl.interface.create(this->interface);
 }
 
+void nv::device::create_pipelines(const std::vector<nv::pipeline*> &list, const nv::renderer &r) const
+{
+	ASSERT(r.pass.handle != nullptr)
+
+	nv::vulkan::pipeline_batch batch;
+
+	for (auto pl : list)
+	{
+		// NOTE: compute pipelines are few, thus created on their own.
+
+		if (pl->interface.is_compute())
+		{
+			this->create_pipeline(*pl);
+			continue;
+		}
+
+		if (pl->layout.handle != nullptr)
+		{
+			if (pl->interface.handle == nullptr) batch.add(pl->interface);
+			continue;
+		}
+
+		pl->interface.add(r.pass);
+		pl->interface.use_dynamic_state(this->interface);
+
+		nv::vulkan::reflection shaders;
+
+		pl->reflect(shaders);
+		this->create_layout(shaders, pl->layout);
+		pl->interface.add(pl->layout);
+		this->acquire_modules(pl->interface);
+		batch.add(pl->interface);
+	}
+
+	// NOTE: the compiler threads are only started by the first batch.
+	if (this->compiler == nullptr) this->compiler.reset(new nv::workers());
+
+	batch.create(this->interface, this->cache.handle, *this->compiler);
+}
+
 void nv::device::destroy_pipeline(nv::pipeline &pl) const
 {
+	// NOTE: the shader modules are kept until then, for later variants.
+
 	pl.interface.destroy(this->interface);
+	this->release_modules(pl.interface);
 	pl.layout.destroy(this->interface);
 }
 
+void nv::device::create_buffer(nv::vulkan::buffer &b, nv::vulkan::allocation &a,
+                               const VkDeviceSize size, const VkBufferUsageFlags usage) const
+{
+	b.create(this->interface, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	a = this->memory.bind(this->interface, b, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void nv::device::destroy_buffer(nv::vulkan::buffer &b, nv::vulkan::allocation &a) const
+{
+	if (b.handle == nullptr) return;
+
+	b.destroy(this->interface);
+	this->memory.release(this->interface, a);
+}
+
+VkDescriptorSet nv::device::descriptor_set(const nv::pipeline &pl, const uint32_t set,
+                                           const std::vector<nv::vulkan::descriptor_binding> &binding) const
+{
+	ASSERT(set < pl.layout.sets.size())
+
+	return this->materials.get(this->interface, pl.layout.sets[set], binding);
+}
+
 void nv::device::renderer_startup(nv::renderer &r, const nv::window &w) const
 {
 	if (w.is_closed())
@@ -164,24 +363,150 @@ void nv::device::renderer_startup(nv::renderer &r, const nv::window &w) const
 
 	r.chain.create(this->interface, w.surface);
 	r.image.create(this->interface, r.chain);
-	r.pass.create(this->interface, r.chain);
-	r.frame.create(this->interface, r.image, r.pass);
-	r.signal.create(this->interface);
-	r.signal.create(this->interface);
-	r.buffer.allocate(this->interface, this->pool, r.image.size());
+
+	// NOTE: a single depth image serves every frame, see render_pass::use_depth().
+
+	const VkFormat depth = list.depth_format(this->index, NV_RENDERER_STENCIL);
+
+	r.depth.create(this->interface, this->memory, r.image.resolution, depth, 1,
+	               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+	r.pass.create(this->interface, r.chain, depth);
+	r.frame.create(this->interface, r.image, r.pass, r.depth.view[0]);
+
+	r.headless = false;
+	r.create_slots(this->interface, list, this->index, this->memory, this->pool);
+}
+
+void nv::device::renderer_startup(nv::renderer &r, const uint32_t width, const uint32_t height,
+                                  const VkFormat format) const
+{
+	ASSERT((width > 0) && (height > 0))
+
+	const VkDeviceSize texel = texel_size(format);
+
+	if (texel == 0)
+	{
+		PRINT_ERROR("error: the format %d of a headless renderer cannot be read back\n", format)
+		exit(EXIT_FAILURE);
+	}
+
+	// NOTE: one offscreen image per frame slot, left in the layout of the copy
+	// that follows every frame, rather than one per swapchain image.
+
+	r.image.create(this->interface, this->memory, {width, height}, format, r.slot_count,
+	               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	const VkFormat depth = list.depth_format(this->index, NV_RENDERER_STENCIL);
+
+	r.depth.create(this->interface, this->memory, {width, height}, depth, 1,
+	               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+	r.pass.create(this->interface, format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, depth);
+	r.frame.create(this->interface, r.image, r.pass, r.depth.view[0]);
+
+	r.headless = true;
+	r.create_slots(this->interface, list, this->index, this->memory, this->pool);
+
+	// Host-visible readback buffers, preferably cached as the host reads them:
+
+	const VkDeviceSize size = static_cast<VkDeviceSize>(width)*height*texel;
+
+	r.target.resize(r.slot_count);
+	r.target_memory.resize(r.slot_count);
+	r.target_frame.assign(r.slot_count, UINT64_MAX);
+
+	r.readback.allocate(this->interface, this->pool, r.slot_count);
+
+	for (uint32_t n = 0; n < r.slot_count; ++n)
+	{
+		r.target[n].create(this->interface, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		r.target_memory[n] = this->memory.bind(this->interface, r.target[n],
+		                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+		ASSERT(r.target_memory[n].mapped != nullptr)
+
+		// NOTE: recorded once, the copy is the same for every frame of the slot.
+
+		r.readback.begin(n);
+		r.image.read(r.readback, n, n, r.target[n]);
+		r.readback.end(n);
+	}
 }
 
 void nv::device::renderer_shutdown(nv::renderer &r) const
 {
-	r.chain.destroy(this->interface);
-	r.image.destroy(this->interface);
-	r.pass.destroy(this->interface);
+	// NOTE: all frames in flight must retire before their resources go away.
+	r.in_flight.wait_all(this->interface);
+
 	r.frame.destroy(this->interface);
-	r.signal.destroy(this->interface);
+	r.pass.destroy(this->interface);
+	r.depth.destroy(this->interface, this->memory);
+
+	if (r.headless)
+		r.image.destroy(this->interface, this->memory);
+	else
+	{
+		r.image.destroy(this->interface);
+		r.chain.destroy(this->interface);
+	}
+
+	r.destroy_slots(this->interface, this->memory, this->pool);
+}
+
+bool nv::device::renderer_resize(nv::renderer &r, nv::window &w) const
+{
+	if (w.is_closed() || (r.chain.handle == nullptr)) return false;
+
+	// NOTE: false while the window is minimized, the renderer stays outdated.
+	if (!w.surface.update(w.handle, list, this->index)) return false;
+
+	// Retirement of everything that depends on the old extent:
+
+	r.retired.emplace_back();
+
+	auto &old = r.retired.back();
+
+	old.frame = r.frame_number;
+	old.chain.take(r.chain, r.image, r.frame);
+	old.recorded.handle.swap(r.recorded.handle);
+	old.depth.handle.swap(r.depth.handle);
+	old.depth.view.swap(r.depth.view);
+	old.depth.memory.swap(r.depth.memory);
+
+	// NOTE: the render pass only depends on the image formats, which a resize
+	// does not change. The new swapchain takes the place of the old one.
+
+	r.chain.create(this->interface, w.surface);
+	r.image.create(this->interface, r.chain);
+	r.depth.create(this->interface, this->memory, r.image.resolution, r.depth.creation.format, 1,
+	               r.depth.creation.usage);
+	r.frame.create(this->interface, r.image, r.pass, r.depth.view[0]);
+
+	r.image_owner.assign(r.image.size(), UINT32_MAX);
+
+	r.area.extent = r.image.resolution;
+	r.view.width = static_cast<float>(r.area.extent.width);
+	r.view.height = static_cast<float>(r.area.extent.height);
+
+	r.recorded.allocate(this->interface, this->pool, r.image.size());
+	r.dirty.assign(r.image.size(), true);
+	r.history.assign(r.image.size(), {});
+
+	r.outdated = false;
+	return true;
 }
 
 nv::device::~device()
 {
 	this->pool.destroy(this->interface);
+	this->memory.destroy(this->interface);
+	this->materials.destroy(this->interface);
+	this->pipeline_layouts.destroy(this->interface);
+	this->layouts.destroy(this->interface);
+	this->modules.destroy(this->interface);
+
+	// NOTE: pipelines created in this run are written back for the next one.
+	this->cache.save(this->interface);
+	this->cache.destroy(this->interface);
 	this->interface.destroy();
 }
@@ -1,14 +1,23 @@
 #if !defined(NV_DEVICE_HEADER)
 	#define NV_DEVICE_HEADER
 	#include <string>
+	#include <vector>
+	#include <memory>
+	#include <mutex>
 
 	#include "vulkan.hpp"
+	#include "cache.hpp"
+	#include "memory.hpp"
+	#include "descriptor.hpp"
+	#include "reflection.hpp"
+	#include "workers.hpp"
 
 	namespace nv
 	{
 		class window;
 		class renderer;
 		class pipeline;
+		class reloader;
 
 		class device
 		{
@@ -55,19 +64,64 @@
 
 			void detach_surface(nv::window &w) const;
 
+			void create_pipeline(nv::pipeline &pl, const nv::renderer &r) const;
+
+			// NOTE: a compute pipeline, which needs no renderer.
 			void create_pipeline(nv::pipeline &pl) const;
 
+			void create_pipelines(const std::vector<nv::pipeline*> &list, const nv::renderer &r) const;
+
 			void destroy_pipeline(nv::pipeline &pl) const;
 
+			// NOTE: a descriptor set that is never written again, shared by every
+			// call with the same layout and bindings, until the device goes away.
+			VkDescriptorSet descriptor_set(const nv::pipeline &pl, const uint32_t set,
+			                               const std::vector<nv::vulkan::descriptor_binding> &binding) const;
+
+			// NOTE: a device-local buffer (e.g. of vertices or indices), to be
+			// filled by nv::renderer::upload().
+			void create_buffer(nv::vulkan::buffer &b, nv::vulkan::allocation &a,
+			                   const VkDeviceSize size, const VkBufferUsageFlags usage) const;
+
+			void destroy_buffer(nv::vulkan::buffer &b, nv::vulkan::allocation &a) const;
+
 			void renderer_startup(nv::renderer &r, const nv::window &w) const;
 
+			// NOTE: a headless renderer draws into offscreen images, whose pixels
+			// are read back into host memory, thus it requires no window.
+			void renderer_startup(nv::renderer &r, const uint32_t width, const uint32_t height,
+			                      const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM) const;
+
 			void renderer_shutdown(nv::renderer &r) const;
 
+			bool renderer_resize(nv::renderer &r, nv::window &w) const;
+
 			~device();
 
+			friend class nv::reloader;
+
 			private:
+			// NOTE: the set layouts and the pipeline layout of a reflection, all of
+			// them shared with every pipeline that has the same ones.
+			void create_layout(const nv::vulkan::reflection &r, nv::vulkan::layout &l) const;
+
+			void acquire_modules(nv::vulkan::pipeline &pl) const;
+
+			void release_modules(nv::vulkan::pipeline &pl) const;
+
 			uint32_t index;
 			nv::vulkan::device interface;
+			mutable nv::vulkan::allocator memory;
+			nv::vulkan::pipeline_cache cache;
+			mutable nv::vulkan::descriptor_layout_cache layouts;
+			mutable nv::vulkan::pipeline_layout_cache pipeline_layouts;
+			mutable nv::vulkan::descriptor_set_cache materials;
+			mutable nv::vulkan::module_cache modules;
+
+			// NOTE: the caches above are shared with the thread of a nv::reloader,
+			// which rebuilds pipelines while the device creates others.
+			mutable std::mutex shared;
+			mutable std::unique_ptr<nv::workers> compiler;
 			nv::vulkan::command_pool pool;
 			nv::vulkan::command_buffer buffer;
 		};
@@ -0,0 +1,963 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "debug.hpp"
+#include "graph.hpp"
+
+static const VkAccessFlags write_accesses = VK_ACCESS_SHADER_WRITE_BIT |
+                                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                            VK_ACCESS_TRANSFER_WRITE_BIT |
+                                            VK_ACCESS_HOST_WRITE_BIT |
+                                            VK_ACCESS_MEMORY_WRITE_BIT;
+
+static void describe(const nv::vulkan::graph_usage u, const bool compute,
+                     nv::vulkan::render_graph::access &a)
+{
+	const VkPipelineStageFlags shaders = compute? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT :
+	                                     (VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	a.kind = u;
+	a.usage = 0;
+	a.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	switch (u)
+	{
+		case nv::vulkan::NV_GRAPH_COLOR_ATTACHMENT:
+			a.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			a.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			a.mask = a.write? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+			a.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			break;
+
+		// NOTE: depth tests read the attachment whether it is written or not.
+
+		case nv::vulkan::NV_GRAPH_DEPTH_ATTACHMENT:
+			a.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			a.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			a.mask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			a.mask |= a.write? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0;
+			a.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			break;
+
+		case nv::vulkan::NV_GRAPH_SAMPLED:
+			a.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			a.stage = shaders;
+			a.mask = VK_ACCESS_SHADER_READ_BIT;
+			a.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+			break;
+
+		case nv::vulkan::NV_GRAPH_STORAGE_READ:
+		case nv::vulkan::NV_GRAPH_STORAGE_WRITE:
+			a.layout = VK_IMAGE_LAYOUT_GENERAL;
+			a.stage = shaders;
+			a.mask = a.write? (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT) : VK_ACCESS_SHADER_READ_BIT;
+			a.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+			break;
+
+		case nv::vulkan::NV_GRAPH_UNIFORM:
+			a.stage = shaders;
+			a.mask = VK_ACCESS_UNIFORM_READ_BIT;
+			break;
+
+		case nv::vulkan::NV_GRAPH_INDIRECT:
+			a.stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			a.mask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			break;
+
+		case nv::vulkan::NV_GRAPH_VERTEX:
+			a.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			a.mask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+			break;
+	}
+}
+
+// NOTE: the stages and accesses that follow a frame which leaves an image in
+// the given layout.
+static void consumer_of(const VkImageLayout layout, VkPipelineStageFlags &stage, VkAccessFlags &mask)
+{
+	switch (layout)
+	{
+		case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+			stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			mask = 0;
+			break;
+
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+			stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+			        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			mask = VK_ACCESS_SHADER_READ_BIT;
+			break;
+
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+			stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			mask = VK_ACCESS_TRANSFER_READ_BIT;
+			break;
+
+		default:
+			stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			mask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			break;
+	}
+}
+
+static bool is_attachment(const nv::vulkan::graph_usage u)
+{
+	return (u == nv::vulkan::NV_GRAPH_COLOR_ATTACHMENT) || (u == nv::vulkan::NV_GRAPH_DEPTH_ATTACHMENT);
+}
+
+static VkDeviceSize align(const VkDeviceSize offset, const VkDeviceSize alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// NOTE: the state of a resource between two passes, i.e. its layout, the
+// stages and accesses of its last write (or transition), the stages that read
+// it since, and the ones to which that write is already visible.
+struct graph_state
+{
+	VkImageLayout layout;
+	VkPipelineStageFlags write_stage;
+	VkAccessFlags write_access;
+	VkPipelineStageFlags read_stage;
+	VkPipelineStageFlags visible_stage;
+	VkAccessFlags visible_access;
+};
+
+static void record_barrier(nv::vulkan::command_buffer &cb, const uint32_t n,
+                           nv::vulkan::render_graph::pass &p,
+                           const std::vector<nv::vulkan::render_graph::resource> &resources)
+{
+	if (p.images.empty() && p.buffers.empty()) return;
+
+	for (uint32_t k = 0; k < p.images.size(); ++k)
+		p.images[k].image = resources[p.image_resources[k]].handle;
+
+	for (uint32_t k = 0; k < p.buffers.size(); ++k)
+		p.buffers[k].buffer = resources[p.buffer_resources[k]].buffer;
+
+	cb.barrier(n, p.from, p.to, p.buffers.data(), p.buffers.size(), p.images.data(), p.images.size());
+}
+
+static void clear_barrier(nv::vulkan::render_graph::pass &p)
+{
+	p.from = 0;
+	p.to = 0;
+	p.images.clear();
+	p.image_resources.clear();
+	p.buffers.clear();
+	p.buffer_resources.clear();
+}
+
+//
+// nv::vulkan::render_graph::resource
+//
+
+nv::vulkan::render_graph::resource::resource():
+	image(true),
+	transient(false),
+	output(false),
+	format(VK_FORMAT_UNDEFINED),
+	extent({0, 0}),
+	initial(VK_IMAGE_LAYOUT_UNDEFINED),
+	final(VK_IMAGE_LAYOUT_UNDEFINED),
+	usage(0),
+	handle(VK_NULL_HANDLE),
+	view(VK_NULL_HANDLE),
+	buffer(VK_NULL_HANDLE),
+	first(UINT32_MAX),
+	last(0),
+	heap(UINT32_MAX),
+	offset(0),
+	stages(0),
+	accesses(0)
+{
+	this->requirements.size = 0;
+	this->requirements.alignment = 1;
+	this->requirements.memoryTypeBits = 0;
+}
+
+//
+// nv::vulkan::render_graph::pass
+//
+
+nv::vulkan::render_graph::pass::pass():
+	compute(false),
+	kept(false),
+	culled(false),
+	from(0),
+	to(0)
+{
+}
+
+//
+// nv::vulkan::render_graph
+//
+
+nv::vulkan::render_graph::render_graph():
+	compiled(false)
+{
+}
+
+uint32_t nv::vulkan::render_graph::add_image(const char *name, const VkFormat format, const VkExtent2D &extent)
+{
+	ASSERT(!this->compiled)
+
+	resource r;
+
+	r.name = name;
+	r.transient = true;
+	r.format = format;
+	r.extent = extent;
+
+	this->resources.push_back(r);
+	return this->resources.size() - 1;
+}
+
+uint32_t nv::vulkan::render_graph::import_image(const char *name, const VkFormat format, const VkExtent2D &extent,
+                                                const VkImageLayout initial, const VkImageLayout final,
+                                                const bool output)
+{
+	ASSERT(!this->compiled)
+
+	resource r;
+
+	r.name = name;
+	r.output = output;
+	r.format = format;
+	r.extent = extent;
+	r.initial = initial;
+	r.final = final;
+
+	this->resources.push_back(r);
+	return this->resources.size() - 1;
+}
+
+uint32_t nv::vulkan::render_graph::import_buffer(const char *name, const bool output)
+{
+	ASSERT(!this->compiled)
+
+	resource r;
+
+	r.name = name;
+	r.image = false;
+	r.output = output;
+
+	this->resources.push_back(r);
+	return this->resources.size() - 1;
+}
+
+void nv::vulkan::render_graph::set_image(const uint32_t r, VkImage i, VkImageView v)
+{
+	ASSERT(r < this->resources.size())
+	ASSERT(this->resources[r].image && !this->resources[r].transient)
+
+	this->resources[r].handle = i;
+	this->resources[r].view = v;
+}
+
+void nv::vulkan::render_graph::set_buffer(const uint32_t r, VkBuffer b)
+{
+	ASSERT(r < this->resources.size())
+	ASSERT(!this->resources[r].image)
+
+	this->resources[r].buffer = b;
+}
+
+uint32_t nv::vulkan::render_graph::add_pass(const char *name, const bool compute,
+                                            const std::function<void(nv::vulkan::command_buffer&, const uint32_t)> &record)
+{
+	ASSERT(!this->compiled)
+
+	std::unique_ptr<pass> p(new pass());
+
+	p->name = name;
+	p->compute = compute;
+	p->record = record;
+
+	this->passes.push_back(std::move(p));
+	return this->passes.size() - 1;
+}
+
+void nv::vulkan::render_graph::read(const uint32_t p, const uint32_t r, const graph_usage u)
+{
+	ASSERT(!this->compiled)
+	ASSERT(p < this->passes.size())
+	ASSERT(r < this->resources.size())
+
+	access a;
+
+	a.resource = r;
+	a.write = false;
+	a.clear = false;
+	a.load = false;
+	a.store = false;
+	describe(u, this->passes[p]->compute, a);
+
+	ASSERT(!this->resources[r].image || (a.layout != VK_IMAGE_LAYOUT_UNDEFINED))
+
+	// NOTE: a resource used many ways by the same pass is a single access of
+	// every one of them.
+
+	for (auto &other : this->passes[p]->accesses)
+	{
+		if (other.resource != r) continue;
+
+		if (other.layout != a.layout) other.layout = VK_IMAGE_LAYOUT_GENERAL;
+		if (is_attachment(u)) other.kind = u;
+
+		other.stage |= a.stage;
+		other.mask |= a.mask;
+		other.usage |= a.usage;
+		return;
+	}
+
+	this->passes[p]->accesses.push_back(a);
+}
+
+void nv::vulkan::render_graph::write(const uint32_t p, const uint32_t r, const graph_usage u,
+                                     const VkClearValue *clear)
+{
+	ASSERT(!this->compiled)
+	ASSERT(p < this->passes.size())
+	ASSERT(r < this->resources.size())
+	ASSERT((clear == nullptr) || is_attachment(u))
+
+	access a;
+
+	a.resource = r;
+	a.write = true;
+	a.clear = (clear != nullptr);
+	a.load = false;
+	a.store = false;
+	describe(u, this->passes[p]->compute, a);
+
+	if (a.clear) a.value = *clear;
+
+	ASSERT((u != NV_GRAPH_SAMPLED) && (u != NV_GRAPH_STORAGE_READ))
+	ASSERT(!this->resources[r].image || (a.layout != VK_IMAGE_LAYOUT_UNDEFINED))
+
+	for (auto &other : this->passes[p]->accesses)
+	{
+		if (other.resource != r) continue;
+
+		if (other.layout != a.layout) other.layout = VK_IMAGE_LAYOUT_GENERAL;
+		if (is_attachment(u)) other.kind = u;
+
+		other.stage |= a.stage;
+		other.mask |= a.mask;
+		other.usage |= a.usage;
+		other.write = true;
+		other.clear = a.clear;
+		other.value = a.value;
+		return;
+	}
+
+	this->passes[p]->accesses.push_back(a);
+}
+
+void nv::vulkan::render_graph::keep(const uint32_t p)
+{
+	ASSERT(p < this->passes.size())
+
+	this->passes[p]->kept = true;
+}
+
+void nv::vulkan::render_graph::compile(const nv::vulkan::device &d, nv::vulkan::allocator &a)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(!this->compiled)
+
+	// NOTE: a graph destroyed and compiled again (e.g. for the images of a new
+	// swapchain) starts over.
+
+	for (auto &r : this->resources)
+	{
+		r.first = UINT32_MAX;
+		r.last = 0;
+		r.heap = UINT32_MAX;
+		r.offset = 0;
+		r.usage = 0;
+		r.stages = 0;
+		r.accesses = 0;
+	}
+
+	clear_barrier(this->last);
+
+	for (auto &q : this->passes)
+	{
+		clear_barrier(*q);
+		q->attachments.clear();
+	}
+
+	this->cull();
+
+	// NOTE: the lifetimes, usages, stages and accesses of the resources, only
+	// counting the passes left.
+
+	for (uint32_t p = 0; p < this->passes.size(); ++p)
+	{
+		if (this->passes[p]->culled) continue;
+
+		for (const auto &c : this->passes[p]->accesses)
+		{
+			auto &r = this->resources[c.resource];
+
+			r.first = std::min(r.first, p);
+			r.last = std::max(r.last, p);
+			r.usage |= c.usage;
+			r.stages |= c.stage;
+			r.accesses |= c.mask;
+		}
+	}
+
+	this->place(d, a);
+	this->synchronize();
+	this->create_passes(d);
+
+	this->compiled = true;
+}
+
+void nv::vulkan::render_graph::cull()
+{
+	// NOTE: going backwards from the outputs, a pass is needed if it writes a
+	// resource whose content is needed afterwards. A write that clears makes
+	// the earlier content useless, while other writes may keep part of it,
+	// thus needing it as much as reads do.
+
+	std::vector<bool> live(this->resources.size());
+
+	for (uint32_t r = 0; r < this->resources.size(); ++r)
+		live[r] = this->resources[r].output;
+
+	for (uint32_t p = this->passes.size(); p-- > 0;)
+	{
+		auto &q = *this->passes[p];
+
+		bool needed = q.kept;
+
+		for (const auto &c : q.accesses)
+			if (c.write && live[c.resource]) needed = true;
+
+		q.culled = !needed;
+
+		if (!needed) continue;
+
+		for (auto &c : q.accesses)
+			c.store = live[c.resource];
+
+		for (const auto &c : q.accesses)
+			live[c.resource] = !(c.write && c.clear);
+	}
+
+	// NOTE: going forwards, the content of a resource is there once written,
+	// or from the start if imported in a defined layout.
+
+	std::vector<bool> content(this->resources.size());
+
+	for (uint32_t r = 0; r < this->resources.size(); ++r)
+	{
+		const auto &s = this->resources[r];
+		content[r] = !s.transient && (!s.image || (s.initial != VK_IMAGE_LAYOUT_UNDEFINED));
+	}
+
+	for (auto &q : this->passes)
+	{
+		if (q->culled) continue;
+
+		for (auto &c : q->accesses)
+		{
+			c.load = !c.clear && content[c.resource];
+
+			// NOTE: blending reads the attachment it loads.
+
+			if (c.write && c.load && (c.kind == NV_GRAPH_COLOR_ATTACHMENT))
+				c.mask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+		}
+
+		for (const auto &c : q->accesses)
+			if (c.write) content[c.resource] = true;
+	}
+}
+
+void nv::vulkan::render_graph::place(const nv::vulkan::device &d, nv::vulkan::allocator &a)
+{
+	std::vector<uint32_t> order;
+
+	for (uint32_t n = 0; n < this->resources.size(); ++n)
+	{
+		auto &r = this->resources[n];
+
+		if (!r.transient || (r.first == UINT32_MAX)) continue;
+
+		VkImageCreateInfo info;
+
+		info.flags = 0;
+		info.pNext = nullptr;
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.format = r.format;
+		info.usage = r.usage;
+		info.extent = {r.extent.width, r.extent.height, 1};
+		info.imageType = VK_IMAGE_TYPE_2D;
+		info.samples = VK_SAMPLE_COUNT_1_BIT;
+		info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		info.queueFamilyIndexCount = 0;
+		info.pQueueFamilyIndices = nullptr;
+		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+
+		VkResult error = vkCreateImage(d.handle, &info, nullptr, &r.handle);
+		NV_VULKAN_ERROR("vkCreateImage()", error)
+
+		vkGetImageMemoryRequirements(d.handle, r.handle, &r.requirements);
+
+		order.push_back(n);
+	}
+
+	// NOTE: the largest images first, each one at the lowest offset of a heap
+	// of the same memory types where it overlaps no image in use at the same
+	// time, i.e. at 0 or right after one of them.
+
+	std::stable_sort(order.begin(), order.end(), [this](const uint32_t x, const uint32_t y)
+	{
+		return this->resources[x].requirements.size > this->resources[y].requirements.size;
+	});
+
+	std::vector<uint32_t> placed;
+
+	for (const auto n : order)
+	{
+		auto &r = this->resources[n];
+
+		uint32_t h = 0;
+
+		while ((h < this->heaps.size()) && (this->heaps[h].requirements.memoryTypeBits != r.requirements.memoryTypeBits))
+			++h;
+
+		if (h == this->heaps.size())
+		{
+			heap fresh;
+
+			fresh.requirements.size = 0;
+			fresh.requirements.alignment = 1;
+			fresh.requirements.memoryTypeBits = r.requirements.memoryTypeBits;
+
+			this->heaps.push_back(fresh);
+		}
+
+		std::vector<uint32_t> overlapping;
+		std::vector<VkDeviceSize> offsets(1, 0);
+
+		for (const auto m : placed)
+		{
+			const auto &q = this->resources[m];
+
+			if ((q.heap != h) || (q.last < r.first) || (r.last < q.first)) continue;
+
+			overlapping.push_back(m);
+			offsets.push_back(align(q.offset + q.requirements.size, r.requirements.alignment));
+		}
+
+		std::sort(offsets.begin(), offsets.end());
+
+		for (const auto offset : offsets)
+		{
+			const bool free = std::none_of(overlapping.begin(), overlapping.end(), [this, &r, offset](const uint32_t m)
+			{
+				const auto &q = this->resources[m];
+				return (offset < q.offset + q.requirements.size) && (q.offset < offset + r.requirements.size);
+			});
+
+			if (free)
+			{
+				r.offset = offset;
+				break;
+			}
+		}
+
+		r.heap = h;
+
+		auto &e = this->heaps[h].requirements;
+
+		e.size = std::max(e.size, r.offset + r.requirements.size);
+		e.alignment = std::max(e.alignment, r.requirements.alignment);
+
+		placed.push_back(n);
+	}
+
+	for (auto &e : this->heaps)
+		e.memory = a.allocate(d, e.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, true);
+
+	for (const auto n : order)
+	{
+		auto &r = this->resources[n];
+		const auto &m = this->heaps[r.heap].memory;
+
+		VkResult error = vkBindImageMemory(d.handle, r.handle, m.memory, m.offset + r.offset);
+		NV_VULKAN_ERROR("vkBindImageMemory()", error)
+
+		VkImageViewCreateInfo info;
+
+		info.flags = 0;
+		info.pNext = nullptr;
+		info.image = r.handle;
+		info.format = r.format;
+		info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		info.subresourceRange.levelCount = 1;
+		info.subresourceRange.layerCount = 1;
+		info.subresourceRange.baseMipLevel = 0;
+		info.subresourceRange.baseArrayLayer = 0;
+		info.subresourceRange.aspectMask = nv::vulkan::image::aspect(r.format);
+
+		error = vkCreateImageView(d.handle, &info, nullptr, &r.view);
+		NV_VULKAN_ERROR("vkCreateImageView()", error)
+	}
+}
+
+void nv::vulkan::render_graph::synchronize()
+{
+	std::vector<graph_state> state(this->resources.size());
+
+	// NOTE: imported resources may have been used any way before the frame.
+	// Transient images have no content to wait for, but their memory was used
+	// by the images of the same heap, within the frame or by the previous one.
+
+	std::vector<VkPipelineStageFlags> heap_stages(this->heaps.size(), 0);
+	std::vector<VkAccessFlags> heap_accesses(this->heaps.size(), 0);
+
+	for (const auto &r : this->resources)
+	{
+		if (r.heap == UINT32_MAX) continue;
+
+		heap_stages[r.heap] |= r.stages;
+		heap_accesses[r.heap] |= r.accesses & write_accesses;
+	}
+
+	for (uint32_t n = 0; n < this->resources.size(); ++n)
+	{
+		const auto &r = this->resources[n];
+		auto &s = state[n];
+
+		s.read_stage = 0;
+		s.visible_stage = 0;
+		s.visible_access = 0;
+
+		if (r.transient)
+		{
+			s.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			s.write_stage = (r.heap != UINT32_MAX)? heap_stages[r.heap] : 0;
+			s.write_access = (r.heap != UINT32_MAX)? heap_accesses[r.heap] : 0;
+		}
+		else
+		{
+			s.layout = r.initial;
+			s.write_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			s.write_access = VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+	}
+
+	auto add = [this](pass &p, const uint32_t n, const graph_state &s,
+	                  const VkPipelineStageFlags stage, const VkAccessFlags mask,
+	                  const VkImageLayout from, const VkImageLayout to)
+	{
+		const auto &r = this->resources[n];
+
+		VkPipelineStageFlags source = s.write_stage | s.read_stage;
+
+		if (source == 0) source = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+		p.from |= source;
+		p.to |= stage;
+
+		if (r.image)
+		{
+			VkImageMemoryBarrier b;
+
+			b.pNext = nullptr;
+			b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			b.srcAccessMask = s.write_access;
+			b.dstAccessMask = mask;
+			b.oldLayout = from;
+			b.newLayout = to;
+			b.image = r.handle;
+			b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			b.subresourceRange.levelCount = 1;
+			b.subresourceRange.layerCount = 1;
+			b.subresourceRange.baseMipLevel = 0;
+			b.subresourceRange.baseArrayLayer = 0;
+			b.subresourceRange.aspectMask = nv::vulkan::image::aspect(r.format);
+
+			p.images.push_back(b);
+			p.image_resources.push_back(n);
+		}
+		else
+		{
+			VkBufferMemoryBarrier b;
+
+			b.pNext = nullptr;
+			b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			b.srcAccessMask = s.write_access;
+			b.dstAccessMask = mask;
+			b.buffer = r.buffer;
+			b.offset = 0;
+			b.size = VK_WHOLE_SIZE;
+			b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+			p.buffers.push_back(b);
+			p.buffer_resources.push_back(n);
+		}
+	};
+
+	for (auto &q : this->passes)
+	{
+		if (q->culled) continue;
+
+		for (const auto &c : q->accesses)
+		{
+			auto &s = state[c.resource];
+			const bool image = this->resources[c.resource].image;
+			const bool transition = image && (s.layout != c.layout);
+
+			if (!c.write && !transition)
+			{
+				// NOTE: reads after reads, or after a write already visible to
+				// them, wait for nothing.
+
+				const bool pending = (s.write_stage != 0) &&
+				                     (((c.stage & ~s.visible_stage) != 0) || ((c.mask & ~s.visible_access) != 0));
+
+				if (pending)
+				{
+					add(*q, c.resource, s, c.stage, c.mask, s.layout, s.layout);
+
+					s.visible_stage |= c.stage;
+					s.visible_access |= c.mask;
+				}
+
+				s.read_stage |= c.stage;
+				continue;
+			}
+
+			// NOTE: a write without a load discards the earlier content, thus
+			// saving the transition from keeping it.
+
+			const VkImageLayout from = (c.write && !c.load)? VK_IMAGE_LAYOUT_UNDEFINED : s.layout;
+
+			if (transition || (s.write_stage != 0) || (s.read_stage != 0))
+				add(*q, c.resource, s, c.stage, c.mask, from, c.layout);
+
+			s.layout = c.layout;
+			s.write_stage = c.stage;
+			s.visible_stage = c.stage;
+			s.visible_access = c.mask;
+			s.read_stage = 0;
+
+			if (c.write)
+			{
+				s.write_access = c.mask & write_accesses;
+				s.visible_stage = 0;
+				s.visible_access = 0;
+			}
+			else
+			{
+				// NOTE: the barrier of the transition made the last write
+				// available already, and the reader stage is no writer.
+
+				s.write_access = 0;
+				s.read_stage = c.stage;
+			}
+		}
+	}
+
+	for (uint32_t n = 0; n < this->resources.size(); ++n)
+	{
+		const auto &r = this->resources[n];
+		const auto &s = state[n];
+
+		if (r.transient || !r.image || (r.final == VK_IMAGE_LAYOUT_UNDEFINED) || (r.final == s.layout)) continue;
+
+		VkPipelineStageFlags stage;
+		VkAccessFlags mask;
+
+		consumer_of(r.final, stage, mask);
+		add(this->last, n, s, stage, mask, s.layout, r.final);
+	}
+}
+
+void nv::vulkan::render_graph::create_passes(const nv::vulkan::device &d)
+{
+	for (auto &q : this->passes)
+	{
+		if (q->culled || q->compute) continue;
+
+		std::vector<const access*> list;
+
+		for (const auto &c : q->accesses)
+			if (c.kind == NV_GRAPH_COLOR_ATTACHMENT) list.push_back(&c);
+
+		const uint32_t color_count = list.size();
+
+		for (const auto &c : q->accesses)
+			if (c.kind == NV_GRAPH_DEPTH_ATTACHMENT) list.push_back(&c);
+
+		if (list.empty() || (list.size() > color_count + 1))
+		{
+			PRINT_ERROR("error: the graphics pass %s needs some color attachments and at most one depth attachment\n", q->name.c_str())
+			exit(EXIT_FAILURE);
+		}
+
+		std::vector<VkAttachmentDescription> attachment(list.size());
+
+		for (uint32_t k = 0; k < list.size(); ++k)
+		{
+			const auto &c = *list[k];
+			const auto &r = this->resources[c.resource];
+			auto &e = attachment[k];
+
+			e.flags = 0;
+			e.format = r.format;
+			e.samples = VK_SAMPLE_COUNT_1_BIT;
+			e.initialLayout = c.layout;
+			e.finalLayout = c.layout;
+			e.loadOp = c.clear? VK_ATTACHMENT_LOAD_OP_CLEAR : (c.load? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			e.storeOp = c.store? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+			const bool stencil = (nv::vulkan::image::aspect(r.format) & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+			e.stencilLoadOp = stencil? e.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			e.stencilStoreOp = stencil? e.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+			q->attachments.push_back(c.resource);
+		}
+
+		q->target.name = q->name.c_str();
+		q->target.create(d, attachment, color_count);
+
+		for (uint32_t k = 0; k < list.size(); ++k)
+			if (list[k]->clear) q->target.clears[k] = list[k]->value;
+	}
+}
+
+bool nv::vulkan::render_graph::is_culled(const uint32_t p) const
+{
+	ASSERT(p < this->passes.size())
+
+	return this->passes[p]->culled;
+}
+
+const nv::vulkan::render_pass &nv::vulkan::render_graph::render_pass_of(const uint32_t p) const
+{
+	ASSERT(this->compiled)
+	ASSERT(p < this->passes.size())
+	ASSERT(this->passes[p]->target.handle != nullptr)
+
+	return this->passes[p]->target;
+}
+
+VkDeviceSize nv::vulkan::render_graph::transient_size() const
+{
+	VkDeviceSize size = 0;
+
+	for (const auto &e : this->heaps)
+		size += e.requirements.size;
+
+	return size;
+}
+
+VkFramebuffer nv::vulkan::render_graph::find_framebuffer(const nv::vulkan::device &d, pass &p)
+{
+	std::vector<VkImageView> views;
+
+	for (const auto r : p.attachments)
+	{
+		ASSERT(this->resources[r].view != VK_NULL_HANDLE)
+		views.push_back(this->resources[r].view);
+	}
+
+	for (uint32_t k = 0; k < p.views.size(); ++k)
+		if (p.views[k] == views) return p.framebuffers.handle[k];
+
+	// NOTE: a framebuffer per distinct list of views, e.g. one per image of a
+	// swapchain, created as soon as they are met.
+
+	p.framebuffers.create(d, p.target, views.data(), views.size(), this->resources[p.attachments[0]].extent);
+	p.views.push_back(views);
+
+	return p.framebuffers.handle.back();
+}
+
+void nv::vulkan::render_graph::execute(const nv::vulkan::device &d, nv::vulkan::command_buffer &cb, const uint32_t n)
+{
+	ASSERT(this->compiled)
+	ASSERT(n < cb.handle.size())
+
+	for (auto &q : this->passes)
+	{
+		if (q->culled) continue;
+
+		record_barrier(cb, n, *q, this->resources);
+
+		if (q->compute)
+		{
+			q->record(cb, n);
+			continue;
+		}
+
+		q->target.startup.framebuffer = this->find_framebuffer(d, *q);
+		vkCmdBeginRenderPass(cb.handle[n], &q->target.startup, VK_SUBPASS_CONTENTS_INLINE);
+
+		q->record(cb, n);
+
+		vkCmdEndRenderPass(cb.handle[n]);
+	}
+
+	record_barrier(cb, n, this->last, this->resources);
+}
+
+void nv::vulkan::render_graph::destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a)
+{
+	ASSERT(d.handle != nullptr)
+
+	for (auto &q : this->passes)
+	{
+		q->target.destroy(d);
+		q->framebuffers.destroy(d);
+		q->views.clear();
+	}
+
+	for (auto &r : this->resources)
+	{
+		if (!r.transient) continue;
+
+		if (r.view != VK_NULL_HANDLE) vkDestroyImageView(d.handle, r.view, nullptr);
+		if (r.handle != VK_NULL_HANDLE) vkDestroyImage(d.handle, r.handle, nullptr);
+
+		r.view = VK_NULL_HANDLE;
+		r.handle = VK_NULL_HANDLE;
+	}
+
+	for (auto &e : this->heaps)
+		a.release(d, e.memory);
+
+	this->heaps.clear();
+	this->compiled = false;
+}
+
+nv::vulkan::render_graph::~render_graph()
+{
+	if (this->compiled)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::render_graph instance before calling nv::vulkan::render_graph::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
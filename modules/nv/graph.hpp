@@ -0,0 +1,207 @@
+#if !defined(NV_GRAPH_HEADER)
+	#define NV_GRAPH_HEADER
+	#include <memory>
+	#include <string>
+	#include <vector>
+	#include <functional>
+
+	#include "vulkan.hpp"
+	#include "memory.hpp"
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: how a pass uses a resource, which tells the layout, the stages
+			// and the accesses of a barrier.
+
+			enum graph_usage
+			{
+				NV_GRAPH_COLOR_ATTACHMENT,
+				NV_GRAPH_DEPTH_ATTACHMENT,
+				NV_GRAPH_SAMPLED,
+				NV_GRAPH_STORAGE_READ,
+				NV_GRAPH_STORAGE_WRITE,
+				NV_GRAPH_UNIFORM,
+				NV_GRAPH_INDIRECT,
+				NV_GRAPH_VERTEX
+			};
+
+			// NOTE: the passes of a frame, recorded in the order they are added,
+			// each of them declaring the resources it reads and writes. compile()
+			// then does once what is otherwise written by hand for every frame:
+			//
+			// - it culls the passes whose writes nothing reads, unless kept, the
+			//   outputs being the imported resources that outlive the frame,
+			// - it tells the load and store operations of every attachment, i.e.
+			//   a clear if asked for, a load only if the earlier content is used
+			//   and a store only if a later pass or the next frame needs it,
+			// - it places the images added (i.e. transient ones, which only live
+			//   within the frame) at the same memory when their lifetimes do not
+			//   overlap,
+			// - it records every layout transition and dependency as a single
+			//   pipeline barrier before each pass, reads after reads in the same
+			//   layout needing none.
+			//
+			// Each graphics pass gets a render pass of a single subpass, made of
+			// the attachments it uses, against which its pipelines are created.
+			// The handles of imported resources may change every frame (e.g. the
+			// images of a swapchain), but not their format nor their extent: the
+			// graph is destroyed and compiled again when they do.
+
+			struct render_graph
+			{
+				render_graph();
+
+				// NOTE: a transient image, of the usage of its passes.
+				uint32_t add_image(const char *name, const VkFormat format, const VkExtent2D &extent);
+
+				// NOTE: an image of its own, in the initial layout at the beginning of
+				// every frame and left in the final one at its end, whose content is
+				// needed after the frame if it is an output.
+				uint32_t import_image(const char *name, const VkFormat format, const VkExtent2D &extent,
+				                      const VkImageLayout initial, const VkImageLayout final,
+				                      const bool output = true);
+
+				uint32_t import_buffer(const char *name, const bool output = true);
+
+				void set_image(const uint32_t r, VkImage i, VkImageView v);
+
+				void set_buffer(const uint32_t r, VkBuffer b);
+
+				uint32_t add_pass(const char *name, const bool compute,
+				                  const std::function<void(nv::vulkan::command_buffer&, const uint32_t)> &record);
+
+				void read(const uint32_t p, const uint32_t r, const graph_usage u);
+
+				// NOTE: an attachment written without a clear value keeps its earlier
+				// content, if any.
+				void write(const uint32_t p, const uint32_t r, const graph_usage u,
+				           const VkClearValue *clear = nullptr);
+
+				// NOTE: a pass never culled, e.g. one whose work is only visible to
+				// the host.
+				void keep(const uint32_t p);
+
+				void compile(const nv::vulkan::device &d, nv::vulkan::allocator &a);
+
+				bool is_culled(const uint32_t p) const;
+
+				// NOTE: only valid after compile().
+				const nv::vulkan::render_pass &render_pass_of(const uint32_t p) const;
+
+				// NOTE: the memory of the transient images, once aliased.
+				VkDeviceSize transient_size() const;
+
+				// NOTE: records every pass that is not culled into a command buffer
+				// that has begun.
+				void execute(const nv::vulkan::device &d, nv::vulkan::command_buffer &cb, const uint32_t n);
+
+				void destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a);
+
+				~render_graph();
+
+				struct resource
+				{
+					resource();
+
+					std::string name;
+					bool image;
+					bool transient;
+					bool output;
+					VkFormat format;
+					VkExtent2D extent;
+					VkImageLayout initial;
+					VkImageLayout final;
+					VkImageUsageFlags usage;
+					VkImage handle;
+					VkImageView view;
+					VkBuffer buffer;
+
+					// NOTE: the first and last passes that use it, and where it lives if
+					// transient.
+					uint32_t first;
+					uint32_t last;
+					uint32_t heap;
+					VkDeviceSize offset;
+					VkMemoryRequirements requirements;
+
+					// NOTE: every stage and access it is used by within a frame.
+					VkPipelineStageFlags stages;
+					VkAccessFlags accesses;
+				};
+
+				struct access
+				{
+					uint32_t resource;
+					VkImageLayout layout;
+					VkPipelineStageFlags stage;
+					VkAccessFlags mask;
+					VkImageUsageFlags usage;
+					graph_usage kind;
+					bool write;
+					bool clear;
+					VkClearValue value;
+
+					// NOTE: whether the earlier content is used, and whether the
+					// content left is used later, as told by compile().
+					bool load;
+					bool store;
+				};
+
+				struct pass
+				{
+					pass();
+
+					std::string name;
+					bool compute;
+					bool kept;
+					bool culled;
+					std::function<void(nv::vulkan::command_buffer&, const uint32_t)> record;
+					std::vector<access> accesses;
+
+					// NOTE: the barrier recorded before the pass, whose images are
+					// those of the given resources.
+					VkPipelineStageFlags from;
+					VkPipelineStageFlags to;
+					std::vector<VkImageMemoryBarrier> images;
+					std::vector<uint32_t> image_resources;
+					std::vector<VkBufferMemoryBarrier> buffers;
+					std::vector<uint32_t> buffer_resources;
+
+					// NOTE: the resources of the attachments, colors first, and the
+					// framebuffers made of their views so far.
+					std::vector<uint32_t> attachments;
+					nv::vulkan::render_pass target;
+					nv::vulkan::framebuffer framebuffers;
+					std::vector<std::vector<VkImageView>> views;
+				};
+
+				struct heap
+				{
+					VkMemoryRequirements requirements;
+					nv::vulkan::allocation memory;
+				};
+
+				void cull();
+
+				void place(const nv::vulkan::device &d, nv::vulkan::allocator &a);
+
+				void synchronize();
+
+				void create_passes(const nv::vulkan::device &d);
+
+				VkFramebuffer find_framebuffer(const nv::vulkan::device &d, pass &p);
+
+				bool compiled;
+				std::vector<resource> resources;
+				std::vector<std::unique_ptr<pass>> passes;
+				std::vector<heap> heaps;
+
+				// NOTE: the transitions of the imported images to their final layout,
+				// at the end of the frame.
+				pass last;
+			};
+		}
+	}
+#endif
@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <iterator>
+
+#include "debug.hpp"
+#include "memory.hpp"
+
+static inline VkDeviceSize align_up(const VkDeviceSize value, const VkDeviceSize alignment)
+{
+	return (alignment > 1)? ((value + alignment - 1)/alignment)*alignment : value;
+}
+
+static inline VkDeviceSize next_power_of_two(const VkDeviceSize value)
+{
+	VkDeviceSize n = 1;
+	while (n < value) n <<= 1;
+	return n;
+}
+
+static inline uint32_t log2_of(VkDeviceSize value)
+{
+	uint32_t n = 0;
+	while (value > 1) { value >>= 1; ++n; }
+	return n;
+}
+
+static VkMappedMemoryRange mapped_range(const nv::vulkan::allocation &a,
+                                        const VkDeviceSize offset,
+                                        const VkDeviceSize size,
+                                        const VkDeviceSize atom,
+                                        const VkDeviceSize block_size)
+{
+	// NOTE: ranges of non-coherent memory must be multiples of nonCoherentAtomSize.
+
+	const VkDeviceSize start = ((a.offset + offset)/atom)*atom;
+	const VkDeviceSize end = std::min(align_up(a.offset + offset + size, atom), block_size);
+
+	VkMappedMemoryRange range;
+
+	range.offset = start;
+	range.pNext = nullptr;
+	range.size = end - start;
+	range.memory = a.memory;
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+
+	return range;
+}
+
+//
+// nv::vulkan::allocation
+//
+
+nv::vulkan::allocation::allocation():
+	memory(nullptr),
+	offset(0),
+	size(0),
+	block(UINT32_MAX),
+	mapped(nullptr),
+	coherent(false),
+	block_size(0)
+{
+}
+
+bool nv::vulkan::allocation::is_valid() const
+{
+	return (this->memory != nullptr);
+}
+
+//
+// nv::vulkan::memory_block
+//
+
+nv::vulkan::memory_block::memory_block():
+	handle(nullptr),
+	size(0),
+	type(0),
+	live(0),
+	image(false),
+	dedicated(false),
+	mapped(nullptr),
+	strategy(NV_MEMORY_FREE_LIST),
+	top(0)
+{
+}
+
+bool nv::vulkan::memory_block::allocate(const VkDeviceSize size,
+                                        const VkDeviceSize alignment,
+                                        VkDeviceSize &offset,
+                                        VkDeviceSize &reserved)
+{
+	switch (this->strategy)
+	{
+		case NV_MEMORY_LINEAR:
+		{
+			const VkDeviceSize start = align_up(this->top, alignment);
+
+			if (start + size > this->size) return false;
+
+			offset = start;
+			reserved = size;
+			this->top = start + size;
+			break;
+		}
+
+		case NV_MEMORY_FREE_LIST:
+		{
+			// NOTE: first fit, the front padding due to alignment goes back to the list.
+
+			auto range = this->free.begin();
+
+			for (; range != this->free.end(); ++range)
+			{
+				const VkDeviceSize start = align_up(range->first, alignment);
+
+				if (start + size <= range->first + range->second) break;
+			}
+
+			if (range == this->free.end()) return false;
+
+			const VkDeviceSize begin = range->first;
+			const VkDeviceSize end = range->first + range->second;
+			const VkDeviceSize start = align_up(begin, alignment);
+
+			this->free.erase(range);
+
+			if (start > begin)
+				this->free[begin] = start - begin;
+
+			if (start + size < end)
+				this->free[start + size] = end - (start + size);
+
+			offset = start;
+			reserved = size;
+			break;
+		}
+
+		case NV_MEMORY_BUDDY:
+		{
+			// NOTE: nodes are aligned to their own size, thus any alignment up to
+			// the node size is honored for free.
+
+			const VkDeviceSize node = next_power_of_two(std::max({size, alignment, (VkDeviceSize) NV_MEMORY_BUDDY_MIN_SIZE}));
+			const uint32_t k = log2_of(node/NV_MEMORY_BUDDY_MIN_SIZE);
+
+			if (k >= this->order.size()) return false;
+
+			uint32_t j = k;
+			while ((j < this->order.size()) && this->order[j].empty()) ++j;
+
+			if (j == this->order.size()) return false;
+
+			const VkDeviceSize start = *this->order[j].begin();
+			this->order[j].erase(this->order[j].begin());
+
+			// Split down to the requested order, keeping the upper halves:
+
+			while (j > k)
+			{
+				--j;
+				this->order[j].insert(start + (static_cast<VkDeviceSize>(NV_MEMORY_BUDDY_MIN_SIZE) << j));
+			}
+
+			offset = start;
+			reserved = node;
+			break;
+		}
+	}
+
+	++this->live;
+	return true;
+}
+
+void nv::vulkan::memory_block::release(const VkDeviceSize offset, const VkDeviceSize reserved)
+{
+	ASSERT(this->live > 0)
+
+	--this->live;
+
+	switch (this->strategy)
+	{
+		case NV_MEMORY_LINEAR:
+		{
+			// NOTE: only the most recent allocation or the whole block is reclaimed.
+
+			if (this->live == 0)
+				this->top = 0;
+			else if (offset + reserved == this->top)
+				this->top = offset;
+
+			break;
+		}
+
+		case NV_MEMORY_FREE_LIST:
+		{
+			VkDeviceSize start = offset;
+			VkDeviceSize length = reserved;
+
+			// Coalesce with the following free range:
+
+			auto next = this->free.lower_bound(start);
+
+			if ((next != this->free.end()) && (next->first == start + length))
+			{
+				length += next->second;
+				next = this->free.erase(next);
+			}
+
+			// Coalesce with the preceding free range:
+
+			if (next != this->free.begin())
+			{
+				auto previous = std::prev(next);
+
+				if (previous->first + previous->second == start)
+				{
+					start = previous->first;
+					length += previous->second;
+					this->free.erase(previous);
+				}
+			}
+
+			this->free[start] = length;
+			break;
+		}
+
+		case NV_MEMORY_BUDDY:
+		{
+			VkDeviceSize start = offset;
+			uint32_t k = log2_of(reserved/NV_MEMORY_BUDDY_MIN_SIZE);
+
+			while (k + 1 < this->order.size())
+			{
+				const VkDeviceSize buddy = start ^ (static_cast<VkDeviceSize>(NV_MEMORY_BUDDY_MIN_SIZE) << k);
+				auto found = this->order[k].find(buddy);
+
+				if (found == this->order[k].end()) break;
+
+				this->order[k].erase(found);
+				start = std::min(start, buddy);
+				++k;
+			}
+
+			this->order[k].insert(start);
+			break;
+		}
+	}
+}
+
+bool nv::vulkan::memory_block::is_empty() const
+{
+	return (this->live == 0);
+}
+
+nv::vulkan::memory_block::~memory_block()
+{
+}
+
+//
+// nv::vulkan::allocator
+//
+
+nv::vulkan::allocator::allocator():
+	block_size(NV_MEMORY_BLOCK_SIZE)
+{
+	this->limits = {};
+	this->properties = {};
+}
+
+void nv::vulkan::allocator::create(const nv::vulkan::physical_device &pd,
+                                   const uint32_t index,
+                                   const VkDeviceSize block_size)
+{
+	ASSERT(index < pd.count())
+
+	// NOTE: buddy blocks need a power of two size.
+	this->block_size = next_power_of_two(block_size);
+	this->limits = pd.properties[index].limits;
+	this->properties = pd.memory[index];
+}
+
+uint32_t nv::vulkan::allocator::find_type(const uint32_t bits,
+                                          const VkMemoryPropertyFlags required,
+                                          const VkMemoryPropertyFlags preferred) const
+{
+	uint32_t found = UINT32_MAX;
+
+	for (uint32_t n = 0; n < this->properties.memoryTypeCount; ++n)
+	{
+		if ((bits & (1u << n)) == 0) continue;
+
+		const VkMemoryPropertyFlags flags = this->properties.memoryTypes[n].propertyFlags;
+
+		if ((flags & required) != required) continue;
+
+		if ((flags & preferred) == preferred) return n;
+
+		if (found == UINT32_MAX) found = n;
+	}
+
+	return found;
+}
+
+nv::vulkan::allocation nv::vulkan::allocator::allocate(const nv::vulkan::device &d,
+                                                       const VkMemoryRequirements &r,
+                                                       const VkMemoryPropertyFlags required,
+                                                       const VkMemoryPropertyFlags preferred,
+                                                       const bool image,
+                                                       const memory_strategy s)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(r.size > 0)
+
+	const uint32_t type = this->find_type(r.memoryTypeBits, required, preferred);
+
+	if (type == UINT32_MAX)
+	{
+		PRINT_ERROR("error: no memory type matches the bits %x and property flags %x\n", r.memoryTypeBits, required)
+		exit(EXIT_FAILURE);
+	}
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	nv::vulkan::allocation a;
+
+	a.coherent = (this->properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	// NOTE: buffers and images never share a block, which keeps linear and
+	// optimal resources apart as required by bufferImageGranularity.
+
+	for (uint32_t n = 0; n < this->block.size(); ++n)
+	{
+		auto &b = this->block[n];
+
+		if ((b.handle == nullptr) || b.dedicated) continue;
+		if ((b.type != type) || (b.image != image) || (b.strategy != s)) continue;
+
+		if (b.allocate(r.size, r.alignment, a.offset, a.size))
+		{
+			a.block = n;
+			a.memory = b.handle;
+			a.block_size = b.size;
+			a.mapped = (b.mapped != nullptr)? static_cast<char*>(b.mapped) + a.offset : nullptr;
+			return a;
+		}
+	}
+
+	// A new block, dedicated to a single resource if it does not fit a regular one:
+
+	nv::vulkan::memory_block b;
+
+	// NOTE: lazily allocated memory only backs transient attachments, which are
+	// few and as large as the swapchain, thus each of them gets a block of its
+	// own rather than a regular one.
+
+	const bool lazy = (this->properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+
+	b.type = type;
+	b.strategy = s;
+	b.image = image;
+	b.dedicated = lazy || (r.size > this->block_size);
+	b.size = b.dedicated? r.size : this->block_size;
+
+	VkMemoryAllocateInfo info;
+
+	info.pNext = nullptr;
+	info.memoryTypeIndex = type;
+	info.allocationSize = b.size;
+	info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+
+	const VkResult error = vkAllocateMemory(d.handle, &info, nullptr, &b.handle);
+	NV_VULKAN_ERROR("vkAllocateMemory()", error)
+
+	// NOTE: host-visible blocks stay mapped for their whole lifetime.
+
+	if (this->properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		const VkResult error = vkMapMemory(d.handle, b.handle, 0, VK_WHOLE_SIZE, 0, &b.mapped);
+		NV_VULKAN_ERROR("vkMapMemory()", error)
+	}
+
+	switch (s)
+	{
+		case NV_MEMORY_LINEAR:
+			b.top = 0;
+			break;
+
+		case NV_MEMORY_FREE_LIST:
+			b.free[0] = b.size;
+			break;
+
+		case NV_MEMORY_BUDDY:
+			b.order.resize(log2_of(next_power_of_two(b.size)/NV_MEMORY_BUDDY_MIN_SIZE) + 1);
+			b.order.back().insert(0);
+			break;
+	}
+
+	// NOTE: dedicated blocks of any strategy hold exactly one resource at offset 0.
+
+	if (b.dedicated)
+	{
+		a.offset = 0;
+		a.size = b.size;
+		b.live = 1;
+	}
+	else if (!b.allocate(r.size, r.alignment, a.offset, a.size))
+	{
+		PRINT_ERROR("%s\n", "error: unable to sub-allocate from a new memory block")
+		exit(EXIT_FAILURE);
+	}
+
+	// Reuse the slot of a released block, if any:
+
+	uint32_t n = 0;
+	while ((n < this->block.size()) && (this->block[n].handle != nullptr)) ++n;
+
+	if (n == this->block.size())
+		this->block.push_back(std::move(b));
+	else
+		this->block[n] = std::move(b);
+
+	if (this->block_count() > this->limits.maxMemoryAllocationCount)
+		PRINT_ERROR("warning: %d memory blocks exceed maxMemoryAllocationCount\n", (int) this->block_count())
+
+	a.block = n;
+	a.memory = this->block[n].handle;
+	a.block_size = this->block[n].size;
+	a.mapped = (this->block[n].mapped != nullptr)? static_cast<char*>(this->block[n].mapped) + a.offset : nullptr;
+
+	return a;
+}
+
+nv::vulkan::allocation nv::vulkan::allocator::bind(const nv::vulkan::device &d,
+                                                   const nv::vulkan::buffer &b,
+                                                   const VkMemoryPropertyFlags required,
+                                                   const VkMemoryPropertyFlags preferred,
+                                                   const memory_strategy s)
+{
+	ASSERT(b.handle != nullptr)
+
+	const nv::vulkan::allocation a = this->allocate(d, b.requirements, required, preferred, false, s);
+
+	const VkResult error = vkBindBufferMemory(d.handle, b.handle, a.memory, a.offset);
+	NV_VULKAN_ERROR("vkBindBufferMemory()", error)
+
+	return a;
+}
+
+nv::vulkan::allocation nv::vulkan::allocator::bind(const nv::vulkan::device &d, VkImage i,
+                                                   const VkMemoryPropertyFlags required,
+                                                   const VkMemoryPropertyFlags preferred,
+                                                   const memory_strategy s)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(i != nullptr)
+
+	VkMemoryRequirements r;
+	vkGetImageMemoryRequirements(d.handle, i, &r);
+
+	const nv::vulkan::allocation a = this->allocate(d, r, required, preferred, true, s);
+
+	const VkResult error = vkBindImageMemory(d.handle, i, a.memory, a.offset);
+	NV_VULKAN_ERROR("vkBindImageMemory()", error)
+
+	return a;
+}
+
+bool nv::vulkan::allocator::is_coherent(const nv::vulkan::allocation &a) const
+{
+	ASSERT(a.is_valid())
+
+	return a.coherent;
+}
+
+void nv::vulkan::allocator::flush(const nv::vulkan::device &d,
+                                  const nv::vulkan::allocation &a,
+                                  const VkDeviceSize offset,
+                                  const VkDeviceSize size) const
+{
+	if (this->is_coherent(a)) return;
+
+	const VkMappedMemoryRange range = mapped_range(a, offset, size,
+	                                               this->limits.nonCoherentAtomSize,
+	                                               a.block_size);
+
+	const VkResult error = vkFlushMappedMemoryRanges(d.handle, 1, &range);
+	NV_VULKAN_ERROR("vkFlushMappedMemoryRanges()", error)
+}
+
+void nv::vulkan::allocator::invalidate(const nv::vulkan::device &d,
+                                       const nv::vulkan::allocation &a,
+                                       const VkDeviceSize offset,
+                                       const VkDeviceSize size) const
+{
+	if (this->is_coherent(a)) return;
+
+	const VkMappedMemoryRange range = mapped_range(a, offset, size,
+	                                               this->limits.nonCoherentAtomSize,
+	                                               a.block_size);
+
+	const VkResult error = vkInvalidateMappedMemoryRanges(d.handle, 1, &range);
+	NV_VULKAN_ERROR("vkInvalidateMappedMemoryRanges()", error)
+}
+
+void nv::vulkan::allocator::release(const nv::vulkan::device &d, nv::vulkan::allocation &a)
+{
+	if (!a.is_valid()) return;
+
+	ASSERT(d.handle != nullptr)
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	ASSERT(a.block < this->block.size())
+
+	auto &b = this->block[a.block];
+
+	if (b.dedicated)
+	{
+		--b.live;
+	}
+	else
+	{
+		b.release(a.offset, a.size);
+	}
+
+	// NOTE: regular blocks are kept for reuse, dedicated ones go away at once.
+
+	if (b.dedicated && b.is_empty())
+	{
+		if (b.mapped != nullptr) vkUnmapMemory(d.handle, b.handle);
+
+		vkFreeMemory(d.handle, b.handle, nullptr);
+		b = nv::vulkan::memory_block();
+	}
+
+	a = nv::vulkan::allocation();
+}
+
+uint32_t nv::vulkan::allocator::block_count() const
+{
+	uint32_t counter = 0;
+
+	for (const auto &b : this->block)
+		if (b.handle != nullptr) ++counter;
+
+	return counter;
+}
+
+void nv::vulkan::allocator::destroy(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	for (auto &b : this->block)
+	{
+		if (b.handle == nullptr) continue;
+
+		if (b.mapped != nullptr) vkUnmapMemory(d.handle, b.handle);
+
+		vkFreeMemory(d.handle, b.handle, nullptr);
+	}
+
+	this->block.clear();
+}
+
+nv::vulkan::allocator::~allocator()
+{
+	if (this->block.size() > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::allocator instance before calling nv::vulkan::allocator::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,135 @@
+#if !defined(NV_MEMORY_HEADER)
+	#define NV_MEMORY_HEADER
+	#include <map>
+	#include <set>
+	#include <mutex>
+	#include <vector>
+
+	#include "vulkan.hpp"
+
+	#if !defined(NV_MEMORY_BLOCK_SIZE)
+		#define NV_MEMORY_BLOCK_SIZE (64*1024*1024)
+	#endif
+
+	#if !defined(NV_MEMORY_BUDDY_MIN_SIZE)
+		#define NV_MEMORY_BUDDY_MIN_SIZE 256
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			enum memory_strategy
+			{
+				NV_MEMORY_LINEAR,
+				NV_MEMORY_FREE_LIST,
+				NV_MEMORY_BUDDY
+			};
+
+			struct allocation
+			{
+				allocation();
+
+				bool is_valid() const;
+
+				VkDeviceMemory memory;
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				uint32_t block;
+				void *mapped;
+
+				// NOTE: copied from the block at allocation, for flush() and invalidate()
+				// to not read the blocks, which other threads may reallocate.
+				bool coherent;
+				VkDeviceSize block_size;
+			};
+
+			// NOTE: a memory_block is a single VkDeviceMemory from which resources
+			// are carved out according to one of the strategies above.
+
+			struct memory_block
+			{
+				memory_block();
+
+				bool allocate(const VkDeviceSize size, const VkDeviceSize alignment,
+				              VkDeviceSize &offset, VkDeviceSize &reserved);
+
+				void release(const VkDeviceSize offset, const VkDeviceSize reserved);
+
+				bool is_empty() const;
+
+				~memory_block();
+
+				VkDeviceMemory handle;
+				VkDeviceSize size;
+				uint32_t type;
+				uint32_t live;
+				bool image;
+				bool dedicated;
+				void *mapped;
+				memory_strategy strategy;
+
+				// Linear:
+				VkDeviceSize top;
+
+				// Free list (offset to size of every free range, sorted by offset):
+				std::map<VkDeviceSize, VkDeviceSize> free;
+
+				// Buddy (offsets of the free nodes of size NV_MEMORY_BUDDY_MIN_SIZE << n):
+				std::vector<std::set<VkDeviceSize>> order;
+			};
+
+			struct allocator
+			{
+				allocator();
+
+				void create(const nv::vulkan::physical_device &pd, const uint32_t index,
+				            const VkDeviceSize block_size = NV_MEMORY_BLOCK_SIZE);
+
+				uint32_t find_type(const uint32_t bits,
+				                   const VkMemoryPropertyFlags required,
+				                   const VkMemoryPropertyFlags preferred = 0) const;
+
+				nv::vulkan::allocation allocate(const nv::vulkan::device &d,
+				                                const VkMemoryRequirements &r,
+				                                const VkMemoryPropertyFlags required,
+				                                const VkMemoryPropertyFlags preferred = 0,
+				                                const bool image = false,
+				                                const memory_strategy s = NV_MEMORY_FREE_LIST);
+
+				nv::vulkan::allocation bind(const nv::vulkan::device &d,
+				                            const nv::vulkan::buffer &b,
+				                            const VkMemoryPropertyFlags required,
+				                            const VkMemoryPropertyFlags preferred = 0,
+				                            const memory_strategy s = NV_MEMORY_FREE_LIST);
+
+				nv::vulkan::allocation bind(const nv::vulkan::device &d, VkImage i,
+				                            const VkMemoryPropertyFlags required,
+				                            const VkMemoryPropertyFlags preferred = 0,
+				                            const memory_strategy s = NV_MEMORY_FREE_LIST);
+
+				void flush(const nv::vulkan::device &d, const nv::vulkan::allocation &a,
+				           const VkDeviceSize offset, const VkDeviceSize size) const;
+
+				void invalidate(const nv::vulkan::device &d, const nv::vulkan::allocation &a,
+				                const VkDeviceSize offset, const VkDeviceSize size) const;
+
+				bool is_coherent(const nv::vulkan::allocation &a) const;
+
+				void release(const nv::vulkan::device &d, nv::vulkan::allocation &a);
+
+				uint32_t block_count() const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~allocator();
+
+				VkDeviceSize block_size;
+				VkPhysicalDeviceLimits limits;
+				VkPhysicalDeviceMemoryProperties properties;
+				std::vector<nv::vulkan::memory_block> block;
+				mutable std::mutex lock;
+			};
+		}
+	}
+#endif
@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "debug.hpp"
+#include "vulkan.hpp"
+#include "module.hpp"
+
+#define NV_SPIRV_MAGIC 0x07230203
+
+// NOTE: FNV-1a over the whole code, collisions being resolved by comparing
+// the code itself.
+static uint64_t checksum(const uint8_t *data, const size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (size_t n = 0; n < size; ++n)
+	{
+		hash ^= data[n];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static bool is_same(const nv::vulkan::spirv &x, const nv::vulkan::spirv &y)
+{
+	return (x.size == y.size) && (std::memcmp(x.data, y.data, x.size) == 0);
+}
+
+// NOTE: the code mapped so far, by file name (to skip files mapped before and
+// unchanged since) and by contents. Both only refer to code still in use.
+
+static std::mutex registry;
+static std::unordered_map<std::string, std::weak_ptr<const nv::vulkan::spirv>> by_name;
+static std::unordered_map<uint64_t, std::vector<std::weak_ptr<const nv::vulkan::spirv>>> by_hash;
+
+//
+// nv::vulkan::spirv
+//
+
+nv::vulkan::spirv::spirv():
+	data(nullptr),
+	size(0),
+	hash(0),
+	modified(0)
+{
+}
+
+std::shared_ptr<const nv::vulkan::spirv> nv::vulkan::spirv::map(const std::string &filename)
+{
+	const int file = open(filename.c_str(), O_RDONLY);
+
+	if (file < 0)
+	{
+		PRINT_ERROR("unable to open %s\n", filename.c_str())
+		return nullptr;
+	}
+
+	struct stat status;
+
+	if ((fstat(file, &status) != 0) || (status.st_size <= 0) || ((status.st_size % 4) != 0))
+	{
+		PRINT_ERROR("%s is not a SPIR-V file\n", filename.c_str())
+		close(file);
+		return nullptr;
+	}
+
+	// NOTE: in nanoseconds, as a file rewritten within the same second must
+	// not be taken for the one mapped before.
+	const int64_t modified = static_cast<int64_t>(status.st_mtim.tv_sec)*1000000000 + status.st_mtim.tv_nsec;
+
+	std::lock_guard<std::mutex> lock(registry);
+
+	auto known = by_name.find(filename);
+
+	if (known != by_name.end())
+	{
+		auto code = known->second.lock();
+
+		if ((code != nullptr) && (code->modified == modified) && (code->size == static_cast<size_t>(status.st_size)))
+		{
+			close(file);
+			return code;
+		}
+	}
+
+	// NOTE: the mapping outlives the file descriptor.
+
+	void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if (data == MAP_FAILED)
+	{
+		PRINT_ERROR("unable to map %s\n", filename.c_str())
+		return nullptr;
+	}
+
+	std::shared_ptr<nv::vulkan::spirv> code(new nv::vulkan::spirv());
+
+	code->data = data;
+	code->size = status.st_size;
+	code->modified = modified;
+	code->name = filename;
+
+	if (*static_cast<const uint32_t*>(data) != NV_SPIRV_MAGIC)
+	{
+		PRINT_ERROR("%s is not a SPIR-V file\n", filename.c_str())
+		return nullptr;
+	}
+
+	code->hash = checksum(static_cast<const uint8_t*>(data), code->size);
+
+	// NOTE: the same code under another name shares the mapping of the first.
+
+	auto &list = by_hash[code->hash];
+	std::shared_ptr<const nv::vulkan::spirv> result = code;
+
+	for (auto n = list.begin(); n != list.end();)
+	{
+		auto other = n->lock();
+
+		if (other == nullptr)
+			n = list.erase(n);
+		else
+		{
+			if (is_same(*other, *code)) result = other;
+			++n;
+		}
+	}
+
+	if (result == code) list.push_back(code);
+
+	by_name[filename] = result;
+	return result;
+}
+
+nv::vulkan::spirv::~spirv()
+{
+	if (this->data != nullptr) munmap(this->data, this->size);
+}
+
+//
+// nv::vulkan::module_cache
+//
+
+nv::vulkan::module_cache::module_cache()
+{
+	this->setup.flags = 0;
+	this->setup.codeSize = 0;
+	this->setup.pNext = nullptr;
+	this->setup.pCode = nullptr;
+	this->setup.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+}
+
+VkShaderModule nv::vulkan::module_cache::acquire(const nv::vulkan::device &d, const nv::vulkan::spirv &code)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(code.data != nullptr)
+
+	auto &list = this->table[code.hash];
+
+	for (auto &e : list)
+	{
+		if ((e.code == &code) || is_same(*e.code, code))
+		{
+			e.references += 1;
+			return e.handle;
+		}
+	}
+
+	entry e;
+
+	e.code = &code;
+	e.references = 1;
+
+	this->setup.codeSize = code.size;
+	this->setup.pCode = static_cast<const uint32_t*>(code.data);
+
+	VkResult error = vkCreateShaderModule(d.handle, &this->setup, nullptr, &e.handle);
+	NV_VULKAN_ERROR("vkCreateShaderModule()", error)
+
+	list.push_back(e);
+	return e.handle;
+}
+
+void nv::vulkan::module_cache::release(const nv::vulkan::device &d, VkShaderModule m)
+{
+	ASSERT(d.handle != nullptr)
+
+	if (m == VK_NULL_HANDLE) return;
+
+	for (auto &t : this->table)
+	{
+		for (auto n = t.second.begin(); n != t.second.end(); ++n)
+		{
+			if (n->handle != m) continue;
+
+			ASSERT(n->references > 0)
+
+			if (--n->references == 0)
+			{
+				vkDestroyShaderModule(d.handle, n->handle, nullptr);
+				t.second.erase(n);
+			}
+
+			return;
+		}
+	}
+
+	PRINT_ERROR("%s\n", "warning: release of a shader module that is not in the cache")
+}
+
+uint32_t nv::vulkan::module_cache::size() const
+{
+	uint32_t count = 0;
+
+	for (const auto &t : this->table)
+		count += t.second.size();
+
+	return count;
+}
+
+void nv::vulkan::module_cache::destroy(const nv::vulkan::device &d)
+{
+	for (const auto &t : this->table)
+		for (const auto &e : t.second)
+			vkDestroyShaderModule(d.handle, e.handle, nullptr);
+
+	this->table.clear();
+}
+
+nv::vulkan::module_cache::~module_cache()
+{
+	if (this->size() > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::module_cache instance before calling nv::vulkan::module_cache::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
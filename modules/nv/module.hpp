@@ -0,0 +1,64 @@
+#if !defined(NV_MODULE_HEADER)
+	#define NV_MODULE_HEADER
+	#include <vulkan/vulkan.h>
+	#include <memory>
+	#include <string>
+	#include <vector>
+	#include <unordered_map>
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			struct device;
+
+			// NOTE: the SPIR-V code of a file, mapped in memory rather than read,
+			// and shared by every shader module loaded from a file with the same
+			// contents (under any name) while any of them is alive.
+
+			struct spirv
+			{
+				static std::shared_ptr<const nv::vulkan::spirv> map(const std::string &filename);
+
+				spirv();
+
+				~spirv();
+
+				void *data;
+				size_t size;
+				uint64_t hash;
+				int64_t modified;
+				std::string name;
+			};
+
+			// NOTE: the shader modules of a device, one per distinct SPIR-V code,
+			// created by the first acquire() of that code and destroyed by the
+			// last release(), i.e. once no pipeline made of it is left.
+
+			struct module_cache
+			{
+				module_cache();
+
+				VkShaderModule acquire(const nv::vulkan::device &d, const nv::vulkan::spirv &code);
+
+				void release(const nv::vulkan::device &d, VkShaderModule m);
+
+				uint32_t size() const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~module_cache();
+
+				struct entry
+				{
+					const nv::vulkan::spirv *code;
+					uint32_t references;
+					VkShaderModule handle;
+				};
+
+				std::unordered_map<uint64_t, std::vector<entry>> table;
+				VkShaderModuleCreateInfo setup;
+			};
+		}
+	}
+#endif
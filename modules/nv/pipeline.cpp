@@ -1,9 +1,20 @@
+#include <algorithm>
+
 #include "pipeline.hpp"
 #include "shader.hpp"
 #include "debug.hpp"
 
-nv::pipeline::pipeline()
+nv::pipeline::pipeline():
+	reflected(false)
 {
+	this->group[0] = 1;
+	this->group[1] = 1;
+	this->group[2] = 1;
+
+	this->group_id[0] = UINT32_MAX;
+	this->group_id[1] = UINT32_MAX;
+	this->group_id[2] = UINT32_MAX;
+
 	this->interface.add(this->viewport);
 	this->interface.add(this->rasterizer);
 	this->interface.add(this->multisampling);
@@ -19,6 +30,166 @@ void nv::pipeline::use(const nv::shader &s, const uint32_t index)
 	this->interface.add(s.list[index]);
 }
 
+void nv::pipeline::set_cull_mode(const VkCullModeFlags mode)
+{
+	this->rasterizer.setup.cullMode = mode;
+}
+
+void nv::pipeline::set_front_face(const VkFrontFace face)
+{
+	this->rasterizer.setup.frontFace = face;
+}
+
+void nv::pipeline::set_topology(const VkPrimitiveTopology topology)
+{
+	// NOTE: a dynamic topology must be of the same class (points, lines or
+	// triangles) as the one at creation.
+	this->interface.assembly.topology = topology;
+}
+
+void nv::pipeline::set_primitive_restart(const bool enable)
+{
+	this->interface.assembly.primitiveRestartEnable = enable? VK_TRUE : VK_FALSE;
+}
+
+void nv::pipeline::set_depth_test(const bool enable)
+{
+	this->stencil.setup.depthTestEnable = enable? VK_TRUE : VK_FALSE;
+}
+
+void nv::pipeline::set_depth_write(const bool enable)
+{
+	this->stencil.setup.depthWriteEnable = enable? VK_TRUE : VK_FALSE;
+}
+
+void nv::pipeline::set_depth_compare(const VkCompareOp op)
+{
+	this->stencil.setup.depthCompareOp = op;
+}
+
+void nv::pipeline::set_blending(const bool enable)
+{
+	this->blending.attachment.blendEnable = enable? VK_TRUE : VK_FALSE;
+}
+
+void nv::pipeline::use_binding(const uint32_t set, const uint32_t binding, const VkDescriptorType type,
+                               const VkShaderStageFlags stages, const uint32_t count)
+{
+	if (set >= this->bindings.size()) this->bindings.resize(set + 1);
+
+	VkDescriptorSetLayoutBinding b;
+
+	b.binding = binding;
+	b.descriptorType = type;
+	b.descriptorCount = count;
+	b.stageFlags = stages;
+	b.pImmutableSamplers = nullptr;
+
+	this->bindings[set].push_back(b);
+}
+
+uint32_t nv::pipeline::set_count() const
+{
+	if (this->layout.handle != nullptr) return this->layout.sets.size();
+
+	return this->bindings.size();
+}
+
+bool nv::pipeline::is_compute() const
+{
+	return this->interface.is_compute();
+}
+
+uint32_t nv::pipeline::variant_count() const
+{
+	return this->interface.variant_count();
+}
+
+void nv::pipeline::use_push_constants(const VkShaderStageFlags stages, const uint32_t size,
+                                      const uint32_t offset)
+{
+	ASSERT((offset % 4) == 0)
+	ASSERT((size % 4) == 0)
+
+	this->ranges.push_back({stages, offset, size});
+}
+
+VkShaderStageFlags nv::pipeline::push_constant_stages() const
+{
+	VkShaderStageFlags stages = 0;
+
+	for (const auto &r : this->layout.ranges)
+		stages |= r.stageFlags;
+
+	return stages;
+}
+
+uint32_t nv::pipeline::local_size(const uint32_t axis) const
+{
+	ASSERT(axis < 3)
+
+	uint32_t value = this->group[axis];
+
+	if ((this->group_id[axis] != UINT32_MAX) && !this->interface.constants.empty())
+		this->interface.constants[0].find(this->group_id[axis], value);
+
+	return value;
+}
+
+void nv::pipeline::reflect(nv::vulkan::reflection &r)
+{
+	for (size_t n = 0; n < this->interface.code.size(); ++n)
+		r.add(*this->interface.code[n], this->interface.stage[n].stage);
+
+	for (uint32_t set = 0; set < this->bindings.size(); ++set)
+		for (const auto &b : this->bindings[set])
+			r.assign(set, b);
+
+	if (!this->ranges.empty()) r.ranges = this->ranges;
+
+	this->group[0] = r.local_size[0];
+	this->group[1] = r.local_size[1];
+	this->group[2] = r.local_size[2];
+
+	this->group_id[0] = r.local_size_id[0];
+	this->group_id[1] = r.local_size_id[1];
+	this->group_id[2] = r.local_size_id[2];
+
+	if (this->interface.is_compute()) return;
+
+	// NOTE: without a vertex layout, the inputs come from a single interleaved
+	// vertex buffer, otherwise the layout must provide every input.
+
+	this->reflected = this->interface.attributes.empty();
+	use_inputs(this->interface, r, this->reflected);
+}
+
+void nv::pipeline::use_inputs(nv::vulkan::pipeline &p, const nv::vulkan::reflection &r, const bool reflected)
+{
+	if (reflected)
+	{
+		p.bindings.clear();
+		p.attributes.clear();
+		p.input.vertexBindingDescriptionCount = 0;
+		p.input.vertexAttributeDescriptionCount = 0;
+
+		if (r.attributes.empty()) return;
+
+		const VkVertexInputBindingDescription binding = {0, r.stride, VK_VERTEX_INPUT_RATE_VERTEX};
+
+		p.add(&binding, 1, r.attributes.data(), r.attributes.size());
+		return;
+	}
+
+	for (const auto &a : r.attributes)
+	{
+		const auto same = [&a](const VkVertexInputAttributeDescription &x) { return x.location == a.location; };
+
+		if (std::none_of(p.attributes.begin(), p.attributes.end(), same))
+			PRINT_ERROR("warning: no vertex attribute for the input at location %u\n", a.location)
+	}
+}
+
 nv::pipeline::~pipeline()
 {
 }
@@ -2,12 +2,16 @@
 	#define NV_PIPELINE_HEADER
 
 	#include "vulkan.hpp"
+	#include "vertex.hpp"
+	#include "reflection.hpp"
 	#include "device.hpp"
+	#include "renderer.hpp"
 
 	namespace nv
 	{
 		class shader;
 		class pipeline;
+		class reloader;
 
 		class pipeline
 		{
@@ -16,13 +20,152 @@
 
 			void use(const nv::shader &s, const uint32_t index);
 
+			// NOTE: the fixed function state below is taken by every draw when the
+			// device supports the extended dynamic state, otherwise it is baked
+			// by nv::device::create_pipeline() and must precede it.
+
+			void set_cull_mode(const VkCullModeFlags mode);
+
+			void set_front_face(const VkFrontFace face);
+
+			void set_topology(const VkPrimitiveTopology topology);
+
+			void set_primitive_restart(const bool enable);
+
+			void set_depth_test(const bool enable);
+
+			void set_depth_write(const bool enable);
+
+			void set_depth_compare(const VkCompareOp op);
+
+			void set_blending(const bool enable);
+
+			// NOTE: the descriptors, push constants and vertex inputs (if no vertex
+			// layout is given) are read from the SPIR-V of the shaders in use by
+			// nv::device::create_pipeline(). A binding given here overrides the
+			// type and count of the one of the shaders, e.g. to make a uniform
+			// buffer dynamic, and must precede creation. Pipelines with equal
+			// bindings share their set layouts, and so can their descriptor sets.
+			void use_binding(const uint32_t set, const uint32_t binding, const VkDescriptorType type,
+			                 const VkShaderStageFlags stages, const uint32_t count = 1);
+
+			// NOTE: the number of sets, including the ones of the shaders once created.
+			uint32_t set_count() const;
+
+			bool is_compute() const;
+
+			// NOTE: the specialization constants of the n-th shader in use, from a
+			// struct T as for nv::shader::specialize(). Every distinct set of
+			// constants is a variant of the pipeline, created once, by the next
+			// nv::device::create_pipeline(), and kept until destroy_pipeline().
+			// Variants already created are only selected again.
+			template <typename T, typename... C>
+			void specialize(const uint32_t n, const T &values)
+			{
+				nv::vulkan::specialization s;
+
+				s.set<T, C...>(values);
+				this->interface.specialize(n, s);
+			}
+
+			uint32_t variant_count() const;
+
+			// NOTE: a vertex layout (nv::vulkan::vertex_layout or vertex_streams),
+			// described at compile time. Its bindings and locations follow those of
+			// the layouts given before, e.g. per-vertex data then per-instance data.
+			template <typename L, VkVertexInputRate R = VK_VERTEX_INPUT_RATE_VERTEX>
+			void use_vertex_layout()
+			{
+				static constexpr auto input = L::describe(R);
+
+				this->interface.add(input.binding.data(), input.binding.size(),
+				                    input.attribute.data(), input.attribute.size());
+			}
+
+			// NOTE: a range of push constants, also to be given before creation,
+			// replacing the single range of the shaders.
+			void use_push_constants(const VkShaderStageFlags stages, const uint32_t size,
+			                        const uint32_t offset = 0);
+
+			// NOTE: the stages to give nv::renderer::push_constants(), i.e. every
+			// stage of the layout that declares push constants, once created.
+			VkShaderStageFlags push_constant_stages() const;
+
+			// NOTE: the local size of a compute shader along an axis (0 to 2), once
+			// created, to size dispatches by. An axis set by a specialization
+			// constant takes its value in the variant selected.
+			uint32_t local_size(const uint32_t axis) const;
+
 			~pipeline();
 
+			friend void nv::device::create_pipeline(nv::pipeline &pl, const nv::renderer &r) const;
+
 			friend void nv::device::create_pipeline(nv::pipeline &pl) const;
 
+			friend void nv::device::create_pipelines(const std::vector<nv::pipeline*> &list, const nv::renderer &r) const;
+
 			friend void nv::device::destroy_pipeline(nv::pipeline &pl) const;
 
+			friend void nv::renderer::draw(const nv::pipeline &pl, const uint32_t vertex_count);
+
+			friend void nv::renderer::draw(const nv::pipeline &pl, const uint32_t vertex_count,
+			                               const VkDescriptorSet *sets, const uint32_t set_count,
+			                               const uint32_t *offsets, const uint32_t offset_count);
+
+			friend void nv::renderer::draw_indexed(const nv::pipeline &pl, const uint32_t index_count,
+			                                       const VkDescriptorSet *sets, const uint32_t set_count,
+			                                       const uint32_t *offsets, const uint32_t offset_count);
+
+			friend bool nv::renderer::draw_batch(const nv::pipeline &pl, const VkDrawIndexedIndirectCommand *items,
+			                                     const uint32_t count,
+			                                     const VkDescriptorSet *sets, const uint32_t set_count,
+			                                     const uint32_t *offsets, const uint32_t offset_count);
+
+			friend void nv::renderer::draw_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+			                                        const VkDeviceSize offset, const uint32_t count,
+			                                        const VkDescriptorSet *sets, const uint32_t set_count,
+			                                        const uint32_t *offsets, const uint32_t offset_count);
+
+			friend void nv::renderer::draw_indirect_count(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+			                                              const VkDeviceSize offset,
+			                                              const nv::vulkan::buffer &counter,
+			                                              const VkDeviceSize counter_offset,
+			                                              const uint32_t max_count,
+			                                              const VkDescriptorSet *sets, const uint32_t set_count,
+			                                              const uint32_t *offsets, const uint32_t offset_count);
+
+			friend void nv::renderer::dispatch(const nv::pipeline &pl, const uint32_t x, const uint32_t y, const uint32_t z,
+			                                   const VkDescriptorSet *sets, const uint32_t set_count,
+			                                   const uint32_t *offsets, const uint32_t offset_count);
+
+			friend void nv::renderer::dispatch_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &b,
+			                                            const VkDeviceSize offset,
+			                                            const VkDescriptorSet *sets, const uint32_t set_count,
+			                                            const uint32_t *offsets, const uint32_t offset_count);
+
+			friend VkDescriptorSet nv::renderer::allocate_set(const nv::pipeline &pl, const uint32_t set,
+			                                                  const std::vector<nv::vulkan::descriptor_binding> &binding);
+
+			friend VkDescriptorSet nv::device::descriptor_set(const nv::pipeline &pl, const uint32_t set,
+			                                                  const std::vector<nv::vulkan::descriptor_binding> &binding) const;
+
+			friend class nv::reloader;
+
 			private:
+			// NOTE: what the shaders in use declare, merged with what was given by
+			// hand, and the vertex inputs of the shaders unless a layout was given.
+			void reflect(nv::vulkan::reflection &r);
+
+			// NOTE: the vertex inputs of the shaders to p, read from a single
+			// interleaved vertex buffer if reflected (replacing the ones read
+			// before), otherwise only checked against the layout given.
+			static void use_inputs(nv::vulkan::pipeline &p, const nv::vulkan::reflection &r, const bool reflected);
+
+			std::vector<std::vector<VkDescriptorSetLayoutBinding>> bindings;
+			std::vector<VkPushConstantRange> ranges;
+			uint32_t group[3];
+			uint32_t group_id[3];
+			bool reflected;
 			nv::vulkan::layout layout;
 			nv::vulkan::viewport viewport;
 			nv::vulkan::rasterizer rasterizer;
@@ -0,0 +1,173 @@
+#include <cstring>
+
+#include "debug.hpp"
+#include "profiler.hpp"
+
+nv::vulkan::profiler::profiler():
+	period(0.0),
+	mask(0),
+	capacity(0)
+{
+	this->setup.flags = 0;
+	this->setup.pNext = nullptr;
+	this->setup.queryCount = 0;
+	this->setup.pipelineStatistics = 0;
+	this->setup.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	this->setup.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+}
+
+void nv::vulkan::profiler::create(const nv::vulkan::device &d,
+                                  const nv::vulkan::physical_device &pd, const uint32_t index,
+                                  const uint32_t frames, const uint32_t scopes)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(index < pd.count())
+	ASSERT(frames > 0)
+
+	// NOTE: timestamps are written by the graphics queue, whose family may
+	// not support them at all (zero valid bits).
+
+	const uint32_t bits = d.family[d.family_index[NV_QUEUE_GRAPHICS]].timestampValidBits;
+
+	this->period = pd.properties[index].limits.timestampPeriod;
+	this->mask = (bits >= 64)? UINT64_MAX : ((uint64_t(1) << bits) - 1);
+
+	this->used.assign(frames, 0);
+	this->name.assign(frames, {});
+	this->result.clear();
+
+	if (bits == 0) return;
+
+	this->capacity = scopes;
+	this->setup.queryCount = 2*scopes;
+
+	// NOTE: a value and an availability word per query.
+	this->data.resize(2*this->setup.queryCount);
+	this->handle.resize(frames, VK_NULL_HANDLE);
+
+	for (uint32_t n = 0; n < frames; ++n)
+	{
+		const VkResult error = vkCreateQueryPool(d.handle, &this->setup, nullptr, &this->handle[n]);
+		NV_VULKAN_ERROR("vkCreateQueryPool()", error)
+
+		this->name[n].reserve(scopes);
+	}
+}
+
+bool nv::vulkan::profiler::is_supported() const
+{
+	return (this->handle.size() > 0);
+}
+
+void nv::vulkan::profiler::collect(const nv::vulkan::device &d, const uint32_t n)
+{
+	ASSERT(n < this->used.size())
+
+	if (this->used[n] == 0) return;
+
+	const uint32_t count = 2*this->used[n];
+
+	// NOTE: no WAIT_BIT, the fence of the slot has signaled already and
+	// queries still unavailable (e.g. a scope never ended) are skipped.
+
+	vkGetQueryPoolResults(d.handle, this->handle[n], 0, count,
+	                      count*2*sizeof(uint64_t), this->data.data(), 2*sizeof(uint64_t),
+	                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	this->result.clear();
+
+	for (uint32_t k = 0; k < this->used[n]; ++k)
+	{
+		const uint64_t *start = &this->data[4*k];
+		const uint64_t *stop = &this->data[4*k + 2];
+
+		if ((start[1] == 0) || (stop[1] == 0)) continue;
+
+		const uint64_t ticks = (stop[0] - start[0]) & this->mask;
+		this->result.push_back({this->name[n][k], ticks*this->period*1e-6});
+	}
+
+	this->used[n] = 0;
+	this->name[n].clear();
+}
+
+void nv::vulkan::profiler::reset(const nv::vulkan::command_buffer &cb, const uint32_t n)
+{
+	if (!this->is_supported()) return;
+
+	ASSERT(n < this->handle.size())
+	ASSERT(n < cb.handle.size())
+
+	// NOTE: to be recorded outside of any render pass, before the first scope.
+	vkCmdResetQueryPool(cb.handle[n], this->handle[n], 0, this->setup.queryCount);
+
+	this->used[n] = 0;
+	this->name[n].clear();
+}
+
+uint32_t nv::vulkan::profiler::begin(const nv::vulkan::command_buffer &cb, const uint32_t n, const char *name,
+                                     const VkPipelineStageFlagBits stage)
+{
+	if (!this->is_supported() || (this->used[n] >= this->capacity)) return UINT32_MAX;
+
+	ASSERT(n < cb.handle.size())
+
+	const uint32_t scope = this->used[n]++;
+
+	this->name[n].push_back(name);
+	vkCmdWriteTimestamp(cb.handle[n], stage, this->handle[n], 2*scope);
+
+	return scope;
+}
+
+void nv::vulkan::profiler::end(const nv::vulkan::command_buffer &cb, const uint32_t n, const uint32_t scope,
+                               const VkPipelineStageFlagBits stage)
+{
+	if (scope == UINT32_MAX) return;
+
+	ASSERT(n < cb.handle.size())
+	ASSERT(scope < this->used[n])
+
+	vkCmdWriteTimestamp(cb.handle[n], stage, this->handle[n], 2*scope + 1);
+}
+
+double nv::vulkan::profiler::milliseconds(const char *name) const
+{
+	double total = -1.0;
+
+	for (const auto &t : this->result)
+	{
+		if (std::strcmp(t.name, name) != 0) continue;
+
+		total = (total < 0.0)? t.milliseconds : total + t.milliseconds;
+	}
+
+	return total;
+}
+
+void nv::vulkan::profiler::destroy(const nv::vulkan::device &d)
+{
+	if (this->handle.size() > 0)
+	{
+		ASSERT(d.handle != nullptr)
+
+		for (auto h : this->handle)
+			vkDestroyQueryPool(d.handle, h, nullptr);
+	}
+
+	this->handle.clear();
+	this->used.clear();
+	this->name.clear();
+	this->data.clear();
+	this->result.clear();
+	this->capacity = 0;
+}
+
+nv::vulkan::profiler::~profiler()
+{
+	if (this->handle.size() > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::profiler instance before calling nv::vulkan::profiler::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,70 @@
+#if !defined(NV_PROFILER_HEADER)
+	#define NV_PROFILER_HEADER
+	#include <vector>
+
+	#include "vulkan.hpp"
+
+	#if !defined(NV_PROFILER_SCOPES)
+		#define NV_PROFILER_SCOPES 64
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a profiler owns one timestamp query pool per frame slot, with a
+			// pair of queries (start and end) for each scope written in a frame. The
+			// results of a slot are only read once its fence has signaled, right
+			// before the slot is recorded again, and without waiting on the queries,
+			// thus the timings lag behind by as many frames as there are in flight.
+
+			struct profiler
+			{
+				profiler();
+
+				void create(const nv::vulkan::device &d,
+				            const nv::vulkan::physical_device &pd, const uint32_t index,
+				            const uint32_t frames, const uint32_t scopes = NV_PROFILER_SCOPES);
+
+				bool is_supported() const;
+
+				void collect(const nv::vulkan::device &d, const uint32_t n);
+
+				void reset(const nv::vulkan::command_buffer &cb, const uint32_t n);
+
+				// NOTE: name must outlive the frame, typically a string literal. A
+				// return of UINT32_MAX means the scope is not measured, either for lack
+				// of queries left in this frame or of timestamp support.
+				uint32_t begin(const nv::vulkan::command_buffer &cb, const uint32_t n, const char *name,
+				               const VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+				void end(const nv::vulkan::command_buffer &cb, const uint32_t n, const uint32_t scope,
+				         const VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+				// NOTE: the sum of every scope of that name in the last frame resolved,
+				// or a negative value if there is none.
+				double milliseconds(const char *name) const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				~profiler();
+
+				struct timing
+				{
+					const char *name;
+					double milliseconds;
+				};
+
+				double period;
+				uint64_t mask;
+				uint32_t capacity;
+				std::vector<VkQueryPool> handle;
+				std::vector<uint32_t> used;
+				std::vector<std::vector<const char*>> name;
+				std::vector<uint64_t> data;
+				std::vector<timing> result;
+				VkQueryPoolCreateInfo setup;
+			};
+		}
+	}
+#endif
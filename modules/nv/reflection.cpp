@@ -0,0 +1,599 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "debug.hpp"
+#include "reflection.hpp"
+
+#define NV_SPIRV_MAGIC 0x07230203
+
+// NOTE: the few instructions, decorations and storage classes that a layout
+// depends on, with their numbers from the SPIR-V specification.
+
+enum spirv_op : uint32_t
+{
+	op_execution_mode = 16,
+	op_type_int = 21,
+	op_type_float = 22,
+	op_type_vector = 23,
+	op_type_matrix = 24,
+	op_type_image = 25,
+	op_type_sampler = 26,
+	op_type_sampled_image = 27,
+	op_type_array = 28,
+	op_type_runtime_array = 29,
+	op_type_struct = 30,
+	op_type_pointer = 32,
+	op_constant = 43,
+	op_constant_composite = 44,
+	op_spec_constant = 50,
+	op_spec_constant_composite = 51,
+	op_variable = 59,
+	op_decorate = 71,
+	op_member_decorate = 72,
+	op_execution_mode_id = 331
+};
+
+enum spirv_decoration : uint32_t
+{
+	decoration_spec_id = 1,
+	decoration_block = 2,
+	decoration_buffer_block = 3,
+	decoration_array_stride = 6,
+	decoration_matrix_stride = 7,
+	decoration_builtin = 11,
+	decoration_location = 30,
+	decoration_binding = 33,
+	decoration_descriptor_set = 34,
+	decoration_offset = 35
+};
+
+enum spirv_storage : uint32_t
+{
+	storage_uniform_constant = 0,
+	storage_input = 1,
+	storage_uniform = 2,
+	storage_push_constant = 9,
+	storage_buffer = 12
+};
+
+#define NV_SPIRV_LOCAL_SIZE 17
+#define NV_SPIRV_LOCAL_SIZE_ID 38
+#define NV_SPIRV_WORKGROUP_SIZE 25
+#define NV_SPIRV_DIM_BUFFER 5
+#define NV_SPIRV_DIM_SUBPASS 6
+#define NV_SPIRV_MAX_BOUND 0x3FFFFF
+#define NV_SPIRV_NONE 0xFFFFFFFF
+
+// NOTE: an id of the code, i.e. a type, a constant or a variable, with the
+// decorations it was given. Id 0 is never valid, thus it stands for every
+// id out of bounds.
+
+struct spirv_id
+{
+	spirv_id():
+		op(0),
+		type(0),
+		storage(0),
+		count(0),
+		width(0),
+		sign(0),
+		dim(0),
+		sampled(0),
+		value(0),
+		set(0),
+		binding(NV_SPIRV_NONE),
+		location(NV_SPIRV_NONE),
+		stride(0),
+		spec_id(NV_SPIRV_NONE),
+		builtin(false),
+		block(false),
+		buffer_block(false)
+	{
+	}
+
+	uint32_t op;
+	uint32_t type;
+	uint32_t storage;
+	uint32_t count;
+	uint32_t width;
+	uint32_t sign;
+	uint32_t dim;
+	uint32_t sampled;
+	uint32_t value;
+	uint32_t set;
+	uint32_t binding;
+	uint32_t location;
+	uint32_t stride;
+	uint32_t spec_id;
+	bool builtin;
+	bool block;
+	bool buffer_block;
+	std::vector<uint32_t> members;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> matrix_strides;
+};
+
+static spirv_id &at(std::vector<spirv_id> &ids, const uint32_t id)
+{
+	return ids[(id < ids.size())? id : 0];
+}
+
+static void grow(std::vector<uint32_t> &v, const uint32_t n)
+{
+	if (n >= v.size()) v.resize(n + 1, 0);
+}
+
+// NOTE: the size of a type in a block, from its explicit offsets and strides,
+// with a depth limit against cycles in malformed code.
+
+static uint32_t size_of(std::vector<spirv_id> &ids, const uint32_t type, const uint32_t matrix_stride,
+                        const uint32_t depth = 0)
+{
+	if (depth > 16) return 0;
+
+	const auto &t = at(ids, type);
+
+	switch (t.op)
+	{
+		case op_type_int:
+		case op_type_float:
+			return t.width/8;
+
+		case op_type_vector:
+			return t.count*size_of(ids, t.type, 0, depth + 1);
+
+		case op_type_matrix:
+			return t.count*((matrix_stride > 0)? matrix_stride : size_of(ids, t.type, 0, depth + 1));
+
+		case op_type_array:
+			return at(ids, t.count).value*((t.stride > 0)? t.stride : size_of(ids, t.type, matrix_stride, depth + 1));
+
+		case op_type_struct:
+		{
+			uint32_t size = 0;
+
+			for (uint32_t m = 0; m < t.members.size(); ++m)
+			{
+				const uint32_t offset = (m < t.offsets.size())? t.offsets[m] : 0;
+				const uint32_t stride = (m < t.matrix_strides.size())? t.matrix_strides[m] : 0;
+
+				size = std::max(size, offset + size_of(ids, t.members[m], stride, depth + 1));
+			}
+
+			return size;
+		}
+
+		default:
+			return 0;
+	}
+}
+
+static VkFormat format_of(std::vector<spirv_id> &ids, const uint32_t type)
+{
+	static const VkFormat sfloat32[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+	static const VkFormat sfloat64[] = {VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT};
+	static const VkFormat sint32[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+	static const VkFormat uint32[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+	const auto &t = at(ids, type);
+	const auto &c = (t.op == op_type_vector)? at(ids, t.type) : t;
+	const uint32_t count = (t.op == op_type_vector)? t.count : 1;
+
+	if ((count < 1) || (count > 4)) return VK_FORMAT_UNDEFINED;
+
+	if ((c.op == op_type_float) && (c.width == 32)) return sfloat32[count - 1];
+	if ((c.op == op_type_float) && (c.width == 64)) return sfloat64[count - 1];
+	if ((c.op == op_type_int) && (c.width == 32)) return (c.sign != 0)? sint32[count - 1] : uint32[count - 1];
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+static bool is_compatible(const VkDescriptorType x, const VkDescriptorType y)
+{
+	const auto plain = [](const VkDescriptorType t)
+	{
+		if (t == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		if (t == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		return t;
+	};
+
+	return plain(x) == plain(y);
+}
+
+//
+// nv::vulkan::reflection
+//
+
+nv::vulkan::reflection::reflection():
+	stride(0)
+{
+	this->local_size[0] = 1;
+	this->local_size[1] = 1;
+	this->local_size[2] = 1;
+
+	this->local_size_id[0] = NV_SPIRV_NONE;
+	this->local_size_id[1] = NV_SPIRV_NONE;
+	this->local_size_id[2] = NV_SPIRV_NONE;
+}
+
+bool nv::vulkan::reflection::add(const nv::vulkan::spirv &code, const VkShaderStageFlagBits stage)
+{
+	const uint32_t *word = static_cast<const uint32_t*>(code.data);
+	const size_t size = code.size/4;
+
+	if ((word == nullptr) || (size < 5) || (word[0] != NV_SPIRV_MAGIC))
+	{
+		PRINT_ERROR("%s is not a SPIR-V file\n", code.name.c_str())
+		return false;
+	}
+
+	// NOTE: every id is defined by an instruction of at least two words, yet
+	// the bound need not be tight, e.g. after unused ids were stripped; one
+	// far larger than the file allows is rejected before ids is allocated.
+
+	if ((word[3] > NV_SPIRV_MAX_BOUND) || (word[3] > 4*size))
+	{
+		PRINT_ERROR("%s is not a valid SPIR-V file\n", code.name.c_str())
+		return false;
+	}
+
+	std::vector<spirv_id> ids(std::max<uint32_t>(word[3], 1));
+	std::vector<uint32_t> variables;
+
+	// NOTE: the ids of the local size, if given by OpExecutionModeId, and the
+	// WorkgroupSize builtin, which overrides any local size.
+	uint32_t size_ids[3] = {0, 0, 0};
+	uint32_t workgroup = 0;
+
+	// NOTE: the attributes of earlier calls are packed already.
+	const size_t packed = this->attributes.size();
+
+	for (size_t n = 5; n < size;)
+	{
+		const uint32_t count = word[n] >> 16;
+		const uint32_t op = word[n] & 0xFFFF;
+		const uint32_t *arg = word + n + 1;
+
+		if ((count == 0) || (n + count > size))
+		{
+			PRINT_ERROR("%s is not a valid SPIR-V file\n", code.name.c_str())
+			return false;
+		}
+
+		// NOTE: instructions too short for their operands are skipped.
+
+		switch (op)
+		{
+			case op_execution_mode:
+				if ((count >= 6) && (arg[1] == NV_SPIRV_LOCAL_SIZE))
+				{
+					this->local_size[0] = arg[2];
+					this->local_size[1] = arg[3];
+					this->local_size[2] = arg[4];
+				}
+				break;
+
+			case op_execution_mode_id:
+				if ((count >= 6) && (arg[1] == NV_SPIRV_LOCAL_SIZE_ID))
+				{
+					size_ids[0] = arg[2];
+					size_ids[1] = arg[3];
+					size_ids[2] = arg[4];
+				}
+				break;
+
+			case op_type_int:
+				if (count < 4) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).width = arg[1];
+				at(ids, arg[0]).sign = arg[2];
+				break;
+
+			case op_type_float:
+				if (count < 3) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).width = arg[1];
+				break;
+
+			case op_type_vector:
+			case op_type_matrix:
+			case op_type_array:
+				if (count < 4) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).type = arg[1];
+				at(ids, arg[0]).count = arg[2];
+				break;
+
+			case op_type_image:
+				if (count < 9) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).dim = arg[2];
+				at(ids, arg[0]).sampled = arg[6];
+				break;
+
+			case op_type_sampler:
+				if (count < 2) break;
+				at(ids, arg[0]).op = op;
+				break;
+
+			case op_type_sampled_image:
+			case op_type_runtime_array:
+				if (count < 3) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).type = arg[1];
+				break;
+
+			case op_type_struct:
+				if (count < 2) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).members.assign(arg + 1, arg + count - 1);
+				break;
+
+			case op_type_pointer:
+				if (count < 4) break;
+				at(ids, arg[0]).op = op;
+				at(ids, arg[0]).storage = arg[1];
+				at(ids, arg[0]).type = arg[2];
+				break;
+
+			case op_constant:
+			case op_spec_constant:
+				if (count < 4) break;
+				at(ids, arg[1]).op = op;
+				at(ids, arg[1]).type = arg[0];
+				at(ids, arg[1]).value = arg[2];
+				break;
+
+			case op_constant_composite:
+			case op_spec_constant_composite:
+				if (count < 3) break;
+				at(ids, arg[1]).op = op;
+				at(ids, arg[1]).type = arg[0];
+				at(ids, arg[1]).members.assign(arg + 2, arg + count - 1);
+				break;
+
+			case op_variable:
+				if (count < 4) break;
+				at(ids, arg[1]).op = op;
+				at(ids, arg[1]).type = arg[0];
+				at(ids, arg[1]).storage = arg[2];
+				variables.push_back(arg[1]);
+				break;
+
+			case op_decorate:
+			{
+				if (count < 3) break;
+
+				auto &t = at(ids, arg[0]);
+				const uint32_t value = (count > 3)? arg[2] : 0;
+
+				if ((arg[1] == decoration_builtin) && (value == NV_SPIRV_WORKGROUP_SIZE)) workgroup = arg[0];
+
+				if (arg[1] == decoration_block) t.block = true;
+				else if (arg[1] == decoration_buffer_block) t.buffer_block = true;
+				else if (arg[1] == decoration_builtin) t.builtin = true;
+				else if (arg[1] == decoration_spec_id) t.spec_id = value;
+				else if (arg[1] == decoration_array_stride) t.stride = value;
+				else if (arg[1] == decoration_location) t.location = value;
+				else if (arg[1] == decoration_binding) t.binding = value;
+				else if (arg[1] == decoration_descriptor_set) t.set = value;
+				break;
+			}
+
+			case op_member_decorate:
+			{
+				if (count < 5) break;
+
+				auto &t = at(ids, arg[0]);
+
+				if (arg[2] == decoration_builtin) t.builtin = true;
+
+				if (arg[2] == decoration_offset)
+				{
+					grow(t.offsets, arg[1]);
+					t.offsets[arg[1]] = arg[3];
+				}
+
+				if (arg[2] == decoration_matrix_stride)
+				{
+					grow(t.matrix_strides, arg[1]);
+					t.matrix_strides[arg[1]] = arg[3];
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		n += count;
+	}
+
+	// NOTE: the constants of a local size given by ids, e.g. made of the
+	// specialization constants of local_size_x_id, are only defined after
+	// the execution modes and decorations.
+
+	const auto &w = at(ids, workgroup);
+	const uint32_t *axes = ((workgroup != 0) && (w.members.size() == 3))? w.members.data() : nullptr;
+
+	if ((axes == nullptr) && (size_ids[0] != 0)) axes = size_ids;
+
+	for (uint32_t a = 0; (axes != nullptr) && (a < 3); ++a)
+	{
+		const auto &c = at(ids, axes[a]);
+
+		if ((c.op != op_constant) && (c.op != op_spec_constant)) continue;
+
+		this->local_size[a] = c.value;
+		this->local_size_id[a] = (c.op == op_spec_constant)? c.spec_id : NV_SPIRV_NONE;
+	}
+
+	for (const uint32_t v : variables)
+	{
+		const auto &var = at(ids, v);
+		const auto &pointer = at(ids, var.type);
+		uint32_t type = pointer.type;
+
+		if (var.storage == storage_push_constant)
+		{
+			const auto &block = at(ids, type);
+
+			if (block.op != op_type_struct) continue;
+
+			const uint32_t first = block.offsets.empty()? 0 : *std::min_element(block.offsets.begin(), block.offsets.end());
+			const uint32_t offset = first & ~3u;
+			const uint32_t end = (size_of(ids, type, 0) + 3) & ~3u;
+
+			if (end <= offset) continue;
+
+			// NOTE: a single range that covers every stage is always valid, and
+			// makes a single vkCmdPushConstants() enough.
+
+			if (this->ranges.empty())
+				this->ranges.push_back({static_cast<VkShaderStageFlags>(stage), offset, end - offset});
+			else
+			{
+				auto &r = this->ranges.front();
+				const uint32_t last = std::max(r.offset + r.size, end);
+
+				r.stageFlags |= stage;
+				r.offset = std::min(r.offset, offset);
+				r.size = last - r.offset;
+			}
+			continue;
+		}
+
+		if ((var.storage == storage_input) && (stage == VK_SHADER_STAGE_VERTEX_BIT))
+		{
+			if (var.builtin || at(ids, type).builtin || (var.location == NV_SPIRV_NONE)) continue;
+
+			// NOTE: a matrix takes a location per column.
+
+			const auto &t = at(ids, type);
+			const uint32_t columns = (t.op == op_type_matrix)? t.count : 1;
+			const uint32_t column = (t.op == op_type_matrix)? t.type : type;
+
+			for (uint32_t c = 0; c < columns; ++c)
+			{
+				const VkFormat format = format_of(ids, column);
+
+				if (format == VK_FORMAT_UNDEFINED)
+				{
+					PRINT_ERROR("warning: the vertex input at location %u of %s has no matching format\n", var.location + c, code.name.c_str())
+					continue;
+				}
+
+				// NOTE: the size of the format is kept in the offset until sorted.
+				this->attributes.push_back({var.location + c, 0, format, size_of(ids, column, 0)});
+			}
+			continue;
+		}
+
+		if ((var.storage != storage_uniform_constant) && (var.storage != storage_uniform)
+		 && (var.storage != storage_buffer)) continue;
+
+		if (var.binding == NV_SPIRV_NONE) continue;
+
+		// NOTE: an array of resources is as many descriptors of one binding, a
+		// runtime array being counted as one unless given by hand.
+
+		uint32_t descriptors = 1;
+
+		while ((at(ids, type).op == op_type_array) || (at(ids, type).op == op_type_runtime_array))
+		{
+			const auto &a = at(ids, type);
+
+			if (a.op == op_type_array) descriptors *= at(ids, a.count).value;
+			if (a.type == type) break;
+
+			type = a.type;
+		}
+
+		const auto &t = at(ids, type);
+		VkDescriptorSetLayoutBinding b;
+
+		b.binding = var.binding;
+		b.descriptorCount = descriptors;
+		b.stageFlags = stage;
+		b.pImmutableSamplers = nullptr;
+
+		if (var.storage == storage_buffer)
+			b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		else if (var.storage == storage_uniform)
+			b.descriptorType = t.buffer_block? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		else if (t.op == op_type_sampler)
+			b.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		else if (t.op == op_type_sampled_image)
+			b.descriptorType = (at(ids, t.type).dim == NV_SPIRV_DIM_BUFFER)? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		else if ((t.op == op_type_image) && (t.dim == NV_SPIRV_DIM_SUBPASS))
+			b.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		else if ((t.op == op_type_image) && (t.dim == NV_SPIRV_DIM_BUFFER))
+			b.descriptorType = (t.sampled == 2)? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		else if (t.op == op_type_image)
+			b.descriptorType = (t.sampled == 2)? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		else
+			continue;
+
+		this->add(var.set, b);
+	}
+
+	// NOTE: the inputs are packed one after the other, in location order.
+
+	std::sort(this->attributes.begin() + packed, this->attributes.end(),
+		[](const VkVertexInputAttributeDescription &x, const VkVertexInputAttributeDescription &y) { return x.location < y.location; });
+
+	for (size_t n = packed; n < this->attributes.size(); ++n)
+	{
+		auto &a = this->attributes[n];
+		const uint32_t size = a.offset;
+
+		a.offset = this->stride;
+		this->stride += size;
+	}
+
+	return true;
+}
+
+void nv::vulkan::reflection::add(const uint32_t set, const VkDescriptorSetLayoutBinding &b)
+{
+	if (set >= this->sets.size()) this->sets.resize(set + 1);
+
+	for (auto &other : this->sets[set])
+	{
+		if (other.binding != b.binding) continue;
+
+		if ((other.descriptorType != b.descriptorType) || (other.descriptorCount != b.descriptorCount))
+			PRINT_ERROR("warning: binding %u of set %u differs from one stage to another\n", b.binding, set)
+
+		other.stageFlags |= b.stageFlags;
+		return;
+	}
+
+	this->sets[set].push_back(b);
+}
+
+void nv::vulkan::reflection::assign(const uint32_t set, const VkDescriptorSetLayoutBinding &b)
+{
+	if (set >= this->sets.size()) this->sets.resize(set + 1);
+
+	for (auto &other : this->sets[set])
+	{
+		if (other.binding != b.binding) continue;
+
+		if (!is_compatible(other.descriptorType, b.descriptorType))
+			PRINT_ERROR("warning: binding %u of set %u is given a type that its shaders do not declare\n", b.binding, set)
+
+		other.descriptorType = b.descriptorType;
+		other.descriptorCount = b.descriptorCount;
+		other.stageFlags |= b.stageFlags;
+		other.pImmutableSamplers = b.pImmutableSamplers;
+		return;
+	}
+
+	this->sets[set].push_back(b);
+}
+
+nv::vulkan::reflection::~reflection()
+{
+}
@@ -0,0 +1,53 @@
+#if !defined(NV_REFLECTION_HEADER)
+	#define NV_REFLECTION_HEADER
+	#include <vulkan/vulkan.h>
+	#include <vector>
+
+	#include "module.hpp"
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: what the SPIR-V code of the stages of a pipeline declares, i.e.
+			// its descriptors set by set, its push constants, the inputs of its
+			// vertex stage and the local size of its compute stage, all stages
+			// being merged together.
+
+			struct reflection
+			{
+				reflection();
+
+				// NOTE: false if the code is not valid SPIR-V, leaving the rest as is.
+				bool add(const nv::vulkan::spirv &code, const VkShaderStageFlagBits stage);
+
+				// NOTE: a descriptor of a stage, whose stages add to the ones of the
+				// same binding in other stages.
+				void add(const uint32_t set, const VkDescriptorSetLayoutBinding &b);
+
+				// NOTE: a descriptor given by hand, whose type and count override the
+				// ones of the code, e.g. a dynamic uniform buffer rather than a plain
+				// one, which SPIR-V does not tell apart.
+				void assign(const uint32_t set, const VkDescriptorSetLayoutBinding &b);
+
+				~reflection();
+
+				std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+
+				// NOTE: a single range for every stage, unless given by hand.
+				std::vector<VkPushConstantRange> ranges;
+
+				// NOTE: the inputs of the vertex stage, in location order, at the
+				// offsets of a single interleaved vertex of the given stride.
+				std::vector<VkVertexInputAttributeDescription> attributes;
+				uint32_t stride;
+
+				// NOTE: the local size of the compute stage, and the id of the
+				// specialization constant that sets each axis (UINT32_MAX if none),
+				// whose value then replaces the default one of local_size.
+				uint32_t local_size[3];
+				uint32_t local_size_id[3];
+			};
+		}
+	}
+#endif
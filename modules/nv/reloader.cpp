@@ -0,0 +1,565 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <set>
+#include <sstream>
+#include <algorithm>
+
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "debug.hpp"
+#include "reloader.hpp"
+
+static bool ends_with(const std::string &s, const char *suffix)
+{
+	const std::string end(suffix);
+
+	return (s.size() >= end.size()) && (s.compare(s.size() - end.size(), end.size(), end) == 0);
+}
+
+// NOTE: the stages that GLSL compilers tell from the extension.
+static bool is_source(const std::string &name)
+{
+	static const char *extension[] = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"};
+
+	for (const auto e : extension)
+		if (ends_with(name, e)) return true;
+
+	return false;
+}
+
+// NOTE: runs a program with its arguments, looked up in the PATH, without a
+// shell, thus a file name is never taken for a command. True if it exits with
+// a status of zero.
+static bool run(const std::vector<std::string> &arguments)
+{
+	std::vector<char*> argv;
+
+	for (const auto &a : arguments)
+		argv.push_back(const_cast<char*>(a.c_str()));
+
+	argv.push_back(nullptr);
+
+	pid_t child;
+
+	if (posix_spawnp(&child, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return false;
+
+	int status = 0;
+
+	while (waitpid(child, &status, 0) < 0)
+		if (errno != EINTR) return false;
+
+	return WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+// NOTE: the same file under any name, e.g. relative or absolute.
+static std::string canonical(const std::string &path)
+{
+	char *full = realpath(path.c_str(), nullptr);
+
+	if (full == nullptr) return path;
+
+	const std::string result(full);
+	std::free(full);
+
+	return result;
+}
+
+//
+// nv::reloader::job
+//
+
+nv::reloader::job::job():
+	target(nullptr),
+	failed(false),
+	reflected(false)
+{
+	this->group[0] = 1;
+	this->group[1] = 1;
+	this->group[2] = 1;
+
+	this->group_id[0] = UINT32_MAX;
+	this->group_id[1] = UINT32_MAX;
+	this->group_id[2] = UINT32_MAX;
+}
+
+bool nv::reloader::job::covers(const nv::vulkan::pipeline &p) const
+{
+	auto known = [this](const std::vector<nv::vulkan::specialization> &c)
+	{
+		return std::find(this->variants.begin(), this->variants.end(), c) != this->variants.end();
+	};
+
+	if (!known(p.constants)) return false;
+
+	for (const auto &v : p.variants)
+		if (!known(v.constants)) return false;
+
+	return true;
+}
+
+//
+// nv::reloader
+//
+
+nv::reloader::reloader(const nv::device &d, const std::string &directory):
+	host(&d),
+	notify(inotify_init1(IN_CLOEXEC)),
+	wake(eventfd(0, EFD_CLOEXEC)),
+	quit(false),
+	running(nullptr)
+{
+	if ((this->notify < 0) || (this->wake < 0))
+	{
+		PRINT_ERROR("%s\n", "error: unable to watch files for changes")
+		exit(EXIT_FAILURE);
+	}
+
+	if (!directory.empty()) this->watch(directory);
+
+	this->thread = std::thread(&nv::reloader::loop, this);
+}
+
+bool nv::reloader::watch(const std::string &directory)
+{
+	// NOTE: editors and compilers either write a file in place or move a new
+	// one over it.
+
+	const int w = inotify_add_watch(this->notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+	if (w < 0)
+	{
+		PRINT_ERROR("warning: unable to watch %s\n", directory.c_str())
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	this->directories[w] = directory;
+	return true;
+}
+
+void nv::reloader::track(nv::pipeline &pl)
+{
+	if (std::find(this->tracked.begin(), this->tracked.end(), &pl) == this->tracked.end())
+		this->tracked.push_back(&pl);
+}
+
+void nv::reloader::forget(const nv::pipeline &pl)
+{
+	this->tracked.erase(std::remove(this->tracked.begin(), this->tracked.end(), &pl), this->tracked.end());
+
+	// NOTE: the rebuilds in progress go on, only to be discarded by update().
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	for (auto &j : this->pending)
+		if (j->target == &pl) j->target = nullptr;
+
+	for (auto &j : this->done)
+		if (j->target == &pl) j->target = nullptr;
+
+	if ((this->running != nullptr) && (this->running->target == &pl))
+		this->running->target = nullptr;
+}
+
+uint32_t nv::reloader::update(nv::renderer &r)
+{
+	ASSERT(r.host != nullptr)
+
+	std::vector<std::string> files;
+	std::vector<std::unique_ptr<job>> finished;
+
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+
+		files.swap(this->changed);
+		finished.swap(this->done);
+	}
+
+	uint32_t count = 0;
+	uint32_t scheduled = 0;
+	std::vector<VkPipeline> old;
+
+	for (auto &j : finished)
+	{
+		if ((j->target == nullptr) || j->failed)
+			this->discard(*j);
+		else if (!j->covers(j->target->interface))
+		{
+			// NOTE: variants created since the copy was made would be lost.
+
+			nv::pipeline &pl = *j->target;
+
+			this->discard(*j);
+			this->schedule(pl);
+			++scheduled;
+		}
+		else
+		{
+			this->swap(*j, old);
+			++count;
+		}
+	}
+
+	// NOTE: the frames submitted until now may still use the old pipelines.
+
+	if (old.size() > 0)
+	{
+		r.retired.emplace_back();
+		r.retired.back().frame = r.frame_number;
+		r.retired.back().pipelines.swap(old);
+	}
+
+	if (files.empty())
+	{
+		if (scheduled > 0) this->wake_up();
+		return count;
+	}
+
+	for (auto pl : this->tracked)
+	{
+		auto &code = pl->interface.code;
+
+		const bool affected = std::any_of(code.begin(), code.end(), [&files](const std::shared_ptr<const nv::vulkan::spirv> &c)
+		{
+			return std::find(files.begin(), files.end(), canonical(c->name)) != files.end();
+		});
+
+		if (!affected) continue;
+
+		// NOTE: a pipeline not created yet merely takes the new code.
+
+		if (pl->layout.handle == nullptr)
+		{
+			for (auto &c : code)
+			{
+				auto fresh = nv::vulkan::spirv::map(c->name);
+				if (fresh != nullptr) c = fresh;
+			}
+			continue;
+		}
+
+		this->schedule(*pl);
+		++scheduled;
+	}
+
+	if (scheduled > 0) this->wake_up();
+
+	return count;
+}
+
+void nv::reloader::wake_up() const
+{
+	const uint64_t one = 1;
+
+	if (write(this->wake, &one, sizeof(one)) != sizeof(one))
+		PRINT_ERROR("%s\n", "warning: unable to wake the reloader thread")
+}
+
+void nv::reloader::schedule(nv::pipeline &pl)
+{
+	std::unique_ptr<job> j(new job());
+
+	j->target = &pl;
+	j->reflected = pl.reflected;
+	j->viewport = pl.viewport;
+	j->rasterizer = pl.rasterizer;
+	j->multisampling = pl.multisampling;
+	j->blending = pl.blending;
+	j->stencil = pl.stencil;
+	j->bindings = pl.bindings;
+	j->ranges = pl.ranges;
+
+	j->viewport.setup.pViewports = &j->viewport.handle;
+	j->viewport.setup.pScissors = &j->viewport.scissor;
+	j->blending.setup.pAttachments = &j->blending.attachment;
+
+	// NOTE: the copy neither owns the variants nor the modules of the original.
+
+	j->interface = pl.interface;
+	j->interface.handle = nullptr;
+	j->interface.variants.clear();
+
+	// NOTE: nor does it derive from the parent of its batch, which may have
+	// been destroyed since, and none derives from the copy.
+
+	j->interface.setup.flags &= ~(VK_PIPELINE_CREATE_DERIVATIVE_BIT | VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT);
+	j->interface.setup.basePipelineHandle = VK_NULL_HANDLE;
+	j->interface.setup.basePipelineIndex = -1;
+
+	for (auto &s : j->interface.stage)
+		s.module = VK_NULL_HANDLE;
+
+	j->interface.add(j->viewport);
+	j->interface.add(j->rasterizer);
+	j->interface.add(j->multisampling);
+	j->interface.add(j->blending);
+	j->interface.add(j->stencil);
+
+	for (const auto &v : pl.interface.variants)
+		j->variants.push_back(v.constants);
+
+	if (!j->covers(pl.interface))
+		j->variants.push_back(pl.interface.constants);
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	this->pending.push_back(std::move(j));
+}
+
+void nv::reloader::loop()
+{
+	pollfd watched[2] = {{this->notify, POLLIN, 0}, {this->wake, POLLIN, 0}};
+
+	while (true)
+	{
+		if (poll(watched, 2, -1) < 0)
+		{
+			if (errno == EINTR) continue;
+
+			PRINT_ERROR("%s\n", "error: the reloader thread stopped watching files")
+			return;
+		}
+
+		if (watched[1].revents & POLLIN)
+		{
+			uint64_t count = 0;
+
+			if (read(this->wake, &count, sizeof(count)) != sizeof(count))
+				PRINT_ERROR("%s\n", "warning: unable to read the wake up count of the reloader thread")
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			if (this->quit) return;
+		}
+
+		if (watched[0].revents & POLLIN) this->read_events();
+
+		while (true)
+		{
+			std::unique_ptr<job> j;
+
+			{
+				std::lock_guard<std::mutex> guard(this->lock);
+
+				if (this->quit || this->pending.empty()) break;
+
+				j = std::move(this->pending.front());
+				this->pending.pop_front();
+				this->running = j.get();
+			}
+
+			this->rebuild(*j);
+
+			std::lock_guard<std::mutex> guard(this->lock);
+
+			this->running = nullptr;
+			this->done.push_back(std::move(j));
+		}
+	}
+}
+
+void nv::reloader::read_events()
+{
+	alignas(inotify_event) char buffer[4096];
+
+	const ssize_t length = read(this->notify, buffer, sizeof(buffer));
+
+	if (length <= 0) return;
+
+	// NOTE: a single save often comes as many events, thus each file is only
+	// handled once per read.
+
+	std::set<std::string> sources;
+	std::set<std::string> binaries;
+
+	for (ssize_t n = 0; n < length;)
+	{
+		const auto *e = reinterpret_cast<const inotify_event*>(buffer + n);
+		n += sizeof(inotify_event) + e->len;
+
+		if (e->len == 0) continue;
+
+		std::string path;
+
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+
+			auto d = this->directories.find(e->wd);
+			if (d == this->directories.end()) continue;
+
+			path = d->second + "/" + e->name;
+		}
+
+		if (ends_with(path, ".spv"))
+			binaries.insert(canonical(path));
+		else if (is_source(path))
+			sources.insert(path);
+	}
+
+	// NOTE: the SPIR-V files written come back as events of their own.
+
+	for (const auto &s : sources)
+		this->compile(s);
+
+	if (binaries.empty()) return;
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	this->changed.insert(this->changed.end(), binaries.begin(), binaries.end());
+}
+
+void nv::reloader::compile(const std::string &source) const
+{
+	// NOTE: the compiler writes a temporary file moved over the SPIR-V file,
+	// thus the code mapped from the old one never changes under a pipeline,
+	// and a failed compilation leaves it as it was.
+
+	const std::string target = source + ".spv";
+	const std::string temporary = target + ".tmp";
+
+	std::vector<std::string> arguments;
+	std::istringstream command(NV_RELOADER_COMPILER);
+
+	for (std::string word; command >> word;)
+		arguments.push_back(word);
+
+	arguments.insert(arguments.end(), {source, "-o", temporary});
+
+	if (!run(arguments))
+	{
+		PRINT_ERROR("warning: unable to compile %s\n", source.c_str())
+		unlink(temporary.c_str());
+		return;
+	}
+
+	if (rename(temporary.c_str(), target.c_str()) != 0)
+	{
+		PRINT_ERROR("warning: unable to replace %s\n", target.c_str())
+		unlink(temporary.c_str());
+	}
+}
+
+void nv::reloader::rebuild(job &j) const
+{
+	nv::vulkan::reflection shaders;
+
+	for (size_t n = 0; n < j.interface.code.size(); ++n)
+	{
+		auto fresh = nv::vulkan::spirv::map(j.interface.code[n]->name);
+
+		if ((fresh == nullptr) || !shaders.add(*fresh, j.interface.stage[n].stage))
+		{
+			j.failed = true;
+			return;
+		}
+
+		j.interface.code[n] = fresh;
+	}
+
+	for (uint32_t set = 0; set < j.bindings.size(); ++set)
+		for (const auto &b : j.bindings[set])
+			shaders.assign(set, b);
+
+	if (!j.ranges.empty()) shaders.ranges = j.ranges;
+
+	j.group[0] = shaders.local_size[0];
+	j.group[1] = shaders.local_size[1];
+	j.group[2] = shaders.local_size[2];
+
+	j.group_id[0] = shaders.local_size_id[0];
+	j.group_id[1] = shaders.local_size_id[1];
+	j.group_id[2] = shaders.local_size_id[2];
+
+	// NOTE: the shaders may now read other vertex inputs, read again unless
+	// the pipeline has a vertex layout of its own.
+
+	if (!j.interface.is_compute())
+		nv::pipeline::use_inputs(j.interface, shaders, j.reflected);
+
+	this->host->create_layout(shaders, j.layout);
+	j.interface.add(j.layout);
+	this->host->acquire_modules(j.interface);
+	j.interface.cache = this->host->cache.handle;
+
+	// NOTE: every variant here, so that none is compiled by the render
+	// thread once swapped.
+
+	const auto current = j.interface.constants;
+
+	for (const auto &c : j.variants)
+	{
+		j.interface.constants = c;
+		j.interface.handle = nullptr;
+		j.interface.create(this->host->interface);
+	}
+
+	j.interface.constants = current;
+}
+
+void nv::reloader::swap(job &j, std::vector<VkPipeline> &old) const
+{
+	nv::pipeline &pl = *j.target;
+
+	// NOTE: the modules may go at once, the pipelines made of them do not
+	// need them anymore.
+
+	this->host->release_modules(pl.interface);
+	pl.interface.replace(j.interface, old);
+
+	pl.layout.destroy(this->host->interface);
+
+	for (const auto l : j.layout.sets)
+		pl.layout.add(l);
+
+	for (const auto &c : j.layout.ranges)
+		pl.layout.add(c.stageFlags, c.offset, c.size);
+
+	pl.layout.share(j.layout.handle);
+	j.layout.destroy(this->host->interface);
+
+	pl.group[0] = j.group[0];
+	pl.group[1] = j.group[1];
+	pl.group[2] = j.group[2];
+
+	pl.group_id[0] = j.group_id[0];
+	pl.group_id[1] = j.group_id[1];
+	pl.group_id[2] = j.group_id[2];
+}
+
+void nv::reloader::discard(job &j) const
+{
+	// NOTE: such pipelines were never used by any frame.
+
+	j.interface.destroy(this->host->interface);
+	this->host->release_modules(j.interface);
+	j.layout.destroy(this->host->interface);
+}
+
+nv::reloader::~reloader()
+{
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->quit = true;
+	}
+
+	this->wake_up();
+	this->thread.join();
+
+	for (auto &j : this->pending)
+		this->discard(*j);
+
+	for (auto &j : this->done)
+		this->discard(*j);
+
+	close(this->notify);
+	close(this->wake);
+}
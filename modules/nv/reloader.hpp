@@ -0,0 +1,124 @@
+#if !defined(NV_RELOADER_HEADER)
+	#define NV_RELOADER_HEADER
+	#include <deque>
+	#include <mutex>
+	#include <memory>
+	#include <string>
+	#include <thread>
+	#include <vector>
+	#include <unordered_map>
+
+	#include "vulkan.hpp"
+	#include "device.hpp"
+	#include "renderer.hpp"
+	#include "pipeline.hpp"
+
+	// NOTE: the command that compiles a GLSL source, followed by the source and
+	// by -o and the SPIR-V file to write. It is split at blanks and run without
+	// a shell.
+
+	#if !defined(NV_RELOADER_COMPILER)
+		#define NV_RELOADER_COMPILER "glslangValidator -V"
+	#endif
+
+	#if !defined(NV_RELOADER_DIRECTORY)
+		#define NV_RELOADER_DIRECTORY "modules/shaders"
+	#endif
+
+	namespace nv
+	{
+		// NOTE: rebuilds the pipelines whose shaders change on disk, without a
+		// restart. A thread of its own watches directories with inotify: a GLSL
+		// source that changes (e.g. shader.frag) is compiled to the SPIR-V file
+		// next to it (shader.frag.spv), and a SPIR-V file that changes rebuilds
+		// every tracked pipeline made of it, on that thread as well. update(),
+		// called by the render thread between two frames, swaps the pipelines
+		// rebuilt since, the old ones being destroyed by the renderer once the
+		// frames that use them are complete.
+		//
+		// A rebuilt pipeline gets the layout of its new code, and every variant
+		// it had, all of them created on that thread. A pipeline that gets new
+		// variants meanwhile is rebuilt again. nv::shader instances keep the
+		// code they loaded.
+
+		class reloader
+		{
+			public:
+			explicit reloader(const nv::device &d, const std::string &directory = NV_RELOADER_DIRECTORY);
+
+			bool watch(const std::string &directory);
+
+			// NOTE: a pipeline to rebuild, until forget(), to be called before
+			// nv::device::destroy_pipeline().
+			void track(nv::pipeline &pl);
+
+			void forget(const nv::pipeline &pl);
+
+			// NOTE: the number of pipelines swapped.
+			uint32_t update(nv::renderer &r);
+
+			~reloader();
+
+			private:
+			// NOTE: a copy of a pipeline, with the fixed function state it points
+			// to, thus the original may change or go away during the rebuild.
+			struct job
+			{
+				job();
+
+				nv::pipeline *target;
+				bool failed;
+				bool reflected;
+				uint32_t group[3];
+				uint32_t group_id[3];
+				nv::vulkan::viewport viewport;
+				nv::vulkan::rasterizer rasterizer;
+				nv::vulkan::multisample multisampling;
+				nv::vulkan::color_blend blending;
+				nv::vulkan::depth_stencil stencil;
+				std::vector<std::vector<VkDescriptorSetLayoutBinding>> bindings;
+				std::vector<VkPushConstantRange> ranges;
+				nv::vulkan::layout layout;
+				nv::vulkan::pipeline interface;
+
+				// NOTE: the constants of every variant to rebuild, i.e. the ones of
+				// the original and its current ones.
+				std::vector<std::vector<nv::vulkan::specialization>> variants;
+
+				bool covers(const nv::vulkan::pipeline &p) const;
+			};
+
+			void loop();
+
+			void read_events();
+
+			void compile(const std::string &source) const;
+
+			void schedule(nv::pipeline &pl);
+
+			void rebuild(job &j) const;
+
+			void swap(job &j, std::vector<VkPipeline> &old) const;
+
+			void discard(job &j) const;
+
+			void wake_up() const;
+
+			const nv::device *host;
+			int notify;
+			int wake;
+			bool quit;
+			std::vector<nv::pipeline*> tracked;
+
+			// NOTE: shared with the thread, behind lock.
+			std::mutex lock;
+			std::unordered_map<int, std::string> directories;
+			std::vector<std::string> changed;
+			std::deque<std::unique_ptr<job>> pending;
+			std::vector<std::unique_ptr<job>> done;
+			job *running;
+
+			std::thread thread;
+		};
+	}
+#endif
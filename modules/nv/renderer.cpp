@@ -1,24 +1,951 @@
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
 #include "debug.hpp"
 #include "renderer.hpp"
+#include "pipeline.hpp"
+
+static double elapsed(const std::chrono::steady_clock::time_point &from,
+                      const std::chrono::steady_clock::time_point &to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+nv::renderer::renderer(const uint32_t frames, const uint32_t threads):
+	slot(0),
+	slot_count(frames),
+	image_index(0),
+	queue(nullptr),
+	host(nullptr),
+	memory(nullptr),
+	commands(nullptr),
+	outdated(false),
+	frame_number(0),
+	replay(false),
+	computing(false),
+	profiling(false),
+	profile(nullptr),
+	pacing(0),
+	thread_count(threads),
+	headless(false)
+{
+	ASSERT(frames > 0)
+	ASSERT(threads > 0)
+	ASSERT(frames <= NV_RENDERER_MAX_FRAMES_IN_FLIGHT)
+
+	this->pending.size = 0;
+	this->pending.stages = 0;
+	this->pending.offset = 0;
+	this->bound.stream_count = 0;
+	this->bound.indices = VK_NULL_HANDLE;
+	this->bound.index_offset = 0;
+	this->bound.index_type = VK_INDEX_TYPE_UINT16;
+
+	if (threads > 1) this->crew.reset(new nv::workers(threads));
+}
+
+uint32_t nv::renderer::frames_in_flight() const
+{
+	return this->slot_count;
+}
+
+uint32_t nv::renderer::recording_threads() const
+{
+	return this->thread_count;
+}
+
+uint32_t nv::renderer::current_frame() const
+{
+	return this->slot;
+}
+
+void nv::renderer::use_replay(const bool enable)
+{
+	if (enable && !this->replay) this->invalidate();
+
+	this->replay = enable;
+}
+
+bool nv::renderer::is_replaying() const
+{
+	return this->replay;
+}
+
+void nv::renderer::invalidate()
+{
+	// NOTE: to be called whenever a resource bound by the recorded commands
+	// changes, since such changes are not visible to the draw calls history.
+	this->dirty.assign(this->dirty.size(), true);
+}
+
+bool nv::renderer::is_outdated() const
+{
+	// NOTE: to be followed by a call to nv::device::renderer_resize().
+	return this->outdated;
+}
+
+void nv::renderer::use_profiling(const bool enable)
+{
+	// NOTE: effective from the next call to begin().
+	this->profiling = enable;
+}
+
+bool nv::renderer::is_profiling() const
+{
+	return this->profiling;
+}
+
+uint32_t nv::renderer::begin_zone(const char *name)
+{
+	// NOTE: zones are written where they are called, thus only measure draws
+	// recorded inline, i.e. neither in replay mode nor with many threads.
+
+	if ((this->profile == nullptr) || this->replay || (this->thread_count > 1))
+		return UINT32_MAX;
+
+	return this->profile->begin(this->buffer, this->slot, name);
+}
+
+void nv::renderer::end_zone(const uint32_t zone)
+{
+	if ((this->profile == nullptr) || (zone == UINT32_MAX)) return;
+
+	this->profile->end(this->buffer, this->slot, zone);
+}
+
+double nv::renderer::gpu_time(const char *name) const
+{
+	return this->timing.milliseconds(name);
+}
+
+const std::vector<nv::vulkan::profiler::timing> &nv::renderer::gpu_timings() const
+{
+	return this->timing.result;
+}
+
+void nv::renderer::use_frame_pacing(const double milliseconds)
+{
+	// NOTE: 0 disables the pacing, a target a bit under the refresh period
+	// (e.g. 1000.0/refresh_rate() - 0.5) suits FIFO presentation.
+
+	ASSERT(milliseconds >= 0.0)
+
+	this->pacing = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+	this->deadline = std::chrono::steady_clock::now();
+}
+
+double nv::renderer::frame_pacing() const
+{
+	return std::chrono::duration<double, std::milli>(this->pacing).count();
+}
+
+const nv::frame_stats &nv::renderer::statistics() const
+{
+	return this->stats;
+}
+
+bool nv::renderer::is_headless() const
+{
+	return this->headless;
+}
+
+void nv::renderer::resolution(uint32_t &width, uint32_t &height) const
+{
+	width = this->area.extent.width;
+	height = this->area.extent.height;
+}
+
+const void *nv::renderer::result(uint64_t &frame) const
+{
+	ASSERT(this->headless)
+
+	// NOTE: the most recent frame whose slot fence has signaled, if any, thus
+	// the GPU is never waited for.
+
+	uint32_t latest = UINT32_MAX;
+
+	for (uint32_t n = 0; n < this->slot_count; ++n)
+	{
+		if (this->target_frame[n] == UINT64_MAX) continue;
+
+		if ((latest != UINT32_MAX) && (this->target_frame[n] < this->target_frame[latest])) continue;
+
+		if (this->in_flight.is_signaled(*this->host, n)) latest = n;
+	}
+
+	if (latest == UINT32_MAX) return nullptr;
+
+	const nv::vulkan::allocation &a = this->target_memory[latest];
+
+	if (!this->memory->is_coherent(a))
+		this->memory->invalidate(*this->host, a, 0, a.size);
+
+	frame = this->target_frame[latest];
+	return a.mapped;
+}
+
+bool nv::renderer::upload(const nv::vulkan::buffer &b, const VkDeviceSize offset,
+                          const void *data, const VkDeviceSize size)
+{
+	// NOTE: copies are recorded at end(), before the commands of that frame.
+	return this->stage.upload(b, offset, data, size);
+}
+
+bool nv::renderer::upload(VkImage i, const VkExtent3D &extent,
+                          const void *data, const VkDeviceSize size)
+{
+	return this->stage.upload(i, extent, data, size);
+}
+
+bool nv::renderer::begin()
+{
+	ASSERT(this->host != nullptr)
+
+	auto start = std::chrono::steady_clock::now();
+
+	this->sample = {};
+
+	// NOTE: with pacing, a frame never starts before its deadline, thus the
+	// CPU does not run ahead of the display only to wait later on a queue of
+	// frames, each one holding older inputs.
+
+	if (this->pacing.count() > 0)
+	{
+		if (start < this->deadline)
+		{
+			std::this_thread::sleep_until(this->deadline);
+
+			const auto woken = std::chrono::steady_clock::now();
+			this->sample.time[NV_FRAME_PACING] = elapsed(start, woken);
+			start = woken;
+		}
+
+		// NOTE: a late frame moves the deadlines, rather than letting the next
+		// frames catch up in a burst.
+		this->deadline = std::max(this->deadline, start) + this->pacing;
+	}
+
+	if (this->frame_number > 0)
+		this->sample.time[NV_FRAME_INTERVAL] = elapsed(this->frame_start, start);
+
+	this->frame_start = start;
+
+	// Wait until the GPU is done with the last submission of this frame slot:
+
+	this->in_flight.wait(*this->host, this->slot);
+
+	auto now = std::chrono::steady_clock::now();
+	this->sample.time[NV_FRAME_FENCE] = elapsed(start, now);
+
+	this->stage.reclaim(this->slot);
+	this->timing.collect(*this->host, this->slot);
+	this->descriptors.reset(*this->host, this->slot);
+	this->uniforms.reset(this->slot);
+	this->batches.reset(this->slot);
+
+	this->bound.stream_count = 0;
+	this->bound.indices = VK_NULL_HANDLE;
+
+	if (this->retired.size() > 0) this->collect(false);
+
+	if (this->headless)
+	{
+		// NOTE: each frame slot owns an offscreen image of its own.
+		this->image_index = this->slot;
+	}
+	else
+	{
+		const auto acquire = std::chrono::steady_clock::now();
+		const VkResult result = this->chain.acquire(*this->host, this->available.handle[this->slot], this->image_index);
+
+		now = std::chrono::steady_clock::now();
+		this->sample.time[NV_FRAME_ACQUIRE] = elapsed(acquire, now);
+
+		// NOTE: the fence of this slot stays signaled, as nothing is submitted.
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			this->outdated = true;
+			return false;
+		}
+
+		if (result == VK_SUBOPTIMAL_KHR) this->outdated = true;
+
+		// NOTE: with more swapchain images than frame slots, an image can still
+		// be in use by a different slot than the current one.
+
+		const uint32_t owner = this->image_owner[this->image_index];
+
+		if ((owner < this->slot_count) && (owner != this->slot))
+		{
+			this->in_flight.wait(*this->host, owner);
+
+			const auto waited = std::chrono::steady_clock::now();
+			this->sample.time[NV_FRAME_FENCE] += elapsed(now, waited);
+		}
+
+		this->image_owner[this->image_index] = this->slot;
+	}
+
+	this->in_flight.reset(*this->host, this->slot);
+
+	// NOTE: the profiler choice holds for the whole frame.
+	this->profile = this->profiling? &this->timing : nullptr;
+
+	// NOTE: in replay mode the recording, if any, is deferred to end(), as is
+	// the recording of the secondary command buffers with many threads.
+
+	if (this->replay)
+		this->calls.clear();
+	else if (this->thread_count > 1)
+	{
+		this->calls.clear();
+		this->pass.begin(this->buffer, this->slot, this->frame, this->image_index,
+		                 VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, this->profile);
+	}
+	else
+		this->pass.begin(this->buffer, this->slot, this->frame, this->image_index,
+		                 VK_SUBPASS_CONTENTS_INLINE, this->profile);
+
+	this->record_start = std::chrono::steady_clock::now();
+	return true;
+}
+
+void nv::renderer::draw(const nv::pipeline &pl, const uint32_t vertex_count)
+{
+	this->draw(pl, vertex_count, nullptr, 0);
+}
+
+void nv::renderer::draw(const nv::pipeline &pl, const uint32_t vertex_count,
+                        const VkDescriptorSet *sets, const uint32_t set_count,
+                        const uint32_t *offsets, const uint32_t offset_count)
+{
+	this->queue_call(this->make_call(pl.interface, vertex_count, false, sets, set_count, offsets, offset_count));
+}
+
+void nv::renderer::draw_indexed(const nv::pipeline &pl, const uint32_t index_count,
+                                const VkDescriptorSet *sets, const uint32_t set_count,
+                                const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(this->bound.indices != VK_NULL_HANDLE)
+
+	this->queue_call(this->make_call(pl.interface, index_count, true, sets, set_count, offsets, offset_count));
+}
+
+bool nv::renderer::draw_batch(const nv::pipeline &pl, const VkDrawIndexedIndirectCommand *items, const uint32_t count,
+                              const VkDescriptorSet *sets, const uint32_t set_count,
+                              const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(this->bound.indices != VK_NULL_HANDLE)
+
+	if (count == 0) return true;
+
+	const VkDeviceSize size = count*sizeof(VkDrawIndexedIndirectCommand);
+	uint32_t position = 0;
+
+	void *target = this->batches.push(this->slot, size, position);
+
+	if (target == nullptr) return false;
+
+	std::memcpy(target, items, size);
+
+	draw_call call = this->make_call(pl.interface, count, true, sets, set_count, offsets, offset_count);
+
+	call.indirect = this->batches.ring.handle;
+	call.indirect_offset = position;
+
+	this->queue_call(call);
+	return true;
+}
+
+void nv::renderer::draw_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+                                 const VkDeviceSize offset, const uint32_t count,
+                                 const VkDescriptorSet *sets, const uint32_t set_count,
+                                 const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(commands.handle != nullptr)
+	ASSERT(this->bound.indices != VK_NULL_HANDLE)
+
+	draw_call call = this->make_call(pl.interface, count, true, sets, set_count, offsets, offset_count);
+
+	call.indirect = commands.handle;
+	call.indirect_offset = offset;
+
+	this->queue_call(call);
+}
+
+void nv::renderer::draw_indirect_count(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+                                       const VkDeviceSize offset,
+                                       const nv::vulkan::buffer &counter, const VkDeviceSize counter_offset,
+                                       const uint32_t max_count,
+                                       const VkDescriptorSet *sets, const uint32_t set_count,
+                                       const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(commands.handle != nullptr)
+	ASSERT(counter.handle != nullptr)
+	ASSERT(this->bound.indices != VK_NULL_HANDLE)
+	ASSERT(this->has_indirect_count())
+
+	draw_call call = this->make_call(pl.interface, max_count, true, sets, set_count, offsets, offset_count);
+
+	call.indirect = commands.handle;
+	call.indirect_offset = offset;
+	call.counter = counter.handle;
+	call.counter_offset = counter_offset;
+
+	this->queue_call(call);
+}
+
+bool nv::renderer::has_indirect_count() const
+{
+	return (this->host != nullptr) && (this->host->draw_indexed_indirect_count != nullptr);
+}
+
+bool nv::renderer::push_draw_data(const void *data, const VkDeviceSize size, uint32_t &offset)
+{
+	void *target = this->batches.push(this->slot, size, offset);
+
+	if (target == nullptr) return false;
+
+	std::memcpy(target, data, size);
+	return true;
+}
+
+nv::vulkan::descriptor_binding nv::renderer::draw_data_binding(const uint32_t binding, const VkDeviceSize range) const
+{
+	return this->batches.binding(binding, range, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+}
+
+void nv::renderer::bind_vertices(const VkBuffer *buffers, const VkDeviceSize *offsets, const uint32_t count)
+{
+	ASSERT(count <= NV_RENDERER_MAX_VERTEX_STREAMS)
 
-nv::renderer::renderer()
+	this->bound.stream_count = count;
+	std::copy(buffers, buffers + count, this->bound.vertices);
+	std::copy(offsets, offsets + count, this->bound.vertex_offsets);
+}
+
+void nv::renderer::bind_vertices(const nv::vulkan::buffer &b, const VkDeviceSize offset)
+{
+	this->bind_vertices(&b.handle, &offset, 1);
+}
+
+void nv::renderer::bind_indices(const nv::vulkan::buffer &b, const VkIndexType type, const VkDeviceSize offset)
+{
+	ASSERT(b.handle != nullptr)
+
+	this->bound.indices = b.handle;
+	this->bound.index_offset = offset;
+	this->bound.index_type = type;
+}
+
+nv::renderer::draw_call nv::renderer::make_call(const nv::vulkan::pipeline &pl, const uint32_t count, const bool indexed,
+                                                const VkDescriptorSet *sets, const uint32_t set_count,
+                                                const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(set_count <= NV_RENDERER_MAX_DESCRIPTOR_SETS)
+	ASSERT(offset_count <= NV_RENDERER_MAX_DYNAMIC_OFFSETS)
+
+	draw_call call;
+
+	call.handle = pl.handle;
+	call.pipeline = &pl;
+	call.state = pl.capture();
+	call.count = count;
+	call.indexed = indexed;
+	call.set_count = set_count;
+	call.offset_count = offset_count;
+	std::copy(sets, sets + set_count, call.sets);
+	std::copy(offsets, offsets + offset_count, call.offsets);
+
+	// NOTE: only the bytes in use are copied, the rest is never compared.
+
+	call.constants.size = this->pending.size;
+	call.constants.stages = this->pending.stages;
+	call.constants.offset = this->pending.offset;
+	std::memcpy(call.constants.data, this->pending.data, this->pending.size);
+
+	this->pending.size = 0;
+
+	// NOTE: the indices of a plain draw are left out, so as not to tell two
+	// identical draws apart in the history of replay mode.
+
+	call.input = this->bound;
+
+	if (!indexed)
+	{
+		call.input.indices = VK_NULL_HANDLE;
+		call.input.index_offset = 0;
+		call.input.index_type = VK_INDEX_TYPE_UINT16;
+	}
+
+	call.indirect = VK_NULL_HANDLE;
+	call.indirect_offset = 0;
+	call.counter = VK_NULL_HANDLE;
+	call.counter_offset = 0;
+
+	return call;
+}
+
+void nv::renderer::queue_call(const draw_call &call)
+{
+	if (this->replay || (this->thread_count > 1))
+	{
+		this->calls.push_back(call);
+		return;
+	}
+
+	this->record_call(this->buffer, this->slot, call);
+}
+
+void nv::renderer::dispatch(const nv::pipeline &pl, const uint32_t x, const uint32_t y, const uint32_t z,
+                            const VkDescriptorSet *sets, const uint32_t set_count,
+                            const uint32_t *offsets, const uint32_t offset_count)
+{
+	this->prepare_compute(pl.interface, sets, set_count, offsets, offset_count);
+	this->compute.dispatch(this->slot, x, y, z);
+}
+
+void nv::renderer::dispatch_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &b, const VkDeviceSize offset,
+                                     const VkDescriptorSet *sets, const uint32_t set_count,
+                                     const uint32_t *offsets, const uint32_t offset_count)
+{
+	this->prepare_compute(pl.interface, sets, set_count, offsets, offset_count);
+	this->compute.dispatch_indirect(this->slot, b.handle, offset);
+}
+
+void nv::renderer::compute_barrier(const nv::vulkan::buffer &b, const VkDeviceSize offset, const VkDeviceSize size)
+{
+	ASSERT(this->computing)
+
+	VkBufferMemoryBarrier barrier;
+
+	barrier.pNext = nullptr;
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = b.handle;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	this->compute.barrier(this->slot, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+	                      &barrier, 1, nullptr, 0);
+}
+
+void nv::renderer::compute_barrier(VkImage i, const VkImageLayout from, const VkImageLayout to,
+                                   const VkImageAspectFlags aspect)
+{
+	ASSERT(this->computing)
+
+	VkImageMemoryBarrier barrier;
+
+	barrier.pNext = nullptr;
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = from;
+	barrier.newLayout = to;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = i;
+	barrier.subresourceRange = {aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+	// NOTE: the draws may sample the image as well, once in its new layout.
+
+	this->compute.barrier(this->slot, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+	                    | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+	                      nullptr, 0, &barrier, 1);
+}
+
+void nv::renderer::prepare_compute(const nv::vulkan::pipeline &pl,
+                                   const VkDescriptorSet *sets, const uint32_t set_count,
+                                   const uint32_t *offsets, const uint32_t offset_count)
+{
+	ASSERT(pl.is_compute())
+
+	if (!this->computing)
+	{
+		this->compute.begin(this->slot);
+		this->computing = true;
+
+		// NOTE: the dispatches may rewrite what the draws (or dispatches) of
+		// the previous frames still read, e.g. indirect commands or vertices.
+
+		this->compute.barrier(this->slot, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+		                                | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		                                | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0);
+	}
+
+	pl.bind(this->compute, this->slot);
+	pl.bind(this->compute, this->slot, sets, set_count, offsets, offset_count);
+
+	if (this->pending.size > 0)
+		pl.push(this->compute, this->slot, this->pending.stages, this->pending.offset,
+		        this->pending.size, this->pending.data);
+
+	this->pending.size = 0;
+}
+
+void nv::renderer::push_constants(const VkShaderStageFlags stages, const void *data,
+                                  const uint32_t size, const uint32_t offset)
+{
+	ASSERT(size <= NV_RENDERER_PUSH_CONSTANT_SIZE)
+
+	this->pending.size = size;
+	this->pending.stages = stages;
+	this->pending.offset = offset;
+	std::memcpy(this->pending.data, data, size);
+}
+
+bool nv::renderer::push_uniform(const void *data, const VkDeviceSize size, uint32_t &offset)
+{
+	// NOTE: in replay mode, offsets differ from one frame slot to another,
+	// thus a recorded frame is only replayed by the slot that recorded it.
+
+	void *target = this->uniforms.push(this->slot, size, offset);
+
+	if (target == nullptr) return false;
+
+	std::memcpy(target, data, size);
+	return true;
+}
+
+nv::vulkan::descriptor_binding nv::renderer::uniform_binding(const uint32_t binding, const VkDeviceSize range) const
 {
+	return this->uniforms.binding(binding, range);
 }
 
-void nv::renderer::begin()
+VkDescriptorSet nv::renderer::allocate_set(const nv::pipeline &pl, const uint32_t set,
+                                           const std::vector<nv::vulkan::descriptor_binding> &binding)
 {
-	this->pass.begin(this->buffer, this->frame);
+	ASSERT(set < pl.layout.sets.size())
+
+	// NOTE: resetting the pools would invalidate the recorded command buffers,
+	// and a set allocated again with the same handle would not even tell the
+	// draw calls of a frame apart from the recorded ones.
+	ASSERT(!this->replay)
+
+	VkDescriptorSet s = this->descriptors.allocate(*this->host, this->slot, pl.layout.sets[set]);
+	this->descriptors.write(*this->host, s, binding);
+
+	return s;
 }
 
-void nv::renderer::draw()
+void nv::renderer::record_call(nv::vulkan::command_buffer &cb, const uint32_t n,
+                               const draw_call &call) const
 {
-	// FIXME: to finish implementing the begin() function of the render pass at
-	// vulkan.cpp before finishing draw().
+	// NOTE: the pipeline may have been specialized again since the call was
+	// queued, thus the variant of the call is bound rather than the current.
+
+	call.pipeline->bind(cb, n, call.handle);
+	call.pipeline->bind(cb, n, call.sets, call.set_count, call.offsets, call.offset_count);
+
+	if (call.constants.size > 0)
+		call.pipeline->push(cb, n, call.constants.stages, call.constants.offset,
+		                    call.constants.size, call.constants.data);
+	call.pipeline->apply(*this->host, cb, n, this->view, this->area, call.state);
+	cb.bind_vertices(n, call.input.vertices, call.input.vertex_offsets, call.input.stream_count);
+
+	if (!call.indexed)
+	{
+		cb.draw(n, call.count);
+		return;
+	}
+
+	cb.bind_indices(n, call.input.indices, call.input.index_offset, call.input.index_type);
+
+	if (call.counter != VK_NULL_HANDLE)
+		cb.draw_indexed_indirect_count(*this->host, n, call.indirect, call.indirect_offset,
+		                               call.counter, call.counter_offset, call.count);
+	else if (call.indirect != VK_NULL_HANDLE)
+		cb.draw_indexed_indirect(*this->host, n, call.indirect, call.indirect_offset, call.count);
+	else
+		cb.draw_indexed(n, call.count);
 }
 
 void nv::renderer::end()
 {
-	this->pass.end(this->buffer);
+	const VkCommandBuffer copies = this->stage.is_pending()? this->stage.buffer.handle[this->slot] : VK_NULL_HANDLE;
+	const VkCommandBuffer dispatches = this->computing? this->compute.handle[this->slot] : VK_NULL_HANDLE;
+
+	// NOTE: uploads come first, thus are visible to the dispatches (see the
+	// barrier of nv::vulkan::staging::record()), then the dispatches, whose
+	// writes are made visible to the draws below.
+
+	const VkCommandBuffer first[2] = {copies, dispatches};
+
+	this->stage.record(*this->host, *this->memory, this->slot);
+
+	if (this->computing)
+	{
+		this->compute.barrier(this->slot, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+		                    | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		                      VK_ACCESS_SHADER_WRITE_BIT,
+		                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+		                    | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+		                    | VK_ACCESS_SHADER_READ_BIT);
+
+		this->compute.end(this->slot);
+		this->computing = false;
+	}
+	this->uniforms.flush(*this->host, *this->memory, this->slot);
+	this->batches.flush(*this->host, *this->memory, this->slot);
+
+	// NOTE: offscreen frames neither wait for an image nor are presented, but
+	// are followed by the copy of the image into the readback buffer instead.
+
+	const VkSemaphore wait = this->headless? VK_NULL_HANDLE : this->available.handle[this->slot];
+	const VkSemaphore signal = this->headless? VK_NULL_HANDLE : this->finished.handle[this->slot];
+	const VkCommandBuffer copy_back = this->headless? this->readback.handle[this->slot] : VK_NULL_HANDLE;
+
+	if (this->replay)
+	{
+		const uint32_t n = this->image_index;
+
+		if (this->dirty[n] || (this->calls != this->history[n]))
+			this->record(n);
+	}
+	else
+	{
+		if (this->thread_count > 1) this->record_parallel();
+
+		this->pass.end(this->buffer, this->slot, this->profile);
+	}
+
+	// NOTE: record covers everything from the end of begin() until now, the
+	// draw calls of the application included.
+
+	const auto submit = std::chrono::steady_clock::now();
+	this->sample.time[NV_FRAME_RECORD] = elapsed(this->record_start, submit);
+
+	if (this->replay)
+		this->recorded.submit(this->image_index, this->queue, wait, signal,
+		                      this->in_flight.handle[this->slot], first, 2, copy_back);
+	else
+		this->buffer.submit(this->slot, this->queue, wait, signal,
+		                    this->in_flight.handle[this->slot], first, 2, copy_back);
+
+	const auto present = std::chrono::steady_clock::now();
+	this->sample.time[NV_FRAME_SUBMIT] = elapsed(submit, present);
+
+	if (this->headless)
+		this->target_frame[this->slot] = this->frame_number;
+	else
+	{
+		const VkResult result = this->chain.present(this->queue, signal, this->image_index);
+
+		if (result != VK_SUCCESS) this->outdated = true;
+
+		this->sample.time[NV_FRAME_PRESENT] = elapsed(present, std::chrono::steady_clock::now());
+	}
+
+	this->stats.push(this->sample);
+
+	this->slot = (this->slot + 1) % this->slot_count;
+	++this->frame_number;
+}
+
+void nv::renderer::record(const uint32_t n)
+{
+	// NOTE: the last submission of recorded.handle[n] has retired by now, since
+	// begin() waited for the frame slot that owned the n-th image before.
+
+	this->pass.begin(this->recorded, n, this->frame, n);
+
+	for (const auto &call : this->calls)
+	{
+		this->record_call(this->recorded, n, call);
+	}
+
+	this->pass.end(this->recorded, n);
+
+	this->history[n] = this->calls;
+	this->dirty[n] = false;
+}
+
+void nv::renderer::record_parallel()
+{
+	const uint32_t count = std::min<uint32_t>(this->thread_count, this->calls.size());
+
+	if (count == 0) return;
+
+	// NOTE: contiguous slices keep the submission order of the draw calls, as
+	// the secondary command buffers are executed in the order of the slices.
+
+	const uint32_t length = (this->calls.size() + count - 1)/count;
+	const VkFramebuffer target = this->frame.handle[this->image_index];
+
+	this->crew->run(count, [this, length, target](const uint32_t t)
+	{
+		const uint32_t k = this->slot*this->thread_count + t;
+		const size_t first = t*length;
+		const size_t last = std::min<size_t>(first + length, this->calls.size());
+
+		nv::vulkan::command_buffer &cb = this->secondary[k];
+
+		this->thread_pool[k].reset(*this->host);
+
+		cb.begin(0, this->pass.handle, target);
+
+		for (size_t n = first; n < last; ++n)
+		{
+			this->record_call(cb, 0, this->calls[n]);
+		}
+
+		cb.end(0);
+	});
+
+	this->executed.clear();
+
+	for (uint32_t t = 0; t < count; ++t)
+		this->executed.push_back(this->secondary[this->slot*this->thread_count + t].handle[0]);
+
+	this->buffer.execute(this->slot, this->executed);
+}
+
+void nv::renderer::create_slots(const nv::vulkan::device &d,
+                                const nv::vulkan::physical_device &pd, const uint32_t index,
+                                nv::vulkan::allocator &a,
+                                const nv::vulkan::command_pool &p)
+{
+	// Frame slots, each one with its own semaphore pair, fence and command buffer:
+
+	for (uint32_t n = 0; n < this->slot_count; ++n)
+	{
+		this->available.create(d);
+		this->finished.create(d);
+		this->in_flight.create(d);
+	}
+
+	this->buffer.allocate(d, p, this->slot_count);
+	this->compute.allocate(d, p, this->slot_count);
+
+	// NOTE: no swapchain image belongs to a frame slot until its first acquire.
+	this->image_owner.assign(this->image.size(), UINT32_MAX);
+
+	// Command buffers of the replay mode, one per swapchain image:
+
+	this->recorded.allocate(d, p, this->image.size());
+	this->dirty.assign(this->image.size(), true);
+	this->history.assign(this->image.size(), {});
+
+	this->stage.create(d, a, p, this->slot_count);
+	this->timing.create(d, pd, index, this->slot_count);
+	this->descriptors.create(d, this->slot_count);
+	this->uniforms.create(d, a, pd, index, this->slot_count);
+	this->batches.create(d, a, pd, index, this->slot_count, NV_RENDERER_BATCH_SIZE,
+	                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	// One command pool per recording thread and frame slot, each one with a
+	// single secondary command buffer:
+
+	if (this->thread_count > 1)
+	{
+		const uint32_t count = this->thread_count*this->slot_count;
+
+		this->thread_pool.resize(count);
+		this->secondary.resize(count);
+
+		for (uint32_t k = 0; k < count; ++k)
+		{
+			this->thread_pool[k].setup.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			this->thread_pool[k].create(d);
+
+			this->secondary[k].setup.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			this->secondary[k].startup.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			this->secondary[k].allocate(d, this->thread_pool[k], 1);
+		}
+	}
+
+	this->area.offset = {0, 0};
+	this->area.extent = this->image.resolution;
+	this->view = {0.0f, 0.0f, static_cast<float>(this->area.extent.width), static_cast<float>(this->area.extent.height), 0.0f, 1.0f};
+
+	this->slot = 0;
+	this->outdated = false;
+	this->frame_number = 0;
+	this->commands = &p;
+	this->memory = &a;
+	this->host = &d;
+	this->queue = p.queue;
+}
+
+void nv::renderer::destroy_slots(const nv::vulkan::device &d,
+                                 nv::vulkan::allocator &a,
+                                 const nv::vulkan::command_pool &p)
+{
+	this->available.destroy(d);
+	this->finished.destroy(d);
+	this->in_flight.destroy(d);
+
+	this->collect(true);
+
+	this->stage.destroy(d, a, p);
+	this->timing.destroy(d);
+	this->descriptors.destroy(d);
+	this->uniforms.destroy(d, a);
+	this->batches.destroy(d, a);
+	this->buffer.free(d, p);
+	this->compute.free(d, p);
+	this->recorded.free(d, p);
+
+	for (uint32_t k = 0; k < this->thread_pool.size(); ++k)
+	{
+		this->secondary[k].free(d, this->thread_pool[k]);
+		this->thread_pool[k].destroy(d);
+	}
+
+	// Offscreen readback, if any:
+
+	this->readback.free(d, p);
+
+	for (uint32_t n = 0; n < this->target.size(); ++n)
+	{
+		this->target[n].destroy(d);
+		a.release(d, this->target_memory[n]);
+	}
+
+	this->target.clear();
+	this->target_memory.clear();
+	this->target_frame.clear();
+
+	this->secondary.clear();
+	this->thread_pool.clear();
+	this->image_owner.clear();
+	this->history.clear();
+	this->dirty.clear();
+	this->host = nullptr;
+	this->memory = nullptr;
+	this->commands = nullptr;
+	this->queue = nullptr;
+}
+
+void nv::renderer::collect(const bool all)
+{
+	// NOTE: begin() waited for frame (frame_number - slot_count), and a fence
+	// covers every earlier submission to the same queue, thus all frames up to
+	// that one are complete. One more frame is kept as a margin for the
+	// presentation, which no fence covers.
+
+	while ((this->retired.size() > 0)
+	    && (all || (this->retired.front().frame + this->slot_count <= this->frame_number)))
+	{
+		this->retired.front().chain.destroy(*this->host);
+		this->retired.front().depth.destroy(*this->host, *this->memory);
+		this->retired.front().recorded.free(*this->host, *this->commands);
+
+		for (const auto p : this->retired.front().pipelines)
+			vkDestroyPipeline(this->host->handle, p, nullptr);
+
+		this->retired.pop_front();
+	}
 }
 
 nv::renderer::~renderer()
@@ -1,37 +1,436 @@
 #if !defined(NV_RENDERER_HEADER)
 	#define NV_RENDERER_HEADER
+	#include <deque>
+	#include <cstring>
+	#include <algorithm>
+	#include <chrono>
+	#include <memory>
 	#include <vector>
 
 	#include "vulkan.hpp"
 	#include "device.hpp"
+	#include "staging.hpp"
+	#include "profiler.hpp"
+	#include "stats.hpp"
+	#include "descriptor.hpp"
+	#include "uniform.hpp"
+	#include "workers.hpp"
+
+	#if !defined(NV_RENDERER_FRAMES_IN_FLIGHT)
+		#define NV_RENDERER_FRAMES_IN_FLIGHT 2
+	#endif
+
+	#define NV_RENDERER_MAX_FRAMES_IN_FLIGHT 3
+
+	#define NV_RENDERER_MAX_DESCRIPTOR_SETS 4
+	#define NV_RENDERER_MAX_DYNAMIC_OFFSETS 4
+	#define NV_RENDERER_MAX_VERTEX_STREAMS 4
+
+	// NOTE: the least maxPushConstantsSize that every device supports.
+	#define NV_RENDERER_PUSH_CONSTANT_SIZE 128
+
+	// NOTE: the size of the region of every frame slot in the ring of batched
+	// draw commands and per-draw data, e.g. 50k draws with a matrix each.
+
+	#if !defined(NV_RENDERER_BATCH_SIZE)
+		#define NV_RENDERER_BATCH_SIZE (8*1024*1024)
+	#endif
+
+	#if !defined(NV_RENDERER_RECORDING_THREADS)
+		#define NV_RENDERER_RECORDING_THREADS 1
+	#endif
+
+	// NOTE: whether the depth attachment of the render pass has a stencil
+	// aspect as well.
+
+	#if !defined(NV_RENDERER_STENCIL)
+		#define NV_RENDERER_STENCIL false
+	#endif
 
 	namespace nv
 	{
 		class window;
+		class pipeline;
+		class reloader;
 
 		class renderer
 		{
 			public:
-			renderer();
+			explicit renderer(const uint32_t frames = NV_RENDERER_FRAMES_IN_FLIGHT,
+			                  const uint32_t threads = NV_RENDERER_RECORDING_THREADS);
+
+			uint32_t frames_in_flight() const;
+
+			uint32_t recording_threads() const;
+
+			uint32_t current_frame() const;
+
+			bool is_headless() const;
+
+			void resolution(uint32_t &width, uint32_t &height) const;
+
+			// NOTE: the pixels of the most recent offscreen frame that is complete
+			// (tightly packed, in the format of the renderer) and its frame
+			// number, or nullptr if none. To be copied out before the next call
+			// to end().
+			const void *result(uint64_t &frame) const;
+
+			void use_replay(const bool enable);
+
+			bool is_replaying() const;
+
+			void invalidate();
+
+			bool is_outdated() const;
+
+			// NOTE: GPU timings of the render pass (as "render_pass") and of the
+			// zones in between, resolved frames_in_flight() frames late. The replay
+			// mode is not profiled, as its commands are recorded once.
+			void use_profiling(const bool enable);
+
+			bool is_profiling() const;
+
+			uint32_t begin_zone(const char *name);
+
+			void end_zone(const uint32_t zone);
+
+			double gpu_time(const char *name) const;
+
+			const std::vector<nv::vulkan::profiler::timing> &gpu_timings() const;
+
+			// NOTE: CPU timings of every frame, to be read from any thread.
+			const nv::frame_stats &statistics() const;
+
+			// NOTE: the target time in milliseconds between the starts of two
+			// frames, begin() sleeping as needed.
+			void use_frame_pacing(const double milliseconds);
+
+			double frame_pacing() const;
+
+			bool upload(const nv::vulkan::buffer &b, const VkDeviceSize offset,
+			            const void *data, const VkDeviceSize size);
+
+			bool upload(VkImage i, const VkExtent3D &extent,
+			            const void *data, const VkDeviceSize size);
+
+			// NOTE: false means the swapchain is out of date and nothing is drawn
+			// in this frame (draw() and end() must be skipped), see is_outdated().
+			bool begin();
+
+			void draw(const nv::pipeline &pl, const uint32_t vertex_count = 3);
+
+			void draw(const nv::pipeline &pl, const uint32_t vertex_count,
+			          const VkDescriptorSet *sets, const uint32_t set_count,
+			          const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			// NOTE: indexed draws read the indices and vertices bound last, whereas
+			// plain draws read the vertices only. Both bindings hold until changed
+			// or until the next frame.
+			void draw_indexed(const nv::pipeline &pl, const uint32_t index_count,
+			                  const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			                  const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			// NOTE: a batch of indexed draws sharing a pipeline, its sets and the
+			// bound buffers, written to the batch ring of the frame and issued by a
+			// single vkCmdDrawIndexedIndirect (one per draw without multiDrawIndirect).
+			// Shaders find the data of every draw, given by push_draw_data(), with
+			// gl_DrawID or with gl_InstanceIndex through its firstInstance. False if
+			// the region of the frame is full.
+			bool draw_batch(const nv::pipeline &pl, const VkDrawIndexedIndirectCommand *items, const uint32_t count,
+			                const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			                const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			// NOTE: indexed draws whose commands (and count) are written by the GPU,
+			// e.g. by a culling pass, which must be done with them by then. The draw
+			// count read from counter requires has_indirect_count().
+			void draw_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+			                   const VkDeviceSize offset, const uint32_t count,
+			                   const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			                   const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			void draw_indirect_count(const nv::pipeline &pl, const nv::vulkan::buffer &commands,
+			                         const VkDeviceSize offset,
+			                         const nv::vulkan::buffer &counter, const VkDeviceSize counter_offset,
+			                         const uint32_t max_count,
+			                         const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			                         const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			bool has_indirect_count() const;
 
-			void begin();
+			// NOTE: per-draw data of the current frame (e.g. an array of matrices
+			// indexed by draw), read through draw_data_binding() with offset as its
+			// dynamic offset. False if the region of the frame is full.
+			bool push_draw_data(const void *data, const VkDeviceSize size, uint32_t &offset);
 
-			void draw();
+			nv::vulkan::descriptor_binding draw_data_binding(const uint32_t binding, const VkDeviceSize range) const;
+
+			// NOTE: the n-th buffer goes to the n-th binding of the vertex layout,
+			// i.e. a single one for an interleaved layout, one per stream otherwise.
+			void bind_vertices(const VkBuffer *buffers, const VkDeviceSize *offsets, const uint32_t count);
+
+			void bind_vertices(const nv::vulkan::buffer &b, const VkDeviceSize offset = 0);
+
+			void bind_indices(const nv::vulkan::buffer &b, const VkIndexType type = VK_INDEX_TYPE_UINT16,
+			                  const VkDeviceSize offset = 0);
+
+			// NOTE: compute work of the current frame, recorded in a command buffer
+			// of its own that runs before the draws of the frame, within the same
+			// submission. Whatever the dispatches write is visible to every draw
+			// (as indirect commands, vertices, indices or shader reads). It runs
+			// on the graphics queue, thus never overlaps the draws.
+			void dispatch(const nv::pipeline &pl, const uint32_t x, const uint32_t y = 1, const uint32_t z = 1,
+			              const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			              const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			void dispatch_indirect(const nv::pipeline &pl, const nv::vulkan::buffer &b, const VkDeviceSize offset = 0,
+			                       const VkDescriptorSet *sets = nullptr, const uint32_t set_count = 0,
+			                       const uint32_t *offsets = nullptr, const uint32_t offset_count = 0);
+
+			// NOTE: between two dispatches, when the latter reads (or writes) what
+			// the former wrote. An image may change layout meanwhile, e.g. from
+			// VK_IMAGE_LAYOUT_GENERAL to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			// once written, for the draws to sample it.
+			void compute_barrier(const nv::vulkan::buffer &b, const VkDeviceSize offset = 0,
+			                     const VkDeviceSize size = VK_WHOLE_SIZE);
+
+			void compute_barrier(VkImage i, const VkImageLayout from, const VkImageLayout to,
+			                     const VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+			// NOTE: push constants for the next draw only.
+			void push_constants(const VkShaderStageFlags stages, const void *data,
+			                    const uint32_t size, const uint32_t offset = 0);
+
+			// NOTE: uniforms of the current frame, written to the uniform ring and
+			// read by the next draws through uniform_binding() with offset as their
+			// dynamic offset. False if the region of the frame is full.
+			bool push_uniform(const void *data, const VkDeviceSize size, uint32_t &offset);
+
+			template <typename T>
+			bool push_uniform(const T &value, uint32_t &offset)
+			{
+				return this->push_uniform(&value, sizeof(T), offset);
+			}
+
+			nv::vulkan::descriptor_binding uniform_binding(const uint32_t binding, const VkDeviceSize range) const;
+
+			// NOTE: a descriptor set for the current frame only, allocated from the
+			// pools of its frame slot, which are reset once the slot comes back.
+			// Not in replay mode, whose recorded frames outlive such sets: use
+			// nv::device::descriptor_set() instead.
+			VkDescriptorSet allocate_set(const nv::pipeline &pl, const uint32_t set,
+			                             const std::vector<nv::vulkan::descriptor_binding> &binding);
 
 			void end();
 
+			friend void nv::device::create_pipeline(nv::pipeline &pl, const nv::renderer &r) const;
+			friend void nv::device::create_pipelines(const std::vector<nv::pipeline*> &list, const nv::renderer &r) const;
 			friend void nv::device::renderer_startup(nv::renderer &r, const nv::window &w) const;
+			friend void nv::device::renderer_startup(nv::renderer &r, const uint32_t width, const uint32_t height,
+			                                         const VkFormat format) const;
 			friend void nv::device::renderer_shutdown(nv::renderer &r) const;
+			friend bool nv::device::renderer_resize(nv::renderer &r, nv::window &w) const;
+			friend class nv::reloader;
 
 			~renderer();
 
 			private:
+			struct push_block
+			{
+				VkShaderStageFlags stages;
+				uint32_t offset;
+				uint32_t size;
+				uint8_t data[NV_RENDERER_PUSH_CONSTANT_SIZE];
+
+				bool operator ==(const push_block &other) const
+				{
+					return (this->size == other.size) && (this->stages == other.stages) && (this->offset == other.offset)
+					    && (std::memcmp(this->data, other.data, this->size) == 0);
+				}
+			};
+
+			struct geometry
+			{
+				uint32_t stream_count;
+				VkBuffer vertices[NV_RENDERER_MAX_VERTEX_STREAMS];
+				VkDeviceSize vertex_offsets[NV_RENDERER_MAX_VERTEX_STREAMS];
+				VkBuffer indices;
+				VkDeviceSize index_offset;
+				VkIndexType index_type;
+
+				bool operator ==(const geometry &other) const
+				{
+					return (this->stream_count == other.stream_count)
+					    && std::equal(this->vertices, this->vertices + this->stream_count, other.vertices)
+					    && std::equal(this->vertex_offsets, this->vertex_offsets + this->stream_count, other.vertex_offsets)
+					    && (this->indices == other.indices) && (this->index_offset == other.index_offset)
+					    && (this->index_type == other.index_type);
+				}
+			};
+
+			struct draw_call
+			{
+				VkPipeline handle;
+				const nv::vulkan::pipeline *pipeline;
+				uint32_t count;
+				bool indexed;
+				uint32_t set_count;
+				uint32_t offset_count;
+				VkDescriptorSet sets[NV_RENDERER_MAX_DESCRIPTOR_SETS];
+				uint32_t offsets[NV_RENDERER_MAX_DYNAMIC_OFFSETS];
+				push_block constants;
+				geometry input;
+				VkBuffer indirect;
+				VkDeviceSize indirect_offset;
+				VkBuffer counter;
+				VkDeviceSize counter_offset;
+				nv::vulkan::draw_state state;
+
+				bool operator ==(const draw_call &other) const
+				{
+					return (this->handle == other.handle) && (this->count == other.count)
+					    && (this->indexed == other.indexed)
+					    && (this->set_count == other.set_count) && (this->offset_count == other.offset_count)
+					    && std::equal(this->sets, this->sets + this->set_count, other.sets)
+					    && std::equal(this->offsets, this->offsets + this->offset_count, other.offsets)
+					    && (this->constants == other.constants) && (this->input == other.input)
+					    && (this->indirect == other.indirect) && (this->indirect_offset == other.indirect_offset)
+					    && (this->counter == other.counter) && (this->counter_offset == other.counter_offset)
+					    && (this->state == other.state);
+				}
+			};
+
+			struct retirement
+			{
+				uint64_t frame;
+				nv::vulkan::retired_swapchain chain;
+				nv::vulkan::image depth;
+				nv::vulkan::command_buffer recorded;
+				std::vector<VkPipeline> pipelines;
+			};
+
+			void create_slots(const nv::vulkan::device &d,
+			                  const nv::vulkan::physical_device &pd, const uint32_t index,
+			                  nv::vulkan::allocator &a,
+			                  const nv::vulkan::command_pool &p);
+
+			void destroy_slots(const nv::vulkan::device &d,
+			                   nv::vulkan::allocator &a,
+			                   const nv::vulkan::command_pool &p);
+
+			draw_call make_call(const nv::vulkan::pipeline &pl, const uint32_t count, const bool indexed,
+			                    const VkDescriptorSet *sets, const uint32_t set_count,
+			                    const uint32_t *offsets, const uint32_t offset_count);
+
+			void queue_call(const draw_call &call);
+
+			void record_call(nv::vulkan::command_buffer &cb, const uint32_t n,
+			                 const draw_call &call) const;
+
+			void prepare_compute(const nv::vulkan::pipeline &pl,
+			                     const VkDescriptorSet *sets, const uint32_t set_count,
+			                     const uint32_t *offsets, const uint32_t offset_count);
+
+			void record(const uint32_t n);
+
+			void collect(const bool all);
+
+			void record_parallel();
+
+			// NOTE: a frame slot owns the n-th entry of every per-frame list below,
+			// i.e. available, finished, in_flight and buffer. The CPU records slot
+			// (n + 1) % slot_count while the GPU still executes slot n.
+			uint32_t slot;
+			uint32_t slot_count;
+			uint32_t image_index;
+			VkQueue queue;
+			const nv::vulkan::device *host;
+			nv::vulkan::allocator *memory;
+			const nv::vulkan::command_pool *commands;
 			nv::vulkan::image image;
+			nv::vulkan::image depth;
 			nv::vulkan::swapchain chain;
 			nv::vulkan::render_pass pass;
 			nv::vulkan::framebuffer frame;
-			nv::vulkan::semaphore signal;
+			VkViewport view;
+			VkRect2D area;
+			nv::vulkan::semaphore available;
+			nv::vulkan::semaphore finished;
+			nv::vulkan::fence in_flight;
 			nv::vulkan::command_buffer buffer;
+			nv::vulkan::staging stage;
+			std::vector<uint32_t> image_owner;
+
+			// NOTE: a resize replaces the swapchain, its images and framebuffers,
+			// (and the replay buffers that refer to them), and a nv::reloader the
+			// pipelines it rebuilds, while older frames may still be in flight.
+			// These go to the retired queue, tagged with the number of frames
+			// submitted until then, and are destroyed once all such frames are
+			// known to be complete.
+			bool outdated;
+			uint64_t frame_number;
+			std::deque<retirement> retired;
+
+			// NOTE: in replay mode every swapchain image has its own command buffer
+			// (the n-th entry of recorded), which is recorded once and resubmitted
+			// until either invalidate() is called or the draw calls of a frame
+			// differ from the ones recorded for that image (history).
+			bool replay;
+			nv::vulkan::command_buffer recorded;
+			std::vector<bool> dirty;
+			std::vector<draw_call> calls;
+			std::vector<std::vector<draw_call>> history;
+
+			// NOTE: descriptor sets of the frame slot n come from the n-th pools of
+			// descriptors, reset by begin() after the slot fence.
+			nv::vulkan::descriptor_allocator descriptors;
+			nv::vulkan::uniform_ring uniforms;
+			nv::vulkan::uniform_ring batches;
+
+			// NOTE: push constants given since the last draw, if any (size > 0).
+			push_block pending;
+
+			// NOTE: the compute command buffer of slot n is only begun by the first
+			// dispatch of a frame (computing), frames without any skip it.
+			bool computing;
+			nv::vulkan::command_buffer compute;
+
+			// NOTE: the vertex and index buffers of the next draws, none (null
+			// indices, no stream) at the start of every frame.
+			geometry bound;
+
+			// NOTE: profile is the profiler of the frame being recorded, if any.
+			bool profiling;
+			nv::vulkan::profiler timing;
+			nv::vulkan::profiler *profile;
+
+			// NOTE: sample gathers the timings of the frame being recorded, pushed
+			// to stats at end(). Frames that begin() gives up on are not pushed.
+			nv::frame_stats stats;
+			nv::frame_stats::sample sample;
+			std::chrono::steady_clock::time_point frame_start;
+			std::chrono::steady_clock::time_point record_start;
+			std::chrono::steady_clock::duration pacing;
+			std::chrono::steady_clock::time_point deadline;
+
+			// NOTE: with more than one recording thread, the draw calls of a frame
+			// are split in slices recorded by secondary command buffers. The thread
+			// t owns the entry (slot*thread_count + t) of both thread_pool and
+			// secondary, thus threads never share a pool and a pool is only reset
+			// once its frame slot has retired.
+			uint32_t thread_count;
+			std::unique_ptr<nv::workers> crew;
+			std::vector<nv::vulkan::command_pool> thread_pool;
+			std::vector<nv::vulkan::command_buffer> secondary;
+			std::vector<VkCommandBuffer> executed;
+
+			// NOTE: in headless mode, image holds one offscreen image per frame
+			// slot, copied by the n-th readback command buffer into the n-th
+			// host-visible target buffer after every frame of slot n.
+			bool headless;
+			nv::vulkan::command_buffer readback;
+			std::vector<nv::vulkan::buffer> target;
+			std::vector<nv::vulkan::allocation> target_memory;
+			std::vector<uint64_t> target_frame;
 		};
 	}
 #endif
@@ -23,6 +23,16 @@
 
 			void for_compute_stage(const uint32_t n);
 
+			// NOTE: the specialization constants of the n-th shader, from a struct T
+			// whose members C... are given by NV_SPECIALIZATION_CONSTANT(), to be
+			// set before nv::pipeline::use(). See nv::pipeline::specialize() for
+			// pipelines with many variants.
+			template <typename T, typename... C>
+			void specialize(const uint32_t n, const T &values)
+			{
+				this->list.at(n).constants.template set<T, C...>(values);
+			}
+
 			~shader();
 
 			friend void nv::pipeline::use(const nv::shader &s, const uint32_t index);
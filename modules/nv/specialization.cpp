@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "debug.hpp"
+#include "specialization.hpp"
+
+nv::vulkan::specialization::specialization()
+{
+	this->setup.dataSize = 0;
+	this->setup.pData = nullptr;
+	this->setup.mapEntryCount = 0;
+	this->setup.pMapEntries = nullptr;
+}
+
+void nv::vulkan::specialization::set(const VkSpecializationMapEntry *entries, const uint32_t count,
+                                     const void *values, const size_t size)
+{
+	ASSERT((count == 0) || ((entries != nullptr) && (values != nullptr)))
+
+	// NOTE: the constants are packed one after the other, thus the padding of
+	// the struct they come from never tells two specializations apart.
+
+	const uint8_t *source = static_cast<const uint8_t*>(values);
+
+	this->entry.assign(entries, entries + count);
+	this->data.clear();
+
+	for (auto &e : this->entry)
+	{
+		ASSERT(e.offset + e.size <= size)
+
+		const uint32_t offset = this->data.size();
+
+		this->data.insert(this->data.end(), source + e.offset, source + e.offset + e.size);
+		e.offset = offset;
+	}
+}
+
+bool nv::vulkan::specialization::is_empty() const
+{
+	return this->entry.size() == 0;
+}
+
+bool nv::vulkan::specialization::find(const uint32_t id, uint32_t &value) const
+{
+	for (const auto &e : this->entry)
+	{
+		if ((e.constantID != id) || (e.size != sizeof(value))) continue;
+
+		std::memcpy(&value, this->data.data() + e.offset, sizeof(value));
+		return true;
+	}
+
+	return false;
+}
+
+const VkSpecializationInfo *nv::vulkan::specialization::info()
+{
+	if (this->is_empty()) return nullptr;
+
+	this->setup.dataSize = this->data.size();
+	this->setup.pData = this->data.data();
+	this->setup.mapEntryCount = this->entry.size();
+	this->setup.pMapEntries = this->entry.data();
+
+	return &this->setup;
+}
+
+uint64_t nv::vulkan::specialization::hash() const
+{
+	// NOTE: FNV-1a over the ids and the packed values.
+
+	uint64_t h = 0xCBF29CE484222325ull;
+
+	for (const auto &e : this->entry)
+	{
+		for (uint32_t n = 0; n < 4; ++n)
+		{
+			h ^= (e.constantID >> (8*n)) & 0xFF;
+			h *= 0x100000001B3ull;
+		}
+	}
+
+	for (const uint8_t b : this->data)
+	{
+		h ^= b;
+		h *= 0x100000001B3ull;
+	}
+
+	return h;
+}
+
+bool nv::vulkan::specialization::operator ==(const specialization &other) const
+{
+	if ((this->entry.size() != other.entry.size()) || (this->data != other.data)) return false;
+
+	for (size_t n = 0; n < this->entry.size(); ++n)
+	{
+		if ((this->entry[n].constantID != other.entry[n].constantID)
+		 || (this->entry[n].size != other.entry[n].size)) return false;
+	}
+
+	return true;
+}
+
+nv::vulkan::specialization::~specialization()
+{
+}
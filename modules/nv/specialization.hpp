@@ -0,0 +1,81 @@
+#if !defined(NV_SPECIALIZATION_HEADER)
+	#define NV_SPECIALIZATION_HEADER
+	#include <vulkan/vulkan.h>
+	#include <cstddef>
+	#include <cstdint>
+	#include <type_traits>
+	#include <vector>
+
+	// NOTE: a member of a struct of specialization constants, given to the
+	// constant of the same id in the shader, e.g.
+	//
+	//   struct blur { uint32_t taps; VkBool32 gamma; float sigma; };
+	//
+	//   layout(constant_id = 0) const uint taps = 9;
+	//   layout(constant_id = 1) const bool gamma = false;
+	//   layout(constant_id = 2) const float sigma = 2.0;
+	//
+	//   s.specialize<blur, NV_SPECIALIZATION_CONSTANT(0, blur, taps),
+	//                      NV_SPECIALIZATION_CONSTANT(1, blur, gamma),
+	//                      NV_SPECIALIZATION_CONSTANT(2, blur, sigma)>(n, {5, VK_TRUE, 1.5f});
+
+	#define NV_SPECIALIZATION_CONSTANT(id, type, member) \
+		nv::vulkan::specialization_constant<id, offsetof(type, member), sizeof(type::member)>
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			template <uint32_t Id, size_t Offset, size_t Size>
+			struct specialization_constant
+			{
+				// NOTE: booleans are 32-bit (VkBool32) in SPIR-V, not bool.
+				static_assert((Size == 4) || (Size == 8), "a specialization constant that is neither a 32-bit nor a 64-bit scalar");
+
+				static constexpr uint32_t id = Id;
+				static constexpr uint32_t offset = Offset;
+				static constexpr size_t size = Size;
+			};
+
+			// NOTE: the values of the specialization constants of a shader stage,
+			// copied from a struct, with map entries that point into that copy.
+			// info() fixes the pointers of setup, which copies do not update.
+
+			struct specialization
+			{
+				specialization();
+
+				void set(const VkSpecializationMapEntry *entries, const uint32_t count,
+				         const void *values, const size_t size);
+
+				template <typename T, typename... C>
+				void set(const T &values)
+				{
+					static_assert(std::is_trivially_copyable<T>::value, "specialization constants of a struct that is not trivially copyable");
+					static_assert(sizeof...(C) > 0, "a specialization without constants");
+
+					const VkSpecializationMapEntry entries[] = {{C::id, C::offset, C::size}...};
+
+					this->set(entries, sizeof...(C), &values, sizeof(T));
+				}
+
+				bool is_empty() const;
+
+				// NOTE: the value of a 32-bit constant of the given id, if set.
+				bool find(const uint32_t id, uint32_t &value) const;
+
+				const VkSpecializationInfo *info();
+
+				uint64_t hash() const;
+
+				bool operator ==(const specialization &other) const;
+
+				~specialization();
+
+				std::vector<VkSpecializationMapEntry> entry;
+				std::vector<uint8_t> data;
+				VkSpecializationInfo setup;
+			};
+		}
+	}
+#endif
@@ -0,0 +1,298 @@
+#include <cstring>
+#include <algorithm>
+
+#include "debug.hpp"
+#include "staging.hpp"
+
+// NOTE: image copies must start at a multiple of the texel size (and of 4),
+// 16 bytes covers every uncompressed format.
+#define NV_STAGING_IMAGE_ALIGNMENT 16
+#define NV_STAGING_BUFFER_ALIGNMENT 4
+
+nv::vulkan::staging::staging():
+	data(nullptr),
+	head(0),
+	tail(0),
+	start(0),
+	capacity(0)
+{
+}
+
+void nv::vulkan::staging::create(const nv::vulkan::device &d,
+                                 nv::vulkan::allocator &a,
+                                 const nv::vulkan::command_pool &p,
+                                 const uint32_t frames,
+                                 const VkDeviceSize size)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(frames > 0)
+
+	this->capacity = ((size + NV_STAGING_IMAGE_ALIGNMENT - 1)/NV_STAGING_IMAGE_ALIGNMENT)*NV_STAGING_IMAGE_ALIGNMENT;
+
+	this->ring.create(d, this->capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+	this->memory = a.bind(d, this->ring,
+	                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+	                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                      NV_MEMORY_LINEAR);
+
+	ASSERT(this->memory.mapped != nullptr)
+
+	this->data = static_cast<uint8_t*>(this->memory.mapped);
+
+	this->buffer.startup.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	this->buffer.allocate(d, p, frames);
+
+	this->head = 0;
+	this->tail = 0;
+	this->start = 0;
+	this->mark.assign(frames, 0);
+}
+
+void *nv::vulkan::staging::reserve(const VkDeviceSize size,
+                                   const VkDeviceSize alignment,
+                                   VkDeviceSize &offset)
+{
+	ASSERT(this->data != nullptr)
+	ASSERT((this->capacity % alignment) == 0)
+
+	VkDeviceSize position = ((this->head + alignment - 1)/alignment)*alignment;
+
+	// NOTE: a region never wraps around the end of the ring, the remainder of
+	// the ring is skipped instead.
+
+	if ((position % this->capacity) + size > this->capacity)
+		position = (position/this->capacity + 1)*this->capacity;
+
+	if (position + size - this->tail > this->capacity) return nullptr;
+
+	this->head = position + size;
+	offset = position % this->capacity;
+
+	return this->data + offset;
+}
+
+bool nv::vulkan::staging::upload(const nv::vulkan::buffer &b,
+                                 const VkDeviceSize offset,
+                                 const void *data,
+                                 const VkDeviceSize size)
+{
+	ASSERT(b.handle != nullptr)
+	ASSERT(data != nullptr)
+
+	VkDeviceSize position = 0;
+	void *target = this->reserve(size, NV_STAGING_BUFFER_ALIGNMENT, position);
+
+	if (target == nullptr) return false;
+
+	std::memcpy(target, data, size);
+
+	buffer_copy copy;
+
+	copy.target = b.handle;
+	copy.region.size = size;
+	copy.region.dstOffset = offset;
+	copy.region.srcOffset = position;
+
+	this->copies.push_back(copy);
+	return true;
+}
+
+bool nv::vulkan::staging::upload(VkImage i, const VkExtent3D &extent,
+                                 const void *data, const VkDeviceSize size,
+                                 const VkImageLayout layout)
+{
+	ASSERT(i != nullptr)
+	ASSERT(data != nullptr)
+
+	VkDeviceSize position = 0;
+	void *target = this->reserve(size, NV_STAGING_IMAGE_ALIGNMENT, position);
+
+	if (target == nullptr) return false;
+
+	std::memcpy(target, data, size);
+
+	// NOTE: the whole first mip level of the first layer, tightly packed.
+
+	image_copy copy;
+
+	copy.target = i;
+	copy.layout = layout;
+	copy.region.bufferOffset = position;
+	copy.region.bufferRowLength = 0;
+	copy.region.bufferImageHeight = 0;
+	copy.region.imageOffset = {0, 0, 0};
+	copy.region.imageExtent = extent;
+	copy.region.imageSubresource.mipLevel = 0;
+	copy.region.imageSubresource.layerCount = 1;
+	copy.region.imageSubresource.baseArrayLayer = 0;
+	copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	this->images.push_back(copy);
+	return true;
+}
+
+bool nv::vulkan::staging::is_pending() const
+{
+	return (this->copies.size() > 0) || (this->images.size() > 0);
+}
+
+void nv::vulkan::staging::reclaim(const uint32_t slot)
+{
+	ASSERT(slot < this->mark.size())
+
+	// NOTE: frame slots retire in order, thus everything written up to the end
+	// of the last frame of this slot is free again.
+
+	if (this->mark[slot] > this->tail)
+		this->tail = this->mark[slot];
+}
+
+void nv::vulkan::staging::record(const nv::vulkan::device &d,
+                                 const nv::vulkan::allocator &a,
+                                 const uint32_t slot)
+{
+	ASSERT(slot < this->mark.size())
+
+	this->mark[slot] = this->head;
+
+	if (!this->is_pending()) return;
+
+	// Make the host writes of this frame visible to the device:
+
+	const VkDeviceSize length = this->head - this->start;
+
+	if ((this->start % this->capacity) + length > this->capacity)
+		a.flush(d, this->memory, 0, this->capacity);
+	else
+		a.flush(d, this->memory, this->start % this->capacity, length);
+
+	this->start = this->head;
+
+	this->buffer.begin(slot);
+
+	VkCommandBuffer cb = this->buffer.handle[slot];
+
+	// NOTE: the copies may overwrite what the previous frames still read, e.g.
+	// vertices, indices or uniforms written every frame, thus they wait for
+	// those reads (write after read, an execution dependency only).
+
+	this->buffer.barrier(slot, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	                         | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	                         | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0);
+
+	// Buffer copies, one command per destination:
+
+	std::stable_sort(this->copies.begin(), this->copies.end(),
+		[](const buffer_copy &x, const buffer_copy &y) { return x.target < y.target; });
+
+	std::vector<VkBufferCopy> region;
+
+	for (size_t n = 0; n < this->copies.size();)
+	{
+		region.clear();
+
+		size_t m = n;
+		for (; (m < this->copies.size()) && (this->copies[m].target == this->copies[n].target); ++m)
+			region.push_back(this->copies[m].region);
+
+		vkCmdCopyBuffer(cb, this->ring.handle, this->copies[n].target, region.size(), region.data());
+		n = m;
+	}
+
+	// Image copies, in between layout transitions:
+
+	VkImageMemoryBarrier transition;
+
+	transition.pNext = nullptr;
+	transition.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transition.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transition.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	transition.subresourceRange.levelCount = 1;
+	transition.subresourceRange.layerCount = 1;
+	transition.subresourceRange.baseMipLevel = 0;
+	transition.subresourceRange.baseArrayLayer = 0;
+	transition.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	if (this->images.size() > 0)
+	{
+		this->barrier.clear();
+
+		transition.srcAccessMask = 0;
+		transition.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+		for (const auto &copy : this->images)
+		{
+			transition.image = copy.target;
+			this->barrier.push_back(transition);
+		}
+
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		                     0, nullptr, 0, nullptr, this->barrier.size(), this->barrier.data());
+
+		for (const auto &copy : this->images)
+			vkCmdCopyBufferToImage(cb, this->ring.handle, copy.target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+	}
+
+	this->barrier.clear();
+
+	transition.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	transition.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	transition.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+	for (const auto &copy : this->images)
+	{
+		transition.image = copy.target;
+		transition.newLayout = copy.layout;
+		this->barrier.push_back(transition);
+	}
+
+	// NOTE: a single barrier for every consumer of the uploads in the frame
+	// command buffers that follow within the same submission.
+
+	VkMemoryBarrier visibility;
+
+	visibility.pNext = nullptr;
+	visibility.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	visibility.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	visibility.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+	                         | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+	                         | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	                   | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	                   | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     0, 1, &visibility, 0, nullptr, this->barrier.size(), this->barrier.data());
+
+	this->buffer.end(slot);
+
+	this->copies.clear();
+	this->images.clear();
+}
+
+VkDeviceSize nv::vulkan::staging::available() const
+{
+	return this->capacity - (this->head - this->tail);
+}
+
+void nv::vulkan::staging::destroy(const nv::vulkan::device &d,
+                                  nv::vulkan::allocator &a,
+                                  const nv::vulkan::command_pool &p)
+{
+	this->buffer.free(d, p);
+	this->ring.destroy(d);
+	a.release(d, this->memory);
+
+	this->data = nullptr;
+	this->copies.clear();
+	this->images.clear();
+	this->mark.clear();
+}
+
+nv::vulkan::staging::~staging()
+{
+}
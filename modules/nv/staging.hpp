@@ -0,0 +1,84 @@
+#if !defined(NV_STAGING_HEADER)
+	#define NV_STAGING_HEADER
+	#include <vector>
+
+	#include "vulkan.hpp"
+	#include "memory.hpp"
+
+	#if !defined(NV_STAGING_SIZE)
+		#define NV_STAGING_SIZE (16*1024*1024)
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a staging ring is a host-visible buffer that stays mapped for its
+			// whole lifetime. Uploads are written at the head of the ring and their
+			// copies recorded in a batch once per frame. The region used by a frame
+			// returns to the ring once the fence of its frame slot signals.
+
+			struct staging
+			{
+				staging();
+
+				void create(const nv::vulkan::device &d,
+				            nv::vulkan::allocator &a,
+				            const nv::vulkan::command_pool &p,
+				            const uint32_t frames,
+				            const VkDeviceSize size = NV_STAGING_SIZE);
+
+				void *reserve(const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize &offset);
+
+				bool upload(const nv::vulkan::buffer &b, const VkDeviceSize offset,
+				            const void *data, const VkDeviceSize size);
+
+				bool upload(VkImage i, const VkExtent3D &extent, const void *data,
+				            const VkDeviceSize size,
+				            const VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+				bool is_pending() const;
+
+				void reclaim(const uint32_t slot);
+
+				void record(const nv::vulkan::device &d, const nv::vulkan::allocator &a, const uint32_t slot);
+
+				VkDeviceSize available() const;
+
+				void destroy(const nv::vulkan::device &d,
+				             nv::vulkan::allocator &a,
+				             const nv::vulkan::command_pool &p);
+
+				~staging();
+
+				struct buffer_copy
+				{
+					VkBuffer target;
+					VkBufferCopy region;
+				};
+
+				struct image_copy
+				{
+					VkImage target;
+					VkImageLayout layout;
+					VkBufferImageCopy region;
+				};
+
+				// NOTE: head, tail and every mark[n] are monotonic byte counters, their
+				// remainders modulo capacity being the actual offsets in the ring.
+				uint8_t *data;
+				VkDeviceSize head;
+				VkDeviceSize tail;
+				VkDeviceSize start;
+				VkDeviceSize capacity;
+				std::vector<VkDeviceSize> mark;
+				nv::vulkan::buffer ring;
+				nv::vulkan::allocation memory;
+				nv::vulkan::command_buffer buffer;
+				std::vector<buffer_copy> copies;
+				std::vector<image_copy> images;
+				std::vector<VkImageMemoryBarrier> barrier;
+			};
+		}
+	}
+#endif
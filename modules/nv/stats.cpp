@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "debug.hpp"
+#include "stats.hpp"
+
+nv::frame_stats::frame_stats():
+	count(0)
+{
+	for (auto &e : this->ring)
+	{
+		e.sequence.store(0, std::memory_order_relaxed);
+
+		for (auto &t : e.time)
+			t.store(0.0f, std::memory_order_relaxed);
+	}
+}
+
+void nv::frame_stats::push(const sample &s)
+{
+	const uint64_t k = this->count.load(std::memory_order_relaxed);
+	entry &e = this->ring[k % NV_FRAME_STATS_SIZE];
+
+	// NOTE: the k-th frame is complete once its sequence number is 2k + 2.
+
+	e.sequence.store(2*k + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (uint32_t m = 0; m < NV_FRAME_METRIC_COUNT; ++m)
+		e.time[m].store(s.time[m], std::memory_order_relaxed);
+
+	e.sequence.store(2*k + 2, std::memory_order_release);
+	this->count.store(k + 1, std::memory_order_release);
+}
+
+uint64_t nv::frame_stats::size() const
+{
+	return this->count.load(std::memory_order_acquire);
+}
+
+bool nv::frame_stats::read(const uint64_t k, sample &s) const
+{
+	const entry &e = this->ring[k % NV_FRAME_STATS_SIZE];
+
+	if (e.sequence.load(std::memory_order_acquire) != 2*k + 2) return false;
+
+	for (uint32_t m = 0; m < NV_FRAME_METRIC_COUNT; ++m)
+		s.time[m] = e.time[m].load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	return (e.sequence.load(std::memory_order_relaxed) == 2*k + 2);
+}
+
+bool nv::frame_stats::latest(sample &s) const
+{
+	const uint64_t total = this->size();
+
+	return (total > 0) && this->read(total - 1, s);
+}
+
+nv::frame_stats::percentiles nv::frame_stats::summary(const nv::frame_metric m) const
+{
+	ASSERT(m < NV_FRAME_METRIC_COUNT)
+
+	const uint64_t total = this->size();
+	const uint64_t first = (total > NV_FRAME_STATS_SIZE)? total - NV_FRAME_STATS_SIZE : 0;
+
+	std::vector<float> value;
+	value.reserve(total - first);
+
+	sample s;
+
+	for (uint64_t k = first; k < total; ++k)
+		if (this->read(k, s)) value.push_back(s.time[m]);
+
+	percentiles p = {0, 0.0, 0.0, 0.0, 0.0};
+
+	if (value.empty()) return p;
+
+	std::sort(value.begin(), value.end());
+
+	auto rank = [&value](const double q)
+	{
+		const size_t n = static_cast<size_t>(std::ceil(q*value.size()));
+		return static_cast<double>(value[std::max<size_t>(n, 1) - 1]);
+	};
+
+	p.count = value.size();
+	p.p50 = rank(0.50);
+	p.p95 = rank(0.95);
+	p.p99 = rank(0.99);
+	p.max = value.back();
+
+	return p;
+}
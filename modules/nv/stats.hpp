@@ -0,0 +1,70 @@
+#if !defined(NV_STATS_HEADER)
+	#define NV_STATS_HEADER
+	#include <atomic>
+	#include <cstdint>
+
+	#if !defined(NV_FRAME_STATS_SIZE)
+		#define NV_FRAME_STATS_SIZE 512
+	#endif
+
+	namespace nv
+	{
+		enum frame_metric
+		{
+			NV_FRAME_INTERVAL,
+			NV_FRAME_RECORD,
+			NV_FRAME_ACQUIRE,
+			NV_FRAME_FENCE,
+			NV_FRAME_SUBMIT,
+			NV_FRAME_PRESENT,
+			NV_FRAME_PACING,
+			NV_FRAME_METRIC_COUNT
+		};
+
+		// NOTE: a ring of the CPU timings (in milliseconds) of the last frames,
+		// written by the rendering thread only and read from any thread without
+		// locks. Every entry is guarded by a sequence number, odd while being
+		// written, and readers skip the entries overwritten as they read them.
+
+		class frame_stats
+		{
+			public:
+			struct sample
+			{
+				float time[NV_FRAME_METRIC_COUNT];
+			};
+
+			struct percentiles
+			{
+				uint32_t count;
+				double p50;
+				double p95;
+				double p99;
+				double max;
+			};
+
+			frame_stats();
+
+			void push(const sample &s);
+
+			uint64_t size() const;
+
+			bool latest(sample &s) const;
+
+			// NOTE: nearest-rank percentiles over the frames still in the ring.
+			percentiles summary(const nv::frame_metric m) const;
+
+			private:
+			bool read(const uint64_t k, sample &s) const;
+
+			struct entry
+			{
+				std::atomic<uint64_t> sequence;
+				std::atomic<float> time[NV_FRAME_METRIC_COUNT];
+			};
+
+			std::atomic<uint64_t> count;
+			entry ring[NV_FRAME_STATS_SIZE];
+		};
+	}
+#endif
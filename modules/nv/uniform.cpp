@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "debug.hpp"
+#include "uniform.hpp"
+
+nv::vulkan::uniform_ring::uniform_ring():
+	data(nullptr),
+	region(0),
+	alignment(1)
+{
+}
+
+void nv::vulkan::uniform_ring::create(const nv::vulkan::device &d,
+                                      nv::vulkan::allocator &a,
+                                      const nv::vulkan::physical_device &pd, const uint32_t index,
+                                      const uint32_t frames,
+                                      const VkDeviceSize size,
+                                      const VkBufferUsageFlags usage)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(index < pd.count())
+	ASSERT(frames > 0)
+
+	const VkPhysicalDeviceLimits &limits = pd.properties[index].limits;
+
+	// NOTE: indirect commands are read at offsets that are multiples of 4.
+	this->alignment = 4;
+
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		this->alignment = std::max(this->alignment, limits.minUniformBufferOffsetAlignment);
+
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		this->alignment = std::max(this->alignment, limits.minStorageBufferOffsetAlignment);
+
+	this->region = ((size + this->alignment - 1)/this->alignment)*this->alignment;
+
+	this->ring.create(d, this->region*frames, usage);
+
+	// NOTE: device-local host-visible memory, where available, spares the
+	// shaders a read over the bus for every draw.
+
+	this->memory = a.bind(d, this->ring,
+	                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+	                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	                    | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                      NV_MEMORY_LINEAR);
+
+	ASSERT(this->memory.mapped != nullptr)
+
+	this->data = static_cast<uint8_t*>(this->memory.mapped);
+	this->head.assign(frames, 0);
+}
+
+void *nv::vulkan::uniform_ring::push(const uint32_t n, const VkDeviceSize size, uint32_t &offset)
+{
+	ASSERT(this->data != nullptr)
+	ASSERT(n < this->head.size())
+
+	const VkDeviceSize position = ((this->head[n] + this->alignment - 1)/this->alignment)*this->alignment;
+
+	if (position + size > this->region) return nullptr;
+
+	this->head[n] = position + size;
+	offset = static_cast<uint32_t>(n*this->region + position);
+
+	return this->data + offset;
+}
+
+void nv::vulkan::uniform_ring::reset(const uint32_t n)
+{
+	ASSERT(n < this->head.size())
+
+	this->head[n] = 0;
+}
+
+void nv::vulkan::uniform_ring::flush(const nv::vulkan::device &d, const nv::vulkan::allocator &a, const uint32_t n) const
+{
+	ASSERT(n < this->head.size())
+
+	if (this->head[n] > 0)
+		a.flush(d, this->memory, n*this->region, this->head[n]);
+}
+
+nv::vulkan::descriptor_binding nv::vulkan::uniform_ring::binding(const uint32_t binding, const VkDeviceSize range,
+                                                                 const VkDescriptorType type) const
+{
+	ASSERT(this->ring.handle != nullptr)
+	ASSERT(range <= this->region)
+
+	// NOTE: the offset of every draw is given as a dynamic offset at bind.
+	return nv::vulkan::descriptor_binding(binding, type, this->ring.handle, 0, range);
+}
+
+void nv::vulkan::uniform_ring::destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a)
+{
+	if (this->ring.handle == nullptr) return;
+
+	this->ring.destroy(d);
+	a.release(d, this->memory);
+
+	this->data = nullptr;
+	this->head.clear();
+}
+
+nv::vulkan::uniform_ring::~uniform_ring()
+{
+}
@@ -0,0 +1,59 @@
+#if !defined(NV_UNIFORM_HEADER)
+	#define NV_UNIFORM_HEADER
+	#include <vector>
+
+	#include "vulkan.hpp"
+	#include "memory.hpp"
+	#include "descriptor.hpp"
+
+	#if !defined(NV_UNIFORM_RING_SIZE)
+		#define NV_UNIFORM_RING_SIZE (1024*1024)
+	#endif
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			// NOTE: a uniform ring is a host-visible buffer split in one region per
+			// frame slot, each one filled from its start by the uniforms of a frame
+			// and rewound when the slot is recorded again. Draws read their uniforms
+			// through a single dynamic uniform buffer descriptor, with the offsets
+			// returned by push(), thus neither descriptor writes nor allocations.
+
+			struct uniform_ring
+			{
+				uniform_ring();
+
+				// NOTE: other usages (e.g. storage or indirect buffers) make rings of
+				// per-frame data of another kind, aligned for all of them.
+				void create(const nv::vulkan::device &d,
+				            nv::vulkan::allocator &a,
+				            const nv::vulkan::physical_device &pd, const uint32_t index,
+				            const uint32_t frames,
+				            const VkDeviceSize size = NV_UNIFORM_RING_SIZE,
+				            const VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+				// NOTE: nullptr if the region of slot n is full.
+				void *push(const uint32_t n, const VkDeviceSize size, uint32_t &offset);
+
+				void reset(const uint32_t n);
+
+				void flush(const nv::vulkan::device &d, const nv::vulkan::allocator &a, const uint32_t n) const;
+
+				nv::vulkan::descriptor_binding binding(const uint32_t binding, const VkDeviceSize range,
+				                                       const VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) const;
+
+				void destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a);
+
+				~uniform_ring();
+
+				uint8_t *data;
+				VkDeviceSize region;
+				VkDeviceSize alignment;
+				std::vector<VkDeviceSize> head;
+				nv::vulkan::buffer ring;
+				nv::vulkan::allocation memory;
+			};
+		}
+	}
+#endif
@@ -0,0 +1,276 @@
+#if !defined(NV_VERTEX_HEADER)
+	#define NV_VERTEX_HEADER
+	#include <array>
+	#include <cstddef>
+	#include <cstdint>
+	#include <type_traits>
+
+	#include <glm/glm.hpp>
+	#include <glm/gtc/type_precision.hpp>
+
+	#include "vulkan.hpp"
+
+	// NOTE: the description of a member of an interleaved vertex struct, e.g.
+	//
+	//   struct vertex { glm::vec3 position; nv::vulkan::unorm<glm::u8vec4> color; };
+	//
+	//   using layout = nv::vulkan::vertex_layout<vertex,
+	//                                            NV_VERTEX_ATTRIBUTE(vertex, position),
+	//                                            NV_VERTEX_ATTRIBUTE(vertex, color)>;
+
+	#define NV_VERTEX_ATTRIBUTE(type, member) \
+		nv::vulkan::vertex_attribute<decltype(type::member), offsetof(type, member)>
+
+	namespace nv
+	{
+		namespace vulkan
+		{
+			enum vertex_kind
+			{
+				NV_VERTEX_SFLOAT,
+				NV_VERTEX_SINT,
+				NV_VERTEX_UINT,
+				NV_VERTEX_SNORM,
+				NV_VERTEX_UNORM,
+				NV_VERTEX_INVALID
+			};
+
+			// NOTE: integer attributes are read as integers (ivec, uvec) by shaders,
+			// unless wrapped as normalized, thus read as floats in [-1, 1] or [0, 1].
+
+			template <typename T>
+			struct snorm
+			{
+				T value;
+			};
+
+			template <typename T>
+			struct unorm
+			{
+				T value;
+			};
+
+			template <typename T>
+			struct vertex_component
+			{
+				static constexpr vertex_kind kind = NV_VERTEX_INVALID;
+				static constexpr uint32_t bits = 0;
+			};
+
+			#define NV_VERTEX_COMPONENT(type, k) \
+				template <> \
+				struct vertex_component<type> \
+				{ \
+					static constexpr vertex_kind kind = k; \
+					static constexpr uint32_t bits = 8*sizeof(type); \
+				};
+
+			NV_VERTEX_COMPONENT(float, NV_VERTEX_SFLOAT)
+			NV_VERTEX_COMPONENT(double, NV_VERTEX_SFLOAT)
+			NV_VERTEX_COMPONENT(int8_t, NV_VERTEX_SINT)
+			NV_VERTEX_COMPONENT(int16_t, NV_VERTEX_SINT)
+			NV_VERTEX_COMPONENT(int32_t, NV_VERTEX_SINT)
+			NV_VERTEX_COMPONENT(uint8_t, NV_VERTEX_UINT)
+			NV_VERTEX_COMPONENT(uint16_t, NV_VERTEX_UINT)
+			NV_VERTEX_COMPONENT(uint32_t, NV_VERTEX_UINT)
+
+			#undef NV_VERTEX_COMPONENT
+
+			// NOTE: the kind, size and number of components of an attribute type,
+			// either a scalar or a glm vector of them.
+
+			template <typename T>
+			struct vertex_traits
+			{
+				static constexpr vertex_kind kind = vertex_component<T>::kind;
+				static constexpr uint32_t bits = vertex_component<T>::bits;
+				static constexpr uint32_t count = 1;
+			};
+
+			template <glm::length_t L, typename T, glm::qualifier Q>
+			struct vertex_traits<glm::vec<L, T, Q>>
+			{
+				static constexpr vertex_kind kind = vertex_component<T>::kind;
+				static constexpr uint32_t bits = vertex_component<T>::bits;
+				static constexpr uint32_t count = L;
+			};
+
+			template <typename T>
+			struct vertex_traits<nv::vulkan::snorm<T>>
+			{
+				static constexpr vertex_kind kind = (vertex_traits<T>::kind == NV_VERTEX_SINT) && (vertex_traits<T>::bits <= 16)?
+				                                    NV_VERTEX_SNORM : NV_VERTEX_INVALID;
+				static constexpr uint32_t bits = vertex_traits<T>::bits;
+				static constexpr uint32_t count = vertex_traits<T>::count;
+			};
+
+			template <typename T>
+			struct vertex_traits<nv::vulkan::unorm<T>>
+			{
+				static constexpr vertex_kind kind = (vertex_traits<T>::kind == NV_VERTEX_UINT) && (vertex_traits<T>::bits <= 16)?
+				                                    NV_VERTEX_UNORM : NV_VERTEX_INVALID;
+				static constexpr uint32_t bits = vertex_traits<T>::bits;
+				static constexpr uint32_t count = vertex_traits<T>::count;
+			};
+
+			constexpr VkFormat vertex_format_of(const vertex_kind kind, const uint32_t bits, const uint32_t count)
+			{
+				#define NV_VERTEX_FORMATS(b, x1, x2, x3, x4) \
+					if (bits == b) \
+					{ \
+						if (count == 1) return x1; \
+						if (count == 2) return x2; \
+						if (count == 3) return x3; \
+						if (count == 4) return x4; \
+					}
+
+				switch (kind)
+				{
+					case NV_VERTEX_SFLOAT:
+						NV_VERTEX_FORMATS(32, VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT)
+						NV_VERTEX_FORMATS(64, VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT)
+						break;
+
+					case NV_VERTEX_SINT:
+						NV_VERTEX_FORMATS(8, VK_FORMAT_R8_SINT, VK_FORMAT_R8G8_SINT, VK_FORMAT_R8G8B8_SINT, VK_FORMAT_R8G8B8A8_SINT)
+						NV_VERTEX_FORMATS(16, VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT)
+						NV_VERTEX_FORMATS(32, VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT)
+						break;
+
+					case NV_VERTEX_UINT:
+						NV_VERTEX_FORMATS(8, VK_FORMAT_R8_UINT, VK_FORMAT_R8G8_UINT, VK_FORMAT_R8G8B8_UINT, VK_FORMAT_R8G8B8A8_UINT)
+						NV_VERTEX_FORMATS(16, VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT)
+						NV_VERTEX_FORMATS(32, VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT)
+						break;
+
+					case NV_VERTEX_SNORM:
+						NV_VERTEX_FORMATS(8, VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM, VK_FORMAT_R8G8B8_SNORM, VK_FORMAT_R8G8B8A8_SNORM)
+						NV_VERTEX_FORMATS(16, VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM)
+						break;
+
+					case NV_VERTEX_UNORM:
+						NV_VERTEX_FORMATS(8, VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM)
+						NV_VERTEX_FORMATS(16, VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM)
+						break;
+
+					default:
+						break;
+				}
+
+				#undef NV_VERTEX_FORMATS
+
+				return VK_FORMAT_UNDEFINED;
+			}
+
+			template <typename T>
+			struct vertex_format
+			{
+				static constexpr VkFormat value = vertex_format_of(vertex_traits<T>::kind,
+				                                                   vertex_traits<T>::bits,
+				                                                   vertex_traits<T>::count);
+
+				static_assert(value != VK_FORMAT_UNDEFINED, "no vertex format for this attribute type");
+
+				static_assert(8*sizeof(T) == vertex_traits<T>::bits*vertex_traits<T>::count,
+				              "vertex attribute type with padding (e.g. an aligned glm type)");
+			};
+
+			template <typename T, size_t Offset>
+			struct vertex_attribute
+			{
+				using type = T;
+
+				static constexpr uint32_t offset = Offset;
+				static constexpr uint32_t size = sizeof(T);
+				static constexpr VkFormat format = nv::vulkan::vertex_format<T>::value;
+			};
+
+			// NOTE: a description of the bindings and attributes of a vertex input,
+			// from a list of bindings (vertex_layout or vertex_streams) in order of
+			// location, computed once at compile time.
+
+			template <uint32_t B, uint32_t A>
+			struct vertex_input
+			{
+				std::array<VkVertexInputBindingDescription, B> binding;
+				std::array<VkVertexInputAttributeDescription, A> attribute;
+			};
+
+			// NOTE: an interleaved layout, every attribute in a single binding whose
+			// stride is the size of the vertex struct V.
+
+			template <typename V, typename... A>
+			struct vertex_layout
+			{
+				static_assert(sizeof...(A) > 0, "a vertex layout without attributes");
+				static_assert(std::is_standard_layout<V>::value, "offsetof() requires a standard layout vertex struct");
+
+				static constexpr uint32_t binding_count = 1;
+				static constexpr uint32_t attribute_count = sizeof...(A);
+
+				static constexpr bool fits()
+				{
+					bool result = true;
+
+					for (const bool b : {((A::offset + A::size) <= sizeof(V))...})
+						result = result && b;
+
+					return result;
+				}
+
+				static_assert(fits(), "a vertex attribute beyond the end of its vertex struct");
+
+				static constexpr vertex_input<1, sizeof...(A)> describe(const VkVertexInputRate rate = VK_VERTEX_INPUT_RATE_VERTEX)
+				{
+					vertex_input<1, sizeof...(A)> input = {};
+
+					input.binding[0] = {0, static_cast<uint32_t>(sizeof(V)), rate};
+
+					const uint32_t offset[] = {A::offset...};
+					const VkFormat format[] = {A::format...};
+
+					uint32_t location = 0;
+
+					for (uint32_t n = 0; n < sizeof...(A); ++n)
+					{
+						input.attribute[n] = {location, 0, format[n], offset[n]};
+						location += nv::vulkan::pipeline::locations(format[n]);
+					}
+
+					return input;
+				}
+			};
+
+			// NOTE: a multi-stream (SoA) layout, the n-th attribute being read from
+			// a tightly packed array of T[n] in binding n.
+
+			template <typename... T>
+			struct vertex_streams
+			{
+				static_assert(sizeof...(T) > 0, "a vertex layout without attributes");
+
+				static constexpr uint32_t binding_count = sizeof...(T);
+				static constexpr uint32_t attribute_count = sizeof...(T);
+
+				static constexpr vertex_input<sizeof...(T), sizeof...(T)> describe(const VkVertexInputRate rate = VK_VERTEX_INPUT_RATE_VERTEX)
+				{
+					vertex_input<sizeof...(T), sizeof...(T)> input = {};
+
+					const uint32_t stride[] = {static_cast<uint32_t>(sizeof(T))...};
+					const VkFormat format[] = {nv::vulkan::vertex_format<T>::value...};
+
+					uint32_t location = 0;
+
+					for (uint32_t n = 0; n < sizeof...(T); ++n)
+					{
+						input.binding[n] = {n, stride[n], rate};
+						input.attribute[n] = {location, n, format[n], 0};
+						location += nv::vulkan::pipeline::locations(format[n]);
+					}
+
+					return input;
+				}
+			};
+		}
+	}
+#endif
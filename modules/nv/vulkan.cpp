@@ -1,16 +1,10 @@
-#include <fstream>
+#include <cstring>
+#include <algorithm>
 
 #include "debug.hpp"
 #include "vulkan.hpp"
-
-#define NV_VULKAN_ERROR(name, code)                                 \
-{                                                                   \
-  if (code != VK_SUCCESS)                                           \
-  {                                                                 \
-	 PRINT_ERROR("%s failed with error code %d\n", name, (int) code) \
-	 exit(EXIT_FAILURE);                                             \
-  }                                                                 \
-}
+#include "memory.hpp"
+#include "profiler.hpp"
 
 static const char* const layers[] =
 {
@@ -20,8 +14,6 @@ static const char* const layers[] =
 	"VK_LAYER_LUNARG_core_validation"
 };
 
-static const char* const extension_name[] = {"VK_KHR_swapchain"};
-
 //
 // nv::vulkan::instance
 //
@@ -115,6 +107,30 @@ uint32_t nv::vulkan::physical_device::count() const
 	return this->handle.size();
 }
 
+VkFormat nv::vulkan::physical_device::depth_format(const uint32_t index, const bool stencil) const
+{
+	ASSERT(index < this->handle.size())
+
+	// NOTE: every device supports D16_UNORM, and either X8_D24_UNORM_PACK32 or
+	// D32_SFLOAT, as well as either D24_UNORM_S8_UINT or D32_SFLOAT_S8_UINT.
+
+	static const VkFormat depth[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+	static const VkFormat depth_stencil[] = {VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+	                                         VK_FORMAT_D16_UNORM_S8_UINT};
+
+	for (const auto f : stencil? depth_stencil : depth)
+	{
+		VkFormatProperties p;
+		vkGetPhysicalDeviceFormatProperties(this->handle[index], f, &p);
+
+		if (p.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			return f;
+	}
+
+	PRINT_ERROR("%s\n", "error: no depth format is supported as an attachment")
+	exit(EXIT_FAILURE);
+}
+
 nv::vulkan::physical_device::~physical_device()
 {
 	this->handle.clear();
@@ -129,27 +145,56 @@ nv::vulkan::physical_device::~physical_device()
 nv::vulkan::device::device():
 	handle(nullptr)
 {
-	this->priority.push_back(1.0f);
-
-	this->info.flags = 0;
-	this->info.pNext = nullptr;
-	this->info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	// NOTE: using the 1st queue family and its 1st queue as default, for all
+	// kinds of work, until create() takes the one of the caller.
 
-	// NOTE: using the 1st queue family and its 1st queue as default.
-	this->info.queueCount = 1;
-	this->info.queueFamilyIndex = 0;
-	this->info.pQueuePriorities = this->priority.data();
+	for (uint32_t n = 0; n < NV_QUEUE_USAGE_COUNT; ++n)
+	{
+		this->family_index[n] = 0;
+		this->queue_index[n] = 0;
+	}
 
 	this->setup.flags = 0;
 	this->setup.pNext = nullptr;
 	this->setup.enabledLayerCount = 0;
-	this->setup.queueCreateInfoCount = 1;
-	this->setup.enabledExtensionCount = 1;
+	this->setup.queueCreateInfoCount = 0;
+	this->setup.enabledExtensionCount = 0;
 	this->setup.pEnabledFeatures = nullptr;
+	this->setup.pQueueCreateInfos = nullptr;
 	this->setup.ppEnabledLayerNames = nullptr;
-	this->setup.pQueueCreateInfos = &this->info;
-	this->setup.ppEnabledExtensionNames = extension_name;
+	this->setup.ppEnabledExtensionNames = nullptr;
 	this->setup.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+	// NOTE: all features are disabled until create() finds which ones are
+	// supported, since features2 (and its chain) replaces pEnabledFeatures.
+
+	this->features = {};
+	this->features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+	this->vulkan11 = {};
+	this->vulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_11_FEATURES;
+
+	this->vulkan12 = {};
+	this->vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+	this->dynamic_state = {};
+	this->dynamic_state.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+	this->dynamic_state2 = {};
+	this->dynamic_state2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+
+	this->dynamic_state3 = {};
+	this->dynamic_state3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+	this->set_cull_mode = nullptr;
+	this->set_front_face = nullptr;
+	this->set_topology = nullptr;
+	this->set_depth_test = nullptr;
+	this->set_depth_write = nullptr;
+	this->set_depth_compare = nullptr;
+	this->set_primitive_restart = nullptr;
+	this->set_blend_enable = nullptr;
+	this->draw_indexed_indirect_count = nullptr;
 }
 
 void nv::vulkan::device::create(const nv::vulkan::physical_device &d, const uint32_t index)
@@ -157,18 +202,184 @@ void nv::vulkan::device::create(const nv::vulkan::physical_device &d, const uint
 	ASSERT(index < d.count())
 	ASSERT(d.handle[index] != nullptr)
 
-	// FIXME: Vulkan warning: family index is not less than counter (?).
 	VkResult error;
 	uint32_t counter = 0;
 
-	error = vkCreateDevice(d.handle[index], &this->setup, nullptr, &this->handle);
-	NV_VULKAN_ERROR("vkCreateDevice()", error)
-
 	vkGetPhysicalDeviceQueueFamilyProperties(d.handle[index], &counter, nullptr);
 
 	this->family.resize(counter);
 
 	vkGetPhysicalDeviceQueueFamilyProperties(d.handle[index], &counter, this->family.data());
+
+	// NOTE: compute and transfers share the graphics queue. Queues of other
+	// families would only overlap with graphics given ownership transfers and
+	// semaphores between the queues, for resources the renderer rewrites every
+	// frame and does not track.
+
+	const uint32_t g = this->family_index[NV_QUEUE_GRAPHICS];
+
+	ASSERT(g < counter)
+
+	for (uint32_t n = 0; n < NV_QUEUE_USAGE_COUNT; ++n)
+	{
+		this->family_index[n] = g;
+		this->queue_index[n] = 0;
+	}
+
+	this->priority.assign(1, 1.0f);
+
+	VkDeviceQueueCreateInfo queue;
+
+	queue.flags = 0;
+	queue.pNext = nullptr;
+	queue.queueFamilyIndex = g;
+	queue.queueCount = 1;
+	queue.pQueuePriorities = this->priority.data();
+	queue.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+
+	this->info.assign(1, queue);
+
+	this->setup.pQueueCreateInfos = this->info.data();
+	this->setup.queueCreateInfoCount = this->info.size();
+
+	// Query of the extensions available:
+
+	error = vkEnumerateDeviceExtensionProperties(d.handle[index], nullptr, &counter, nullptr);
+	NV_VULKAN_ERROR("vkEnumerateDeviceExtensionProperties()", error)
+
+	this->available.resize(counter);
+
+	error = vkEnumerateDeviceExtensionProperties(d.handle[index], nullptr, &counter, this->available.data());
+	NV_VULKAN_ERROR("vkEnumerateDeviceExtensionProperties()", error)
+
+	// Query of the Vulkan 1.1 and 1.2 features (if the device supports 1.2) and
+	// of the extended dynamic state features, chaining only the structures of
+	// supported extensions:
+
+	const bool core12 = d.properties[index].apiVersion >= VK_API_VERSION_1_2;
+
+	void **next = &this->features.pNext;
+
+	if (core12)
+	{
+		*next = &this->vulkan11;
+		this->vulkan11.pNext = &this->vulkan12;
+		next = &this->vulkan12.pNext;
+	}
+
+	if (this->has_extension("VK_EXT_extended_dynamic_state"))
+	{
+		*next = &this->dynamic_state;
+		next = &this->dynamic_state.pNext;
+	}
+
+	if (this->has_extension("VK_EXT_extended_dynamic_state2"))
+	{
+		*next = &this->dynamic_state2;
+		next = &this->dynamic_state2.pNext;
+	}
+
+	if (this->has_extension("VK_EXT_extended_dynamic_state3"))
+	{
+		*next = &this->dynamic_state3;
+		next = &this->dynamic_state3.pNext;
+	}
+
+	vkGetPhysicalDeviceFeatures2(d.handle[index], &this->features);
+
+	// NOTE: only the features in use are enabled, the remaining ones (core
+	// features included) are cleared out.
+
+	const VkPhysicalDeviceFeatures core = this->features.features;
+
+	this->features.features = {};
+	this->features.features.multiDrawIndirect = core.multiDrawIndirect;
+	this->features.features.drawIndirectFirstInstance = core.drawIndirectFirstInstance;
+
+	const VkBool32 draw_parameters = this->vulkan11.shaderDrawParameters;
+	void *vulkan11_next = this->vulkan11.pNext;
+
+	this->vulkan11 = {};
+	this->vulkan11.pNext = vulkan11_next;
+	this->vulkan11.shaderDrawParameters = draw_parameters;
+	this->vulkan11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_11_FEATURES;
+
+	const VkBool32 indirect_count = this->vulkan12.drawIndirectCount;
+	void *vulkan12_next = this->vulkan12.pNext;
+
+	this->vulkan12 = {};
+	this->vulkan12.pNext = vulkan12_next;
+	this->vulkan12.drawIndirectCount = indirect_count;
+	this->vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+	const VkBool32 eds2 = this->dynamic_state2.extendedDynamicState2;
+	void *eds2_next = this->dynamic_state2.pNext;
+
+	this->dynamic_state2 = {};
+	this->dynamic_state2.pNext = eds2_next;
+	this->dynamic_state2.extendedDynamicState2 = eds2;
+	this->dynamic_state2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+
+	const VkBool32 eds3 = this->dynamic_state3.extendedDynamicState3ColorBlendEnable;
+	void *eds3_next = this->dynamic_state3.pNext;
+
+	this->dynamic_state3 = {};
+	this->dynamic_state3.pNext = eds3_next;
+	this->dynamic_state3.extendedDynamicState3ColorBlendEnable = eds3;
+	this->dynamic_state3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+	// NOTE: devices without presentation support (e.g. software rasterizers
+	// with no display) still serve headless renderers.
+
+	if (this->has_extension("VK_KHR_swapchain"))
+		this->extension.push_back("VK_KHR_swapchain");
+
+	if (this->dynamic_state.extendedDynamicState)
+		this->extension.push_back("VK_EXT_extended_dynamic_state");
+
+	if (this->dynamic_state2.extendedDynamicState2)
+		this->extension.push_back("VK_EXT_extended_dynamic_state2");
+
+	if (this->dynamic_state3.extendedDynamicState3ColorBlendEnable)
+		this->extension.push_back("VK_EXT_extended_dynamic_state3");
+
+	this->setup.pNext = &this->features;
+	this->setup.enabledExtensionCount = this->extension.size();
+	this->setup.ppEnabledExtensionNames = this->extension.data();
+
+	error = vkCreateDevice(d.handle[index], &this->setup, nullptr, &this->handle);
+	NV_VULKAN_ERROR("vkCreateDevice()", error)
+
+	// Entry points of the extensions enabled:
+
+	auto load = [this](const char *name) { return vkGetDeviceProcAddr(this->handle, name); };
+
+	if (this->dynamic_state.extendedDynamicState)
+	{
+		this->set_cull_mode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(load("vkCmdSetCullModeEXT"));
+		this->set_front_face = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(load("vkCmdSetFrontFaceEXT"));
+		this->set_topology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(load("vkCmdSetPrimitiveTopologyEXT"));
+		this->set_depth_test = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(load("vkCmdSetDepthTestEnableEXT"));
+		this->set_depth_write = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(load("vkCmdSetDepthWriteEnableEXT"));
+		this->set_depth_compare = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(load("vkCmdSetDepthCompareOpEXT"));
+	}
+
+	if (this->dynamic_state2.extendedDynamicState2)
+		this->set_primitive_restart = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(load("vkCmdSetPrimitiveRestartEnableEXT"));
+
+	if (this->dynamic_state3.extendedDynamicState3ColorBlendEnable)
+		this->set_blend_enable = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(load("vkCmdSetColorBlendEnableEXT"));
+
+	if (this->vulkan12.drawIndirectCount)
+		this->draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(load("vkCmdDrawIndexedIndirectCount"));
+}
+
+bool nv::vulkan::device::has_extension(const char *name) const
+{
+	for (const auto &e : this->available)
+		if (std::strcmp(e.extensionName, name) == 0) return true;
+
+	return false;
 }
 
 void nv::vulkan::device::destroy()
@@ -198,18 +409,28 @@ nv::vulkan::command_pool::command_pool():
 	this->setup.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 }
 
-void nv::vulkan::command_pool::create(const nv::vulkan::device &d)
+void nv::vulkan::command_pool::create(const nv::vulkan::device &d, const queue_usage u)
 {
 	ASSERT(d.handle != nullptr)
+	ASSERT(u < NV_QUEUE_USAGE_COUNT)
 
-	this->setup.queueFamilyIndex = d.info.queueFamilyIndex;
+	this->setup.queueFamilyIndex = d.family_index[u];
 
 	VkResult error = vkCreateCommandPool(d.handle, &this->setup, nullptr, &this->handle);
 	NV_VULKAN_ERROR("vkCreateCommandPool()", error)
 
-	// TODO: as for now only the 1st queue (= 0) is used.
-	vkGetDeviceQueue(d.handle, this->setup.queueFamilyIndex, 0, &this->queue);
-	NV_VULKAN_ERROR("vkGetDeviceQueue()", error)
+	vkGetDeviceQueue(d.handle, this->setup.queueFamilyIndex, d.queue_index[u], &this->queue);
+}
+
+void nv::vulkan::command_pool::reset(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(this->handle != nullptr)
+
+	// NOTE: every command buffer allocated from this pool goes back to the
+	// initial state at once, which is cheaper than resetting them one by one.
+	VkResult error = vkResetCommandPool(d.handle, this->handle, 0);
+	NV_VULKAN_ERROR("vkResetCommandPool()", error)
 }
 
 void nv::vulkan::command_pool::destroy(const nv::vulkan::device &d)
@@ -248,6 +469,30 @@ nv::vulkan::command_buffer::command_buffer()
 	this->startup.pNext = nullptr;
 	this->startup.pInheritanceInfo = nullptr;
 	this->startup.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	this->inheritance.pNext = nullptr;
+	this->inheritance.subpass = 0;
+	this->inheritance.renderPass = nullptr;
+	this->inheritance.framebuffer = nullptr;
+	this->inheritance.queryFlags = 0;
+	this->inheritance.pipelineStatistics = 0;
+	this->inheritance.occlusionQueryEnable = VK_FALSE;
+	this->inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+	// NOTE: the color output stage is where a freshly acquired swapchain image
+	// is first written, thus the only stage that needs to wait for it.
+
+	this->stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	this->info.pNext = nullptr;
+	this->info.commandBufferCount = 1;
+	this->info.waitSemaphoreCount = 0;
+	this->info.pWaitSemaphores = nullptr;
+	this->info.signalSemaphoreCount = 0;
+	this->info.pSignalSemaphores = nullptr;
+	this->info.pCommandBuffers = nullptr;
+	this->info.pWaitDstStageMask = &this->stage;
+	this->info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 }
 
 void nv::vulkan::command_buffer::allocate(const nv::vulkan::device &d,
@@ -265,6 +510,18 @@ void nv::vulkan::command_buffer::allocate(const nv::vulkan::device &d,
 	NV_VULKAN_ERROR("vkAllocateCommandBuffers()", error)
 }
 
+void nv::vulkan::command_buffer::free(const nv::vulkan::device &d,
+                                      const nv::vulkan::command_pool &p)
+{
+	if (this->handle.size() == 0) return;
+
+	ASSERT(d.handle != nullptr)
+	ASSERT(p.handle != nullptr)
+
+	vkFreeCommandBuffers(d.handle, p.handle, this->handle.size(), this->handle.data());
+	this->handle.clear();
+}
+
 uint32_t nv::vulkan::command_buffer::size()
 {
 	return this->handle.size();
@@ -276,12 +533,186 @@ void nv::vulkan::command_buffer::begin(const uint32_t n)
 	NV_VULKAN_ERROR("vkBeginCommandBuffer()", error)
 }
 
+void nv::vulkan::command_buffer::begin(const uint32_t n, VkRenderPass p, VkFramebuffer f)
+{
+	ASSERT(p != nullptr)
+	ASSERT(n < this->handle.size())
+	ASSERT(this->setup.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY)
+
+	// NOTE: a secondary command buffer that continues the first subpass of a
+	// render pass begun by the primary command buffer that executes it.
+
+	this->inheritance.renderPass = p;
+	this->inheritance.framebuffer = f;
+
+	this->startup.pInheritanceInfo = &this->inheritance;
+	this->startup.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+	VkResult error = vkBeginCommandBuffer(this->handle[n], &this->startup);
+	NV_VULKAN_ERROR("vkBeginCommandBuffer()", error)
+}
+
 void nv::vulkan::command_buffer::end(const uint32_t n)
 {
 	VkResult error = vkEndCommandBuffer(this->handle[n]);
 	NV_VULKAN_ERROR("vkEndCommandBuffer()", error)
 }
 
+void nv::vulkan::command_buffer::execute(const uint32_t n, const std::vector<VkCommandBuffer> &list)
+{
+	ASSERT(n < this->handle.size())
+
+	if (list.size() == 0) return;
+
+	vkCmdExecuteCommands(this->handle[n], list.size(), list.data());
+}
+
+void nv::vulkan::command_buffer::draw(const uint32_t n,
+                                      const uint32_t vertex_count,
+                                      const uint32_t instance_count)
+{
+	ASSERT(n < this->handle.size())
+
+	vkCmdDraw(this->handle[n], vertex_count, instance_count, 0, 0);
+}
+
+void nv::vulkan::command_buffer::draw_indexed(const uint32_t n,
+                                              const uint32_t index_count,
+                                              const uint32_t instance_count,
+                                              const uint32_t first_index,
+                                              const int32_t vertex_offset)
+{
+	ASSERT(n < this->handle.size())
+
+	vkCmdDrawIndexed(this->handle[n], index_count, instance_count, first_index, vertex_offset, 0);
+}
+
+void nv::vulkan::command_buffer::draw_indexed_indirect(const nv::vulkan::device &d, const uint32_t n,
+                                                       VkBuffer b, const VkDeviceSize offset, const uint32_t count)
+{
+	ASSERT(n < this->handle.size())
+	ASSERT(b != nullptr)
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	if (d.features.features.multiDrawIndirect)
+	{
+		vkCmdDrawIndexedIndirect(this->handle[n], b, offset, count, stride);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+		vkCmdDrawIndexedIndirect(this->handle[n], b, offset + i*stride, 1, stride);
+}
+
+void nv::vulkan::command_buffer::draw_indexed_indirect_count(const nv::vulkan::device &d, const uint32_t n,
+                                                             VkBuffer b, const VkDeviceSize offset,
+                                                             VkBuffer counter, const VkDeviceSize counter_offset,
+                                                             const uint32_t max_count)
+{
+	ASSERT(n < this->handle.size())
+	ASSERT(b != nullptr)
+	ASSERT(counter != nullptr)
+	ASSERT(d.draw_indexed_indirect_count != nullptr)
+
+	d.draw_indexed_indirect_count(this->handle[n], b, offset, counter, counter_offset,
+	                              max_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void nv::vulkan::command_buffer::bind_vertices(const uint32_t n, const VkBuffer *buffers,
+                                               const VkDeviceSize *offsets, const uint32_t count)
+{
+	ASSERT(n < this->handle.size())
+
+	if (count > 0) vkCmdBindVertexBuffers(this->handle[n], 0, count, buffers, offsets);
+}
+
+void nv::vulkan::command_buffer::bind_indices(const uint32_t n, VkBuffer b,
+                                              const VkDeviceSize offset, const VkIndexType type)
+{
+	ASSERT(n < this->handle.size())
+	ASSERT(b != nullptr)
+
+	vkCmdBindIndexBuffer(this->handle[n], b, offset, type);
+}
+
+void nv::vulkan::command_buffer::dispatch(const uint32_t n, const uint32_t x, const uint32_t y, const uint32_t z)
+{
+	ASSERT(n < this->handle.size())
+
+	vkCmdDispatch(this->handle[n], x, y, z);
+}
+
+void nv::vulkan::command_buffer::dispatch_indirect(const uint32_t n, VkBuffer b, const VkDeviceSize offset)
+{
+	ASSERT(n < this->handle.size())
+	ASSERT(b != nullptr)
+
+	vkCmdDispatchIndirect(this->handle[n], b, offset);
+}
+
+void nv::vulkan::command_buffer::barrier(const uint32_t n,
+                                         const VkPipelineStageFlags from, const VkPipelineStageFlags to,
+                                         const VkAccessFlags from_access, const VkAccessFlags to_access)
+{
+	ASSERT(n < this->handle.size())
+
+	VkMemoryBarrier b;
+
+	b.pNext = nullptr;
+	b.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	b.srcAccessMask = from_access;
+	b.dstAccessMask = to_access;
+
+	vkCmdPipelineBarrier(this->handle[n], from, to, 0, 1, &b, 0, nullptr, 0, nullptr);
+}
+
+void nv::vulkan::command_buffer::barrier(const uint32_t n,
+                                         const VkPipelineStageFlags from, const VkPipelineStageFlags to,
+                                         const VkBufferMemoryBarrier *buffers, const uint32_t buffer_count,
+                                         const VkImageMemoryBarrier *images, const uint32_t image_count)
+{
+	ASSERT(n < this->handle.size())
+
+	vkCmdPipelineBarrier(this->handle[n], from, to, 0, 0, nullptr, buffer_count, buffers, image_count, images);
+}
+
+void nv::vulkan::command_buffer::submit(const uint32_t n, VkQueue q,
+                                        VkSemaphore wait, VkSemaphore signal, VkFence f,
+                                        const VkCommandBuffer *first, const uint32_t first_count,
+                                        VkCommandBuffer last)
+{
+	ASSERT(q != nullptr)
+	ASSERT(first_count <= 2)
+	ASSERT(n < this->handle.size())
+
+	// NOTE: optional command buffers that run first and last within the same
+	// batch, e.g. the copies of a staging ring or a readback, are covered by
+	// the same fence.
+
+	VkCommandBuffer batch[4];
+	uint32_t counter = 0;
+
+	for (uint32_t k = 0; k < first_count; ++k)
+		if (first[k] != VK_NULL_HANDLE) batch[counter++] = first[k];
+
+	batch[counter++] = this->handle[n];
+
+	if (last != VK_NULL_HANDLE) batch[counter++] = last;
+
+	this->info.commandBufferCount = counter;
+	this->info.pCommandBuffers = batch;
+
+	this->info.pWaitSemaphores = &wait;
+	this->info.waitSemaphoreCount = (wait != VK_NULL_HANDLE)? 1 : 0;
+
+	this->info.pSignalSemaphores = &signal;
+	this->info.signalSemaphoreCount = (signal != VK_NULL_HANDLE)? 1 : 0;
+
+	const VkResult error = vkQueueSubmit(q, 1, &this->info, f);
+	NV_VULKAN_ERROR("vkQueueSubmit()", error)
+}
+
 nv::vulkan::command_buffer::~command_buffer()
 {
 }
@@ -333,6 +764,96 @@ nv::vulkan::semaphore::~semaphore()
 	}
 }
 
+//
+// nv::vulkan::fence
+//
+
+nv::vulkan::fence::fence()
+{
+	// NOTE: fences are born signaled so that the very first wait() of a frame
+	// slot that has never been submitted returns at once.
+
+	this->setup.pNext = nullptr;
+	this->setup.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	this->setup.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+}
+
+void nv::vulkan::fence::create(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+
+	VkFence f;
+
+	const VkResult error = vkCreateFence(d.handle, &this->setup, nullptr, &f);
+	NV_VULKAN_ERROR("vkCreateFence()", error)
+
+	this->handle.push_back(f);
+}
+
+void nv::vulkan::fence::wait(const nv::vulkan::device &d, const uint32_t n)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(n < this->handle.size())
+
+	const VkResult error = vkWaitForFences(d.handle, 1, &this->handle[n], VK_TRUE, UINT64_MAX);
+	NV_VULKAN_ERROR("vkWaitForFences()", error)
+}
+
+void nv::vulkan::fence::wait_all(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+
+	if (this->handle.size() == 0) return;
+
+	const VkResult error = vkWaitForFences(d.handle, this->handle.size(), this->handle.data(), VK_TRUE, UINT64_MAX);
+	NV_VULKAN_ERROR("vkWaitForFences()", error)
+}
+
+void nv::vulkan::fence::reset(const nv::vulkan::device &d, const uint32_t n)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(n < this->handle.size())
+
+	const VkResult error = vkResetFences(d.handle, 1, &this->handle[n]);
+	NV_VULKAN_ERROR("vkResetFences()", error)
+}
+
+bool nv::vulkan::fence::is_signaled(const nv::vulkan::device &d, const uint32_t n) const
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(n < this->handle.size())
+
+	const VkResult status = vkGetFenceStatus(d.handle, this->handle[n]);
+
+	if (status != VK_NOT_READY) NV_VULKAN_ERROR("vkGetFenceStatus()", status)
+
+	return (status == VK_SUCCESS);
+}
+
+void nv::vulkan::fence::destroy(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+
+	for (uint32_t n = 0; n < this->handle.size(); ++n)
+		vkDestroyFence(d.handle, this->handle[n], nullptr);
+
+	this->handle.clear();
+}
+
+uint32_t nv::vulkan::fence::size() const
+{
+	return this->handle.size();
+}
+
+nv::vulkan::fence::~fence()
+{
+	if (this->handle.size() > 0)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a list of nv::vulkan::fence instances before calling nv::vulkan::fence::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
 //
 // nv::vulkan::surface
 //
@@ -396,6 +917,36 @@ void nv::vulkan::surface::create(GLFWwindow *w, const nv::vulkan::instance &i,
 	NV_VULKAN_ERROR("vkGetPhysicalDeviceSurfacePresentModesKHR()", error)
 }
 
+bool nv::vulkan::surface::update(GLFWwindow *w, const nv::vulkan::physical_device &d, const uint32_t index)
+{
+	ASSERT(w != nullptr)
+	ASSERT(index < d.count())
+	ASSERT(this->handle != nullptr)
+
+	// NOTE: a resized window changes the surface capabilities (its current
+	// extent in particular), but never the formats or presentation modes.
+
+	VkResult error = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(d.handle[index], this->handle, &this->capabilities);
+	NV_VULKAN_ERROR("vkGetPhysicalDeviceSurfaceCapabilitiesKHR()", error)
+
+	if (this->capabilities.currentExtent.width != UINT32_MAX)
+		this->resolution = this->capabilities.currentExtent;
+	else
+	{
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(w, &width, &height);
+
+		this->resolution.width = std::max(this->capabilities.minImageExtent.width,
+		                         std::min(this->capabilities.maxImageExtent.width, static_cast<uint32_t>(width)));
+
+		this->resolution.height = std::max(this->capabilities.minImageExtent.height,
+		                          std::min(this->capabilities.maxImageExtent.height, static_cast<uint32_t>(height)));
+	}
+
+	// NOTE: a minimized window has no area to draw to.
+	return (this->resolution.width > 0) && (this->resolution.height > 0);
+}
+
 uint32_t nv::vulkan::surface::image_count() const
 {
 	// NOTE: this->capabilities.maxImageCount == 0 is a special case that represents "as many as needed".
@@ -462,6 +1013,13 @@ nv::vulkan::swapchain::swapchain():
 
 	this->reference.attachment = 0;
 	this->reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	this->info.pNext = nullptr;
+	this->info.pResults = nullptr;
+	this->info.swapchainCount = 1;
+	this->info.waitSemaphoreCount = 1;
+	this->info.pSwapchains = &this->handle;
+	this->info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 }
 
 void nv::vulkan::swapchain::create(const nv::vulkan::device &d,
@@ -485,9 +1043,44 @@ void nv::vulkan::swapchain::create(const nv::vulkan::device &d,
 	error = vkCreateSwapchainKHR(d.handle, &this->setup, nullptr, &this->handle);
 	NV_VULKAN_ERROR("vkCreateSwapchainKHR()", error)
 
+	// NOTE: an old swapchain (see nv::vulkan::retired_swapchain) is only handed
+	// over once, its destruction is up to the caller.
+	this->setup.oldSwapchain = VK_NULL_HANDLE;
+
 	this->attachment.format = this->setup.imageFormat;
 }
 
+VkResult nv::vulkan::swapchain::acquire(const nv::vulkan::device &d, VkSemaphore s, uint32_t &n)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(this->handle != nullptr)
+
+	const VkResult error = vkAcquireNextImageKHR(d.handle, this->handle, UINT64_MAX, s, VK_NULL_HANDLE, &n);
+
+	// NOTE: a suboptimal swapchain can still be presented to, whereas an out of
+	// date one must be recreated by the caller before any further use.
+	if ((error != VK_SUBOPTIMAL_KHR) && (error != VK_ERROR_OUT_OF_DATE_KHR))
+		NV_VULKAN_ERROR("vkAcquireNextImageKHR()", error)
+
+	return error;
+}
+
+VkResult nv::vulkan::swapchain::present(VkQueue q, VkSemaphore s, const uint32_t n)
+{
+	ASSERT(q != nullptr)
+	ASSERT(this->handle != nullptr)
+
+	this->info.pImageIndices = &n;
+	this->info.pWaitSemaphores = &s;
+
+	const VkResult error = vkQueuePresentKHR(q, &this->info);
+
+	if ((error != VK_SUBOPTIMAL_KHR) && (error != VK_ERROR_OUT_OF_DATE_KHR))
+		NV_VULKAN_ERROR("vkQueuePresentKHR()", error)
+
+	return error;
+}
+
 void nv::vulkan::swapchain::destroy(const nv::vulkan::device &d)
 {
 	if (this->handle == nullptr) return;
@@ -528,6 +1121,22 @@ nv::vulkan::image::image()
 	this->setup.subresourceRange.baseMipLevel = 0;
 	this->setup.subresourceRange.baseArrayLayer = 0;
 	this->setup.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	this->creation.flags = 0;
+	this->creation.mipLevels = 1;
+	this->creation.arrayLayers = 1;
+	this->creation.pNext = nullptr;
+	this->creation.queueFamilyIndexCount = 0;
+	this->creation.pQueueFamilyIndices = nullptr;
+	this->creation.imageType = VK_IMAGE_TYPE_2D;
+	this->creation.format = VK_FORMAT_UNDEFINED;
+	this->creation.extent = {0, 0, 1};
+	this->creation.usage = 0;
+	this->creation.samples = VK_SAMPLE_COUNT_1_BIT;
+	this->creation.tiling = VK_IMAGE_TILING_OPTIMAL;
+	this->creation.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	this->creation.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	this->creation.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 }
 
 void nv::vulkan::image::create(const nv::vulkan::device &d,
@@ -561,9 +1170,105 @@ void nv::vulkan::image::create(const nv::vulkan::device &d,
 	this->resolution = c.setup.imageExtent;
 }
 
+void nv::vulkan::image::create(const nv::vulkan::device &d, nv::vulkan::allocator &a,
+                               const VkExtent2D &extent, const VkFormat format, const uint32_t count,
+                               const VkImageUsageFlags usage)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(count > 0)
+
+	this->creation.format = format;
+	this->creation.usage = usage;
+	this->creation.extent = {extent.width, extent.height, 1};
+
+	this->handle.resize(count);
+	this->view.resize(count);
+	this->memory.resize(count);
+	this->setup.format = format;
+	this->setup.subresourceRange.aspectMask = nv::vulkan::image::aspect(format);
+
+	VkMemoryPropertyFlags preferred = 0;
+
+	if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		VkResult error = vkCreateImage(d.handle, &this->creation, nullptr, &this->handle[n]);
+		NV_VULKAN_ERROR("vkCreateImage()", error)
+
+		this->memory[n] = a.bind(d, this->handle[n], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, preferred);
+
+		this->setup.image = this->handle[n];
+
+		error = vkCreateImageView(d.handle, &this->setup, nullptr, &this->view[n]);
+		NV_VULKAN_ERROR("vkCreateImageView()", error)
+	}
+
+	this->resolution = extent;
+}
+
+void nv::vulkan::image::read(const nv::vulkan::command_buffer &cb, const uint32_t n,
+                             const uint32_t m, const nv::vulkan::buffer &b) const
+{
+	ASSERT(n < cb.handle.size())
+	ASSERT(m < this->handle.size())
+	ASSERT(b.handle != nullptr)
+
+	// NOTE: the image is expected in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i.e.
+	// the final layout of its render pass, with tightly packed texels.
+
+	VkMemoryBarrier barrier;
+
+	barrier.pNext = nullptr;
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(cb.handle[n], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	VkBufferImageCopy region;
+
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {this->resolution.width, this->resolution.height, 1};
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	vkCmdCopyImageToBuffer(cb.handle[n], this->handle[m], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, b.handle, 1, &region);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(cb.handle[n], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+	                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void nv::vulkan::image::destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a)
+{
+	ASSERT(d.handle != nullptr)
+
+	for (uint32_t n = 0; n < this->memory.size(); ++n)
+	{
+		vkDestroyImageView(d.handle, this->view[n], nullptr);
+		vkDestroyImage(d.handle, this->handle[n], nullptr);
+		a.release(d, this->memory[n]);
+	}
+
+	this->view.clear();
+	this->handle.clear();
+	this->memory.clear();
+}
+
 void nv::vulkan::image::destroy(const nv::vulkan::device &d)
 {
 	ASSERT(d.handle != nullptr)
+	ASSERT(this->memory.size() == 0)
 
 	for (uint32_t n = 0; n < this->view.size(); ++n)
 		vkDestroyImageView(d.handle, this->view[n], nullptr);
@@ -577,6 +1282,28 @@ uint32_t nv::vulkan::image::size() const
 	return this->view.size();
 }
 
+VkImageAspectFlags nv::vulkan::image::aspect(const VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
 nv::vulkan::image::~image()
 {
 	if (this->handle.size() > 0)
@@ -587,17 +1314,68 @@ nv::vulkan::image::~image()
 }
 
 //
-// nv::vulkan::shader_module
+// nv::vulkan::buffer
 //
 
-nv::vulkan::shader_module::shader_module()
+nv::vulkan::buffer::buffer():
+	handle(nullptr)
 {
+	this->setup.size = 0;
 	this->setup.flags = 0;
-	this->setup.codeSize = 0;
+	this->setup.usage = 0;
 	this->setup.pNext = nullptr;
-	this->setup.pCode = nullptr;
-	this->setup.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	this->setup.queueFamilyIndexCount = 0;
+	this->setup.pQueueFamilyIndices = nullptr;
+	this->setup.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	this->setup.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+	this->requirements.size = 0;
+	this->requirements.alignment = 0;
+	this->requirements.memoryTypeBits = 0;
+}
+
+void nv::vulkan::buffer::create(const nv::vulkan::device &d,
+                                const VkDeviceSize size,
+                                const VkBufferUsageFlags usage)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(size > 0)
 
+	this->setup.size = size;
+	this->setup.usage = usage;
+
+	const VkResult error = vkCreateBuffer(d.handle, &this->setup, nullptr, &this->handle);
+	NV_VULKAN_ERROR("vkCreateBuffer()", error)
+
+	// NOTE: the memory is bound later on by a nv::vulkan::allocator.
+	vkGetBufferMemoryRequirements(d.handle, this->handle, &this->requirements);
+}
+
+void nv::vulkan::buffer::destroy(const nv::vulkan::device &d)
+{
+	if (this->handle == nullptr) return;
+
+	ASSERT(d.handle != nullptr)
+
+	vkDestroyBuffer(d.handle, this->handle, nullptr);
+	this->handle = nullptr;
+}
+
+nv::vulkan::buffer::~buffer()
+{
+	if (this->handle != nullptr)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::buffer instance before calling nv::vulkan::buffer::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
+//
+// nv::vulkan::shader_module
+//
+
+nv::vulkan::shader_module::shader_module()
+{
 	this->info.flags = 0;
 	this->info.pNext = nullptr;
 	this->info.setLayoutCount = 0;
@@ -607,36 +1385,11 @@ nv::vulkan::shader_module::shader_module()
 	this->info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 
 	this->usage = VK_SHADER_STAGE_ALL_GRAPHICS;
-
-	this->constants.dataSize = 0;
-	this->constants.pData = nullptr;
-	this->constants.mapEntryCount = 0;
-	this->constants.pMapEntries = nullptr;
 }
 
 void nv::vulkan::shader_module::load(const std::string &filename)
 {
-	std::ifstream input(filename, std::ios::ate | std::ios::binary);
-
-	if (!input.is_open())
-	{
-		PRINT_ERROR("unable to open %s\n", filename.c_str())
-		return;
-	}
-
-	this->setup.codeSize = static_cast<size_t>(input.tellg());
-
-	ASSERT(this->setup.codeSize > 0)
-
-	this->spirv.resize(this->setup.codeSize);
-
-	input.seekg(0);
-
-	input.read(this->spirv.data(), this->setup.codeSize);
-
-	input.close();
-
-	this->setup.pCode = reinterpret_cast<const uint32_t*>(this->spirv.data());
+	this->code = nv::vulkan::spirv::map(filename);
 }
 
 void nv::vulkan::shader_module::for_vertex_stage()
@@ -667,9 +1420,9 @@ nv::vulkan::render_pass::render_pass()
 	this->setup.flags = 0;
 	this->setup.pNext = nullptr;
 	this->setup.subpassCount = 1;
-	this->setup.dependencyCount = 0;
-	this->setup.pDependencies = nullptr;
+	this->setup.dependencyCount = 1;
 	this->setup.pSubpasses = &this->info;
+	this->setup.pDependencies = &this->dependency;
 	this->setup.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 
 	// NOTE: a proper choice of attachment will be made by a given swapchain
@@ -693,24 +1446,46 @@ nv::vulkan::render_pass::render_pass()
 	this->info.colorAttachmentCount = 0;
 	this->info.pColorAttachments = nullptr;
 
+	// NOTE: the swapchain image is released by the presentation engine only
+	// when the acquire semaphore signals, which is waited on at the color
+	// output stage. The external dependency below makes the layout transition
+	// of the attachment wait for it as well.
+
+	this->dependency.dependencyFlags = 0;
+	this->dependency.srcAccessMask = 0;
+	this->dependency.dstSubpass = 0;
+	this->dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	this->dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	this->dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	this->dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	this->name = "render_pass";
+	this->scope = UINT32_MAX;
+
+	this->clear.color.float32[0] = 0.0f;
+	this->clear.color.float32[1] = 0.0f;
+	this->clear.color.float32[2] = 0.0f;
+	this->clear.color.float32[3] = 1.0f;
+
 	this->startup.pNext = nullptr;
-	this->startup.clearValueCount = 0;
+	this->startup.clearValueCount = 1;
 	this->startup.framebuffer = nullptr;
-	this->startup.pClearValues = nullptr;
-	this->startup.renderPass = this->handle;
+	this->startup.pClearValues = &this->clear;
+	this->startup.renderPass = nullptr;
 	this->startup.renderArea.offset.x = 0;
 	this->startup.renderArea.offset.y = 0;
 	this->startup.renderArea.extent.width = 0;
 	this->startup.renderArea.extent.height = 0;
 	this->startup.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 
-	// FIXME: this->startup.framebuffer shall be defined later and prior to any
-	// call to this->begin(). Likewise, this->startup.renderArea has not been
-	// defined yet.
+	// NOTE: this->startup.renderPass is defined by create() and
+	// this->startup.renderArea by the framebuffer creation. The framebuffer
+	// itself is chosen at every call to begin().
 }
 
 void nv::vulkan::render_pass::create(const nv::vulkan::device &d,
-                                     const nv::vulkan::swapchain &c)
+                                     const nv::vulkan::swapchain &c,
+                                     const VkFormat depth)
 {
 	ASSERT(d.handle != nullptr)
 	ASSERT(c.handle != nullptr)
@@ -721,10 +1496,146 @@ void nv::vulkan::render_pass::create(const nv::vulkan::device &d,
 	this->info.colorAttachmentCount = 1;
 	this->info.pColorAttachments = &c.reference;
 
+	if (depth != VK_FORMAT_UNDEFINED) this->use_depth(c.attachment, depth);
+
 	VkResult error = vkCreateRenderPass(d.handle, &this->setup, nullptr, &this->handle);
 	NV_VULKAN_ERROR("vkCreateRenderPass()", error)
 
 	ASSERT(this->handle != VK_NULL_HANDLE)
+
+	this->startup.renderPass = this->handle;
+}
+
+void nv::vulkan::render_pass::create(const nv::vulkan::device &d,
+                                     const VkFormat format,
+                                     const VkImageLayout layout,
+                                     const VkFormat depth)
+{
+	ASSERT(d.handle != nullptr)
+
+	// NOTE: the same single color attachment of a swapchain, but of any format
+	// and final layout, e.g. for offscreen images that are read back.
+
+	this->attachment.flags = 0;
+	this->attachment.format = format;
+	this->attachment.finalLayout = layout;
+	this->attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	this->attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	this->attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	this->attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	this->attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	this->attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+	this->reference.attachment = 0;
+	this->reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	this->setup.attachmentCount = 1;
+	this->setup.pAttachments = &this->attachment;
+
+	this->info.colorAttachmentCount = 1;
+	this->info.pColorAttachments = &this->reference;
+
+	if (depth != VK_FORMAT_UNDEFINED) this->use_depth(this->attachment, depth);
+
+	VkResult error = vkCreateRenderPass(d.handle, &this->setup, nullptr, &this->handle);
+	NV_VULKAN_ERROR("vkCreateRenderPass()", error)
+
+	this->startup.renderPass = this->handle;
+}
+
+void nv::vulkan::render_pass::create(const nv::vulkan::device &d,
+                                     const std::vector<VkAttachmentDescription> &attachment,
+                                     const uint32_t color_count)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(attachment.size() > 0)
+	ASSERT((attachment.size() == color_count) || (attachment.size() == color_count + 1))
+
+	this->attachments = attachment;
+	this->references.resize(attachment.size());
+
+	for (uint32_t n = 0; n < attachment.size(); ++n)
+	{
+		this->references[n].attachment = n;
+		this->references[n].layout = attachment[n].initialLayout;
+	}
+
+	this->setup.attachmentCount = this->attachments.size();
+	this->setup.pAttachments = this->attachments.data();
+	this->setup.dependencyCount = 0;
+	this->setup.pDependencies = nullptr;
+
+	this->info.colorAttachmentCount = color_count;
+	this->info.pColorAttachments = (color_count > 0)? this->references.data() : nullptr;
+	this->info.pDepthStencilAttachment = (attachment.size() > color_count)? &this->references[color_count] : nullptr;
+
+	VkResult error = vkCreateRenderPass(d.handle, &this->setup, nullptr, &this->handle);
+	NV_VULKAN_ERROR("vkCreateRenderPass()", error)
+
+	// NOTE: clear values are only read for the attachments cleared, but one is
+	// needed for every attachment up to the last one cleared.
+
+	this->clears.resize(attachment.size(), this->clear);
+	this->startup.clearValueCount = this->clears.size();
+	this->startup.pClearValues = this->clears.data();
+	this->startup.renderPass = this->handle;
+}
+
+void nv::vulkan::render_pass::use_depth(const VkAttachmentDescription &color, const VkFormat depth)
+{
+	// NOTE: the depth of a frame is only needed during its render pass, thus
+	// it is cleared rather than loaded and never stored, tile-based GPUs keeping
+	// it on chip. The stencil aspect, if any, is the same.
+
+	const bool stencil = (nv::vulkan::image::aspect(depth) & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+	this->attachments.resize(2);
+	this->attachments[0] = color;
+
+	auto &e = this->attachments[1];
+
+	e.flags = 0;
+	e.format = depth;
+	e.samples = VK_SAMPLE_COUNT_1_BIT;
+	e.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	e.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	e.stencilLoadOp = stencil? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	e.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	e.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	e.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	this->references.resize(2);
+	this->references[0].attachment = 0;
+	this->references[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	this->references[1].attachment = 1;
+	this->references[1].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	this->setup.attachmentCount = 2;
+	this->setup.pAttachments = this->attachments.data();
+
+	this->info.colorAttachmentCount = 1;
+	this->info.pColorAttachments = &this->references[0];
+	this->info.pDepthStencilAttachment = &this->references[1];
+
+	// NOTE: a single depth image serves every frame, thus the clear of a frame
+	// waits for the depth tests of the one before.
+
+	this->dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	this->dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	this->dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	this->dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	VkClearValue far;
+
+	far.depthStencil.depth = 1.0f;
+	far.depthStencil.stencil = 0;
+
+	this->clears.resize(2);
+	this->clears[0] = this->clear;
+	this->clears[1] = far;
+
+	this->startup.clearValueCount = 2;
+	this->startup.pClearValues = this->clears.data();
 }
 
 void nv::vulkan::render_pass::begin(nv::vulkan::command_buffer &cb,
@@ -740,6 +1651,28 @@ void nv::vulkan::render_pass::begin(nv::vulkan::command_buffer &cb,
 	}
 }
 
+void nv::vulkan::render_pass::begin(nv::vulkan::command_buffer &cb, const uint32_t n,
+                                    const nv::vulkan::framebuffer &fb, const uint32_t m,
+                                    const VkSubpassContents contents,
+                                    nv::vulkan::profiler *p)
+{
+	ASSERT(n < cb.handle.size())
+	ASSERT(m < fb.handle.size())
+
+	cb.begin(n);
+
+	this->scope = UINT32_MAX;
+
+	if (p != nullptr)
+	{
+		p->reset(cb, n);
+		this->scope = p->begin(cb, n, this->name);
+	}
+
+	this->startup.framebuffer = fb.handle[m];
+	vkCmdBeginRenderPass(cb.handle[n], &this->startup, contents);
+}
+
 void nv::vulkan::render_pass::end(nv::vulkan::command_buffer &cb)
 {
 	for (uint32_t n = 0; n < cb.handle.size(); ++n)
@@ -749,6 +1682,18 @@ void nv::vulkan::render_pass::end(nv::vulkan::command_buffer &cb)
 	}
 }
 
+void nv::vulkan::render_pass::end(nv::vulkan::command_buffer &cb, const uint32_t n,
+                                  nv::vulkan::profiler *p)
+{
+	ASSERT(n < cb.handle.size())
+
+	vkCmdEndRenderPass(cb.handle[n]);
+
+	if (p != nullptr) p->end(cb, n, this->scope);
+
+	cb.end(n);
+}
+
 void nv::vulkan::render_pass::destroy(const nv::vulkan::device &d)
 {
 	if (this->handle == nullptr) return;
@@ -786,7 +1731,8 @@ nv::vulkan::framebuffer::framebuffer()
 
 void nv::vulkan::framebuffer::create(const nv::vulkan::device &d,
                                      const nv::vulkan::image &i,
-                                     nv::vulkan::render_pass &p)
+                                     nv::vulkan::render_pass &p,
+                                     VkImageView depth)
 {
 	ASSERT(d.handle != nullptr)
 	ASSERT(p.handle != nullptr)
@@ -797,13 +1743,17 @@ void nv::vulkan::framebuffer::create(const nv::vulkan::device &d,
 
 	this->handle.resize(view_count);
 
+	VkImageView views[2] = {VK_NULL_HANDLE, depth};
+
+	this->setup.attachmentCount = (depth != VK_NULL_HANDLE)? 2 : 1;
 	this->setup.renderPass = p.handle;
 	this->setup.width = i.resolution.width;
 	this->setup.height = i.resolution.height;
+	this->setup.pAttachments = views;
 
 	for (uint32_t n = 0; n < view_count; ++n)
 	{
-		this->setup.pAttachments = &i.view[n];
+		views[0] = i.view[n];
 
 		ASSERT(this->setup.pAttachments != nullptr)
 
@@ -811,8 +1761,34 @@ void nv::vulkan::framebuffer::create(const nv::vulkan::device &d,
 		NV_VULKAN_ERROR("vkCreateFramebuffer()", error)
 	}
 
-	// FIXME: using the 1st framebuffer for the render pass for now.
-//	p.startup.framebuffer = this->handle[0];
+	// NOTE: all framebuffers share the same extent, which is the area drawn by
+	// the render pass. Which framebuffer to use is decided at p.begin().
+	p.startup.renderArea.extent = i.resolution;
+}
+
+void nv::vulkan::framebuffer::create(const nv::vulkan::device &d,
+                                     nv::vulkan::render_pass &p,
+                                     const VkImageView *views, const uint32_t count,
+                                     const VkExtent2D &extent)
+{
+	ASSERT(d.handle != nullptr)
+	ASSERT(p.handle != nullptr)
+	ASSERT(views != nullptr)
+	ASSERT(count > 0)
+
+	this->setup.renderPass = p.handle;
+	this->setup.width = extent.width;
+	this->setup.height = extent.height;
+	this->setup.attachmentCount = count;
+	this->setup.pAttachments = views;
+
+	VkFramebuffer f = VK_NULL_HANDLE;
+
+	VkResult error = vkCreateFramebuffer(d.handle, &this->setup, nullptr, &f);
+	NV_VULKAN_ERROR("vkCreateFramebuffer()", error)
+
+	this->handle.push_back(f);
+	p.startup.renderArea.extent = extent;
 }
 
 uint32_t nv::vulkan::framebuffer::size() const
@@ -839,6 +1815,63 @@ nv::vulkan::framebuffer::~framebuffer()
 	}
 }
 
+//
+// nv::vulkan::retired_swapchain
+//
+
+nv::vulkan::retired_swapchain::retired_swapchain():
+	handle(nullptr)
+{
+}
+
+void nv::vulkan::retired_swapchain::take(nv::vulkan::swapchain &c,
+                                         nv::vulkan::image &i,
+                                         nv::vulkan::framebuffer &f)
+{
+	ASSERT(this->handle == nullptr)
+	ASSERT(c.handle != nullptr)
+
+	// NOTE: the next c.create() passes the old handle as its oldSwapchain.
+
+	this->handle = c.handle;
+	c.setup.oldSwapchain = c.handle;
+	c.handle = nullptr;
+
+	this->view.swap(i.view);
+	this->frame.swap(f.handle);
+
+	i.view.clear();
+	i.handle.clear();
+	f.handle.clear();
+}
+
+void nv::vulkan::retired_swapchain::destroy(const nv::vulkan::device &d)
+{
+	ASSERT(d.handle != nullptr)
+
+	for (uint32_t n = 0; n < this->frame.size(); ++n)
+		vkDestroyFramebuffer(d.handle, this->frame[n], nullptr);
+
+	for (uint32_t n = 0; n < this->view.size(); ++n)
+		vkDestroyImageView(d.handle, this->view[n], nullptr);
+
+	if (this->handle != nullptr)
+		vkDestroySwapchainKHR(d.handle, this->handle, nullptr);
+
+	this->handle = nullptr;
+	this->view.clear();
+	this->frame.clear();
+}
+
+nv::vulkan::retired_swapchain::~retired_swapchain()
+{
+	if (this->handle != nullptr)
+	{
+		PRINT_ERROR("%s\n", "error: end of scope for a nv::vulkan::retired_swapchain instance before calling nv::vulkan::retired_swapchain::destroy()")
+		exit(EXIT_FAILURE);
+	}
+}
+
 //
 // nv::vulkan::viewport
 //
@@ -979,7 +2012,8 @@ nv::vulkan::depth_stencil::~depth_stencil()
 //
 
 nv::vulkan::layout::layout():
-	handle(nullptr)
+	handle(nullptr),
+	shared(false)
 {
 	this->setup.flags = 0;
 	this->setup.pNext = nullptr;
@@ -990,6 +2024,26 @@ nv::vulkan::layout::layout():
 	this->setup.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 }
 
+void nv::vulkan::layout::add(VkDescriptorSetLayout l)
+{
+	ASSERT(this->handle == nullptr)
+
+	this->sets.push_back(l);
+	this->setup.setLayoutCount = this->sets.size();
+	this->setup.pSetLayouts = this->sets.data();
+}
+
+void nv::vulkan::layout::add(const VkShaderStageFlags stages, const uint32_t offset, const uint32_t size)
+{
+	ASSERT(this->handle == nullptr)
+	ASSERT((offset % 4) == 0)
+	ASSERT((size % 4) == 0)
+
+	this->ranges.push_back({stages, offset, size});
+	this->setup.pushConstantRangeCount = this->ranges.size();
+	this->setup.pPushConstantRanges = this->ranges.data();
+}
+
 void nv::vulkan::layout::create(const nv::vulkan::device &d)
 {
 	ASSERT(d.handle != nullptr)
@@ -998,14 +2052,34 @@ void nv::vulkan::layout::create(const nv::vulkan::device &d)
 	NV_VULKAN_ERROR("vkCreatePipelineLayout()", error)
 }
 
+void nv::vulkan::layout::share(VkPipelineLayout l)
+{
+	ASSERT(this->handle == nullptr)
+	ASSERT(l != nullptr)
+
+	this->handle = l;
+	this->shared = true;
+}
+
 void nv::vulkan::layout::destroy(const nv::vulkan::device &d)
 {
 	if (this->handle == nullptr) return;
 
 	ASSERT(d.handle != nullptr)
 
-	vkDestroyPipelineLayout(d.handle, this->handle, nullptr);
+	if (!this->shared) vkDestroyPipelineLayout(d.handle, this->handle, nullptr);
+
 	this->handle = nullptr;
+	this->shared = false;
+
+	// NOTE: the set layouts belong to the cache they come from, and both are
+	// added again by the next creation.
+	this->sets.clear();
+	this->ranges.clear();
+	this->setup.setLayoutCount = 0;
+	this->setup.pSetLayouts = nullptr;
+	this->setup.pushConstantRangeCount = 0;
+	this->setup.pPushConstantRanges = nullptr;
 }
 
 nv::vulkan::layout::~layout()
@@ -1017,6 +2091,21 @@ nv::vulkan::layout::~layout()
 	}
 }
 
+//
+// nv::vulkan::draw_state
+//
+
+bool nv::vulkan::draw_state::operator ==(const draw_state &other) const
+{
+	return (this->cull_mode == other.cull_mode) && (this->front_face == other.front_face)
+	    && (this->topology == other.topology)
+	    && (this->depth_test == other.depth_test) && (this->depth_write == other.depth_write)
+	    && (this->depth_compare == other.depth_compare)
+	    && (this->primitive_restart == other.primitive_restart)
+	    && (this->attachment_count == other.attachment_count)
+	    && std::equal(this->blend, this->blend + this->attachment_count, other.blend);
+}
+
 //
 // nv::vulkan::pipeline
 //
@@ -1058,6 +2147,19 @@ nv::vulkan::pipeline::pipeline():
 	this->assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	this->assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 
+	this->dynamic.flags = 0;
+	this->dynamic.pNext = nullptr;
+	this->dynamic.dynamicStateCount = 0;
+	this->dynamic.pDynamicStates = nullptr;
+	this->dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+
+	this->compute.flags = 0;
+	this->compute.pNext = nullptr;
+	this->compute.layout = nullptr;
+	this->compute.basePipelineIndex = -1;
+	this->compute.basePipelineHandle = VK_NULL_HANDLE;
+	this->compute.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+
 	this->usage = VK_PIPELINE_BIND_POINT_GRAPHICS;
 }
 
@@ -1069,16 +2171,25 @@ void nv::vulkan::pipeline::add(const nv::vulkan::shader_module &s)
 	shader.pName = "main";
 	shader.pNext = nullptr;
 	shader.stage = s.usage;
-	shader.module = s.handle;
+	shader.module = VK_NULL_HANDLE;
 	shader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 
-	if (s.constants.mapEntryCount > 0)
-		shader.pSpecializationInfo = &s.constants;
-	else
-		shader.pSpecializationInfo = nullptr;
+	// NOTE: the constants are copied, and pointed to by prepare().
+	shader.pSpecializationInfo = nullptr;
+
+	ASSERT(s.code != nullptr)
 
 	this->stage.push_back(shader);
+	this->constants.push_back(s.constants);
+	this->code.push_back(s.code);
 	this->setup.stageCount += 1;
+
+	// NOTE: a compute shader makes a compute pipeline, with no other stage.
+
+	if (s.usage == VK_SHADER_STAGE_COMPUTE_BIT)
+		this->usage = VK_PIPELINE_BIND_POINT_COMPUTE;
+
+	ASSERT((this->usage != VK_PIPELINE_BIND_POINT_COMPUTE) || (this->stage.size() == 1))
 }
 
 void nv::vulkan::pipeline::add(const nv::vulkan::render_pass &p)
@@ -1115,33 +2226,375 @@ void nv::vulkan::pipeline::add(const nv::vulkan::depth_stencil &s)
 	this->setup.pDepthStencilState = &s.setup;
 }
 
+void nv::vulkan::pipeline::add(const VkVertexInputBindingDescription *binding, const uint32_t binding_count,
+                               const VkVertexInputAttributeDescription *attribute, const uint32_t attribute_count)
+{
+	ASSERT(this->handle == nullptr)
+
+	const uint32_t first_binding = this->bindings.size();
+	uint32_t first_location = 0;
+
+	for (const auto &a : this->attributes)
+		first_location = std::max(first_location, a.location + locations(a.format));
+
+	for (uint32_t n = 0; n < binding_count; ++n)
+	{
+		this->bindings.push_back(binding[n]);
+		this->bindings.back().binding += first_binding;
+	}
+
+	for (uint32_t n = 0; n < attribute_count; ++n)
+	{
+		this->attributes.push_back(attribute[n]);
+		this->attributes.back().binding += first_binding;
+		this->attributes.back().location += first_location;
+	}
+
+	this->input.vertexBindingDescriptionCount = this->bindings.size();
+	this->input.pVertexBindingDescriptions = this->bindings.data();
+	this->input.vertexAttributeDescriptionCount = this->attributes.size();
+	this->input.pVertexAttributeDescriptions = this->attributes.data();
+}
+
 void nv::vulkan::pipeline::add(const nv::vulkan::layout &l)
 {
 	this->setup.layout = l.handle;
 }
 
+void nv::vulkan::pipeline::use_dynamic_state(const nv::vulkan::device &d)
+{
+	// NOTE: viewport and scissor are always dynamic, thus pipelines outlive a
+	// resize. The remaining states are dynamic when the device supports them,
+	// otherwise their values at creation are baked into the pipeline.
+
+	this->state = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	if (d.dynamic_state.extendedDynamicState)
+	{
+		this->state.push_back(VK_DYNAMIC_STATE_CULL_MODE);
+		this->state.push_back(VK_DYNAMIC_STATE_FRONT_FACE);
+		this->state.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+		this->state.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE);
+		this->state.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE);
+		this->state.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP);
+	}
+
+	if (d.dynamic_state2.extendedDynamicState2)
+		this->state.push_back(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE);
+
+	if (d.dynamic_state3.extendedDynamicState3ColorBlendEnable)
+		this->state.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+
+	this->dynamic.dynamicStateCount = this->state.size();
+	this->dynamic.pDynamicStates = this->state.data();
+	this->setup.pDynamicState = &this->dynamic;
+}
+
 void nv::vulkan::pipeline::create(const nv::vulkan::device &d)
 {
 	ASSERT(d.handle != nullptr)
 
-	VkResult error = vkCreateGraphicsPipelines(d.handle, this->cache, 1, &this->setup, nullptr, &this->handle);
-	NV_VULKAN_ERROR("vkCreateGraphicsPipelines()", error)
+	ASSERT(this->handle == nullptr)
+
+	this->prepare();
+
+	if (this->is_compute())
+	{
+		VkResult error = vkCreateComputePipelines(d.handle, this->cache, 1, &this->compute, nullptr, &this->handle);
+		NV_VULKAN_ERROR("vkCreateComputePipelines()", error)
+	}
+	else
+	{
+		VkResult error = vkCreateGraphicsPipelines(d.handle, this->cache, 1, &this->setup, nullptr, &this->handle);
+		NV_VULKAN_ERROR("vkCreateGraphicsPipelines()", error)
+	}
+
+	this->store_variant();
 }
 
-void nv::vulkan::pipeline::bind(const nv::vulkan::command_buffer &cb, const uint32_t n)
+void nv::vulkan::pipeline::prepare()
+{
+	// NOTE: this->stage (and the constants) may have been reallocated by add()
+	// since construction, and a copy still points to the state of the original.
+
+	for (size_t n = 0; n < this->stage.size(); ++n)
+	{
+		ASSERT(this->stage[n].module != VK_NULL_HANDLE)
+
+		this->stage[n].pSpecializationInfo = this->constants[n].info();
+	}
+
+	this->setup.pStages = this->stage.data();
+	this->setup.pVertexInputState = &this->input;
+	this->setup.pInputAssemblyState = &this->assembly;
+
+	this->input.pVertexBindingDescriptions = this->bindings.data();
+	this->input.pVertexAttributeDescriptions = this->attributes.data();
+
+	if (this->setup.pDynamicState != nullptr)
+	{
+		this->dynamic.pDynamicStates = this->state.data();
+		this->setup.pDynamicState = &this->dynamic;
+	}
+
+	if (this->is_compute())
+	{
+		this->compute.stage = this->stage[0];
+		this->compute.layout = this->setup.layout;
+	}
+}
+
+void nv::vulkan::pipeline::acquire(const nv::vulkan::device &d, nv::vulkan::module_cache &c)
+{
+	for (size_t n = 0; n < this->stage.size(); ++n)
+		if (this->stage[n].module == VK_NULL_HANDLE)
+			this->stage[n].module = c.acquire(d, *this->code[n]);
+}
+
+void nv::vulkan::pipeline::release(const nv::vulkan::device &d, nv::vulkan::module_cache &c)
+{
+	for (auto &s : this->stage)
+	{
+		c.release(d, s.module);
+		s.module = VK_NULL_HANDLE;
+	}
+}
+
+static uint64_t variant_hash(const std::vector<nv::vulkan::specialization> &constants)
+{
+	uint64_t h = 0;
+
+	for (const auto &c : constants)
+		h = h*31 + c.hash();
+
+	return h;
+}
+
+void nv::vulkan::pipeline::specialize(const uint32_t n, const nv::vulkan::specialization &s)
+{
+	ASSERT(n < this->constants.size())
+
+	this->constants[n] = s;
+	this->handle = nullptr;
+
+	const uint64_t h = variant_hash(this->constants);
+
+	for (const auto &v : this->variants)
+	{
+		if ((v.hash == h) && (v.constants == this->constants))
+		{
+			this->handle = v.handle;
+			return;
+		}
+	}
+}
+
+void nv::vulkan::pipeline::replace(nv::vulkan::pipeline &rebuilt, std::vector<VkPipeline> &old)
+{
+	ASSERT(rebuilt.stage.size() == this->stage.size())
+	ASSERT(rebuilt.usage == this->usage)
+
+	for (const auto &v : this->variants)
+		old.push_back(v.handle);
+
+	this->variants.swap(rebuilt.variants);
+	this->code.swap(rebuilt.code);
+	rebuilt.variants.clear();
+	rebuilt.handle = nullptr;
+
+	for (size_t n = 0; n < this->stage.size(); ++n)
+	{
+		ASSERT(this->stage[n].module == VK_NULL_HANDLE)
+
+		this->stage[n].module = rebuilt.stage[n].module;
+		rebuilt.stage[n].module = VK_NULL_HANDLE;
+	}
+
+	this->setup.layout = rebuilt.setup.layout;
+	this->compute.layout = rebuilt.setup.layout;
+
+	// NOTE: the vertex inputs as well, used by the variants created later.
+
+	this->bindings.swap(rebuilt.bindings);
+	this->attributes.swap(rebuilt.attributes);
+	this->input.vertexBindingDescriptionCount = this->bindings.size();
+	this->input.pVertexBindingDescriptions = this->bindings.data();
+	this->input.vertexAttributeDescriptionCount = this->attributes.size();
+	this->input.pVertexAttributeDescriptions = this->attributes.data();
+
+	// NOTE: the constants may have changed since the copy was made.
+
+	this->handle = nullptr;
+
+	const uint64_t h = variant_hash(this->constants);
+
+	for (const auto &v : this->variants)
+	{
+		if ((v.hash == h) && (v.constants == this->constants))
+		{
+			this->handle = v.handle;
+			return;
+		}
+	}
+}
+
+uint32_t nv::vulkan::pipeline::variant_count() const
+{
+	return this->variants.size();
+}
+
+void nv::vulkan::pipeline::store_variant()
+{
+	ASSERT(this->handle != nullptr)
+
+	variant v;
+
+	v.hash = variant_hash(this->constants);
+	v.constants = this->constants;
+	v.handle = this->handle;
+
+	this->variants.push_back(v);
+}
+
+bool nv::vulkan::pipeline::is_compute() const
+{
+	return this->usage == VK_PIPELINE_BIND_POINT_COMPUTE;
+}
+
+void nv::vulkan::pipeline::bind(const nv::vulkan::command_buffer &cb, const uint32_t n) const
 {
 	ASSERT(n < cb.handle.size())
 
 	vkCmdBindPipeline(cb.handle[n], this->usage, this->handle);
 }
 
+void nv::vulkan::pipeline::bind(const nv::vulkan::command_buffer &cb, const uint32_t n, VkPipeline variant) const
+{
+	ASSERT(n < cb.handle.size())
+	ASSERT(variant != nullptr)
+
+	vkCmdBindPipeline(cb.handle[n], this->usage, variant);
+}
+
+void nv::vulkan::pipeline::bind(const nv::vulkan::command_buffer &cb, const uint32_t n,
+                                const VkDescriptorSet *sets, const uint32_t count,
+                                const uint32_t *offsets, const uint32_t offset_count) const
+{
+	ASSERT(n < cb.handle.size())
+	ASSERT(this->setup.layout != nullptr)
+
+	if (count == 0) return;
+
+	// NOTE: one offset per dynamic descriptor of the sets, in binding order.
+	vkCmdBindDescriptorSets(cb.handle[n], this->usage, this->setup.layout, 0, count, sets, offset_count, offsets);
+}
+
+void nv::vulkan::pipeline::push(const nv::vulkan::command_buffer &cb, const uint32_t n,
+                                const VkShaderStageFlags stages, const uint32_t offset,
+                                const uint32_t size, const void *data) const
+{
+	ASSERT(n < cb.handle.size())
+	ASSERT(this->setup.layout != nullptr)
+
+	vkCmdPushConstants(cb.handle[n], this->setup.layout, stages, offset, size, data);
+}
+
+nv::vulkan::draw_state nv::vulkan::pipeline::capture() const
+{
+	const auto *raster = this->setup.pRasterizationState;
+	const auto *depth = this->setup.pDepthStencilState;
+	const auto *blend = this->setup.pColorBlendState;
+
+	ASSERT(blend->attachmentCount <= 8)
+
+	nv::vulkan::draw_state s;
+
+	s.cull_mode = raster->cullMode;
+	s.front_face = raster->frontFace;
+	s.topology = this->assembly.topology;
+	s.depth_test = depth->depthTestEnable;
+	s.depth_write = depth->depthWriteEnable;
+	s.depth_compare = depth->depthCompareOp;
+	s.primitive_restart = this->assembly.primitiveRestartEnable;
+	s.attachment_count = blend->attachmentCount;
+
+	for (uint32_t k = 0; k < 8; ++k)
+		s.blend[k] = (k < blend->attachmentCount)? blend->pAttachments[k].blendEnable : VK_FALSE;
+
+	return s;
+}
+
+void nv::vulkan::pipeline::apply(const nv::vulkan::device &d,
+                                 const nv::vulkan::command_buffer &cb, const uint32_t n,
+                                 const VkViewport &v, const VkRect2D &scissor,
+                                 const nv::vulkan::draw_state &s) const
+{
+	ASSERT(n < cb.handle.size())
+
+	VkCommandBuffer target = cb.handle[n];
+
+	for (const auto state : this->state)
+	{
+		switch (state)
+		{
+			case VK_DYNAMIC_STATE_VIEWPORT:
+				vkCmdSetViewport(target, 0, 1, &v);
+				break;
+
+			case VK_DYNAMIC_STATE_SCISSOR:
+				vkCmdSetScissor(target, 0, 1, &scissor);
+				break;
+
+			case VK_DYNAMIC_STATE_CULL_MODE:
+				d.set_cull_mode(target, s.cull_mode);
+				break;
+
+			case VK_DYNAMIC_STATE_FRONT_FACE:
+				d.set_front_face(target, s.front_face);
+				break;
+
+			case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+				d.set_topology(target, s.topology);
+				break;
+
+			case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+				d.set_depth_test(target, s.depth_test);
+				break;
+
+			case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+				d.set_depth_write(target, s.depth_write);
+				break;
+
+			case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP:
+				d.set_depth_compare(target, s.depth_compare);
+				break;
+
+			case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+				d.set_primitive_restart(target, s.primitive_restart);
+				break;
+
+			case VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT:
+				d.set_blend_enable(target, 0, s.attachment_count, s.blend);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
 void nv::vulkan::pipeline::destroy(const nv::vulkan::device &d)
 {
-	if (this->handle == nullptr) return;
+	if (this->variants.size() == 0) return;
 
 	ASSERT(d.handle != nullptr)
 
-	vkDestroyPipeline(d.handle, this->handle, nullptr);
+	// NOTE: the pipeline handle is one of the variants, if not null.
+
+	for (const auto &v : this->variants)
+		vkDestroyPipeline(d.handle, v.handle, nullptr);
+
+	this->variants.clear();
 	this->handle = nullptr;
 }
 
@@ -5,10 +5,21 @@
 	#include <vector>
 	#include <string>
 
+	#include "specialization.hpp"
+	#include "module.hpp"
+
 	namespace nv
 	{
 		namespace vulkan
 		{
+			enum queue_usage
+			{
+				NV_QUEUE_GRAPHICS,
+				NV_QUEUE_COMPUTE,
+				NV_QUEUE_TRANSFER,
+				NV_QUEUE_USAGE_COUNT
+			};
+
 			struct instance
 			{
 				instance();
@@ -32,6 +43,10 @@
 
 				uint32_t count() const;
 
+				// NOTE: the most precise format usable as a depth attachment with
+				// optimal tiling, with a stencil aspect if asked for.
+				VkFormat depth_format(const uint32_t index, const bool stencil = false) const;
+
 				~physical_device();
 
 				std::vector<VkPhysicalDevice> handle;
@@ -45,6 +60,8 @@
 
 				void create(const nv::vulkan::physical_device &d, const uint32_t index);
 
+				bool has_extension(const char *name) const;
+
 				void destroy();
 
 				~device();
@@ -52,15 +69,47 @@
 				VkDevice handle;
 				VkDeviceCreateInfo setup;
 				std::vector<float> priority;
-				VkDeviceQueueCreateInfo info;
+				std::vector<VkDeviceQueueCreateInfo> info;
 				std::vector<VkQueueFamilyProperties> family;
+
+				// NOTE: the queue family and the queue within it used for each kind of
+				// work. The graphics family is chosen by the caller prior to create().
+				uint32_t family_index[NV_QUEUE_USAGE_COUNT];
+				uint32_t queue_index[NV_QUEUE_USAGE_COUNT];
+
+				// NOTE: extensions reported by the physical device and the ones enabled.
+				std::vector<VkExtensionProperties> available;
+				std::vector<const char*> extension;
+
+				// NOTE: features enabled by create(), i.e. the ones of
+				// VK_EXT_extended_dynamic_state, 2 and 3 (color blend enable only),
+				// multi-draw indirect, draw parameters and draw indirect count, if
+				// supported. The entry points are null otherwise.
+				VkPhysicalDeviceFeatures2 features;
+				VkPhysicalDeviceVulkan11Features vulkan11;
+				VkPhysicalDeviceVulkan12Features vulkan12;
+				VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamic_state;
+				VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamic_state2;
+				VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_state3;
+
+				PFN_vkCmdSetCullModeEXT set_cull_mode;
+				PFN_vkCmdSetFrontFaceEXT set_front_face;
+				PFN_vkCmdSetPrimitiveTopologyEXT set_topology;
+				PFN_vkCmdSetDepthTestEnableEXT set_depth_test;
+				PFN_vkCmdSetDepthWriteEnableEXT set_depth_write;
+				PFN_vkCmdSetDepthCompareOpEXT set_depth_compare;
+				PFN_vkCmdSetPrimitiveRestartEnableEXT set_primitive_restart;
+				PFN_vkCmdSetColorBlendEnableEXT set_blend_enable;
+				PFN_vkCmdDrawIndexedIndirectCount draw_indexed_indirect_count;
 			};
 
 			struct command_pool
 			{
 				command_pool();
 
-				void create(const nv::vulkan::device &d);
+				void create(const nv::vulkan::device &d, const queue_usage u = NV_QUEUE_GRAPHICS);
+
+				void reset(const nv::vulkan::device &d);
 
 				void destroy(const nv::vulkan::device &d);
 
@@ -79,16 +128,61 @@
 				              const nv::vulkan::command_pool &p,
 				              const uint32_t n = 1);
 
+				void free(const nv::vulkan::device &d, const nv::vulkan::command_pool &p);
+
 				uint32_t size();
 
 				void begin(const uint32_t n);
 
+				void begin(const uint32_t n, VkRenderPass p, VkFramebuffer f);
+
 				void end(const uint32_t n);
 
+				void execute(const uint32_t n, const std::vector<VkCommandBuffer> &list);
+
+				void draw(const uint32_t n, const uint32_t vertex_count, const uint32_t instance_count = 1);
+
+				void draw_indexed(const uint32_t n, const uint32_t index_count, const uint32_t instance_count = 1,
+				                  const uint32_t first_index = 0, const int32_t vertex_offset = 0);
+
+				// NOTE: one draw per command without multiDrawIndirect.
+				void draw_indexed_indirect(const nv::vulkan::device &d, const uint32_t n,
+				                           VkBuffer b, const VkDeviceSize offset, const uint32_t count);
+
+				void draw_indexed_indirect_count(const nv::vulkan::device &d, const uint32_t n,
+				                                 VkBuffer b, const VkDeviceSize offset,
+				                                 VkBuffer counter, const VkDeviceSize counter_offset,
+				                                 const uint32_t max_count);
+
+				void bind_vertices(const uint32_t n, const VkBuffer *buffers, const VkDeviceSize *offsets,
+				                   const uint32_t count);
+
+				void bind_indices(const uint32_t n, VkBuffer b, const VkDeviceSize offset, const VkIndexType type);
+
+				void dispatch(const uint32_t n, const uint32_t x, const uint32_t y = 1, const uint32_t z = 1);
+
+				void dispatch_indirect(const uint32_t n, VkBuffer b, const VkDeviceSize offset = 0);
+
+				// NOTE: a global memory barrier, which covers every resource at once.
+				void barrier(const uint32_t n, const VkPipelineStageFlags from, const VkPipelineStageFlags to,
+				             const VkAccessFlags from_access, const VkAccessFlags to_access);
+
+				void barrier(const uint32_t n, const VkPipelineStageFlags from, const VkPipelineStageFlags to,
+				             const VkBufferMemoryBarrier *buffers, const uint32_t buffer_count,
+				             const VkImageMemoryBarrier *images, const uint32_t image_count);
+
+				// NOTE: at most 2 command buffers run first.
+				void submit(const uint32_t n, VkQueue q, VkSemaphore wait, VkSemaphore signal, VkFence f,
+				            const VkCommandBuffer *first = nullptr, const uint32_t first_count = 0,
+				            VkCommandBuffer last = VK_NULL_HANDLE);
+
 				~command_buffer();
 
 				std::vector<VkCommandBuffer> handle;
+				VkSubmitInfo info;
+				VkPipelineStageFlags stage;
 				VkCommandBufferAllocateInfo setup;
+				VkCommandBufferInheritanceInfo inheritance;
 				VkCommandBufferBeginInfo startup;
 			};
 
@@ -108,6 +202,30 @@
 				VkSemaphoreCreateInfo setup;
 			};
 
+			struct fence
+			{
+				fence();
+
+				void create(const nv::vulkan::device &d);
+
+				void wait(const nv::vulkan::device &d, const uint32_t n);
+
+				void wait_all(const nv::vulkan::device &d);
+
+				void reset(const nv::vulkan::device &d, const uint32_t n);
+
+				bool is_signaled(const nv::vulkan::device &d, const uint32_t n) const;
+
+				void destroy(const nv::vulkan::device &d);
+
+				uint32_t size() const;
+
+				~fence();
+
+				std::vector<VkFence> handle;
+				VkFenceCreateInfo setup;
+			};
+
 			struct surface
 			{
 				surface();
@@ -115,6 +233,8 @@
 				void create(GLFWwindow *w, const nv::vulkan::instance &i,
 				            const nv::vulkan::physical_device &d, const uint32_t index);
 
+				bool update(GLFWwindow *w, const nv::vulkan::physical_device &d, const uint32_t index);
+
 				uint32_t image_count() const;
 
 				void destroy(const nv::vulkan::instance &i);
@@ -136,32 +256,78 @@
 
 				void create(const nv::vulkan::device &d, const nv::vulkan::surface &s);
 
+				VkResult acquire(const nv::vulkan::device &d, VkSemaphore s, uint32_t &n);
+
+				VkResult present(VkQueue q, VkSemaphore s, const uint32_t n);
+
 				void destroy(const nv::vulkan::device &d);
 
 				~swapchain();
 
 				VkSwapchainKHR handle;
+				VkPresentInfoKHR info;
 				VkSwapchainCreateInfoKHR setup;
 				VkAttachmentReference reference;
 				VkAttachmentDescription attachment;
 			};
 
+			// NOTE: a forward declaration of struct allocation and struct allocator
+			// (see memory.hpp) for the offscreen images of struct image.
+			struct allocation;
+			struct allocator;
+			struct buffer;
+
 			struct image
 			{
 				image();
 
 				void create(const nv::vulkan::device &d, const nv::vulkan::swapchain &c);
 
+				// NOTE: transient attachments prefer lazily allocated memory, which
+				// tile-based GPUs never commit when the content stays on chip.
+				void create(const nv::vulkan::device &d, nv::vulkan::allocator &a,
+				            const VkExtent2D &extent, const VkFormat format, const uint32_t count,
+				            const VkImageUsageFlags usage);
+
+				void read(const nv::vulkan::command_buffer &cb, const uint32_t n,
+				          const uint32_t m, const nv::vulkan::buffer &b) const;
+
 				void destroy(const nv::vulkan::device &d);
 
+				void destroy(const nv::vulkan::device &d, nv::vulkan::allocator &a);
+
 				uint32_t size() const;
 
+				// NOTE: the aspects of a format, e.g. depth and stencil ones.
+				static VkImageAspectFlags aspect(const VkFormat format);
+
 				~image();
 
 				VkExtent2D resolution;
 				std::vector<VkImage> handle;
 				std::vector<VkImageView> view;
 				VkImageViewCreateInfo setup;
+
+				// NOTE: images owned by this instance (i.e. not by a swapchain) and
+				// their memory, empty otherwise.
+				VkImageCreateInfo creation;
+				std::vector<nv::vulkan::allocation> memory;
+			};
+
+			struct buffer
+			{
+				buffer();
+
+				void create(const nv::vulkan::device &d, const VkDeviceSize size,
+				            const VkBufferUsageFlags usage);
+
+				void destroy(const nv::vulkan::device &d);
+
+				~buffer();
+
+				VkBuffer handle;
+				VkBufferCreateInfo setup;
+				VkMemoryRequirements requirements;
 			};
 
 			struct shader_module
@@ -178,45 +344,90 @@
 
 				~shader_module();
 
-				VkShaderModule handle;
-				std::vector<char> spirv;
+				// NOTE: no handle, the modules of the pipelines made of this code
+				// come from the nv::vulkan::module_cache of their device.
+				std::shared_ptr<const nv::vulkan::spirv> code;
 				VkShaderStageFlagBits usage;
-				VkShaderModuleCreateInfo setup;
 				VkPipelineLayoutCreateInfo info;
-				VkSpecializationInfo constants;
+				nv::vulkan::specialization constants;
 			};
 
-			// NOTE: a forward declaration of struct framebuffer for the struct render_pass.
+			// NOTE: forward declarations of struct framebuffer and struct profiler
+			// for the struct render_pass.
 			struct framebuffer;
+			struct profiler;
 
 			struct render_pass
 			{
 				render_pass();
 
-				void create(const nv::vulkan::device &d, const nv::vulkan::swapchain &c);
+				// NOTE: with a depth format, a depth attachment follows the color one,
+				// cleared at the beginning of the pass and never stored.
+				void create(const nv::vulkan::device &d, const nv::vulkan::swapchain &c,
+				            const VkFormat depth = VK_FORMAT_UNDEFINED);
+
+				void create(const nv::vulkan::device &d, const VkFormat format, const VkImageLayout layout,
+				            const VkFormat depth = VK_FORMAT_UNDEFINED);
+
+				// NOTE: a single subpass of the given color attachments, followed by
+				// a depth one if there is one more, and without any dependency: the
+				// layouts are expected to be right before and after the pass, which
+				// keeps them, e.g. by pipeline barriers (see graph.hpp).
+				void create(const nv::vulkan::device &d, const std::vector<VkAttachmentDescription> &attachment,
+				            const uint32_t color_count);
 
 				void begin(nv::vulkan::command_buffer &cb,
 				           nv::vulkan::framebuffer &fb);
 
+				// NOTE: with a profiler, the pass is timed as a scope of that name,
+				// the query pool of slot n being reset right before it.
+				void begin(nv::vulkan::command_buffer &cb, const uint32_t n,
+				           const nv::vulkan::framebuffer &fb, const uint32_t m,
+				           const VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE,
+				           nv::vulkan::profiler *p = nullptr);
+
 				void end(nv::vulkan::command_buffer &cb);
 
+				void end(nv::vulkan::command_buffer &cb, const uint32_t n,
+				         nv::vulkan::profiler *p = nullptr);
+
 				void destroy(const nv::vulkan::device &d);
 
 				~render_pass();
 
+				void use_depth(const VkAttachmentDescription &color, const VkFormat depth);
+
 				VkRenderPass handle;
+				VkClearValue clear;
+				VkAttachmentReference reference;
+				VkAttachmentDescription attachment;
+				VkSubpassDependency dependency;
 				VkSubpassDescription info;
 				VkRenderPassCreateInfo setup;
 				VkRenderPassBeginInfo startup;
+				const char *name;
+				uint32_t scope;
+
+				// NOTE: the attachments of a render pass of many, and their clear
+				// values, in the same order.
+				std::vector<VkAttachmentDescription> attachments;
+				std::vector<VkAttachmentReference> references;
+				std::vector<VkClearValue> clears;
 			};
 
 			struct framebuffer
 			{
 				framebuffer();
 
+				// NOTE: the same depth view, if any, for every image.
 				void create(const nv::vulkan::device &d,
 				            const nv::vulkan::image &i,
-				            nv::vulkan::render_pass &p);
+				            nv::vulkan::render_pass &p,
+				            VkImageView depth = VK_NULL_HANDLE);
+
+				// NOTE: one more framebuffer, of many attachments.
+				void create(const nv::vulkan::device &d, nv::vulkan::render_pass &p,
+				            const VkImageView *views, const uint32_t count, const VkExtent2D &extent);
 
 				uint32_t size() const;
 
@@ -228,6 +439,24 @@
 				VkFramebufferCreateInfo setup;
 			};
 
+			// NOTE: the handles of a swapchain replaced by a newer one, which must
+			// outlive every frame that was submitted before the replacement.
+
+			struct retired_swapchain
+			{
+				retired_swapchain();
+
+				void take(nv::vulkan::swapchain &c, nv::vulkan::image &i, nv::vulkan::framebuffer &f);
+
+				void destroy(const nv::vulkan::device &d);
+
+				~retired_swapchain();
+
+				VkSwapchainKHR handle;
+				std::vector<VkImageView> view;
+				std::vector<VkFramebuffer> frame;
+			};
+
 			struct viewport
 			{
 				viewport();
@@ -280,16 +509,47 @@
 			{
 				layout();
 
+				// NOTE: the n-th set layout added is the one of set n.
+				void add(VkDescriptorSetLayout l);
+
+				void add(const VkShaderStageFlags stages, const uint32_t offset, const uint32_t size);
+
 				void create(const nv::vulkan::device &d);
 
+				// NOTE: the handle of a nv::vulkan::pipeline_layout_cache instead, for
+				// the sets and ranges added, which destroy() forgets rather than
+				// destroys.
+				void share(VkPipelineLayout l);
+
 				void destroy(const nv::vulkan::device &d);
 
 				~layout();
 
 				VkPipelineLayout handle;
+				bool shared;
+				std::vector<VkDescriptorSetLayout> sets;
+				std::vector<VkPushConstantRange> ranges;
 				VkPipelineLayoutCreateInfo setup;
 			};
 
+			// NOTE: the values of the states a pipeline sets at every draw when they
+			// are dynamic, as they were when the draw was issued.
+
+			struct draw_state
+			{
+				VkCullModeFlags cull_mode;
+				VkFrontFace front_face;
+				VkPrimitiveTopology topology;
+				VkBool32 depth_test;
+				VkBool32 depth_write;
+				VkCompareOp depth_compare;
+				VkBool32 primitive_restart;
+				uint32_t attachment_count;
+				VkBool32 blend[8];
+
+				bool operator ==(const draw_state &other) const;
+			};
+
 			struct pipeline
 			{
 				pipeline();
@@ -298,6 +558,19 @@
 
 				void add(const nv::vulkan::render_pass &p);
 
+				// NOTE: bindings and locations are numbered after the ones added before.
+				void add(const VkVertexInputBindingDescription *binding, const uint32_t binding_count,
+				         const VkVertexInputAttributeDescription *attribute, const uint32_t attribute_count);
+
+				// NOTE: the locations taken by an attribute of a format, two for the
+				// 64-bit ones of three or four components (dvec3, dvec4).
+				static constexpr uint32_t locations(const VkFormat format)
+				{
+					return ((format == VK_FORMAT_R64G64B64_SFLOAT) || (format == VK_FORMAT_R64G64B64A64_SFLOAT)
+					     || (format == VK_FORMAT_R64G64B64_SINT) || (format == VK_FORMAT_R64G64B64A64_SINT)
+					     || (format == VK_FORMAT_R64G64B64_UINT) || (format == VK_FORMAT_R64G64B64A64_UINT))? 2 : 1;
+				}
+
 				void add(const nv::vulkan::viewport &v);
 
 				void add(const nv::vulkan::rasterizer &r);
@@ -310,9 +583,54 @@
 
 				void add(const nv::vulkan::layout &l);
 
+				void use_dynamic_state(const nv::vulkan::device &d);
+
 				void create(const nv::vulkan::device &d);
 
-				void bind(const nv::vulkan::command_buffer &cb, const uint32_t n);
+				// NOTE: the constants of the n-th stage added. The pipeline handle
+				// becomes the one of the variant with such constants, if created
+				// before, or null until create() makes it. Every variant is kept
+				// until destroy().
+				void specialize(const uint32_t n, const nv::vulkan::specialization &s);
+
+				// NOTE: takes the code, modules, layout and variants of a copy of this
+				// pipeline rebuilt from newer code, whose modules must be released
+				// before. The old variants are appended to old, to be destroyed once
+				// no frame uses them, and the handle becomes the one of the current
+				// constants, or null if that variant is not rebuilt yet.
+				void replace(nv::vulkan::pipeline &rebuilt, std::vector<VkPipeline> &old);
+
+				uint32_t variant_count() const;
+
+				// NOTE: fixes the pointers of the create info, before creation.
+				void prepare();
+
+				// NOTE: the shader modules of every stage, held until release().
+				void acquire(const nv::vulkan::device &d, nv::vulkan::module_cache &c);
+
+				void release(const nv::vulkan::device &d, nv::vulkan::module_cache &c);
+
+				void store_variant();
+
+				bool is_compute() const;
+
+				void bind(const nv::vulkan::command_buffer &cb, const uint32_t n) const;
+
+				// NOTE: a given variant, e.g. the one selected when a draw was queued.
+				void bind(const nv::vulkan::command_buffer &cb, const uint32_t n, VkPipeline variant) const;
+
+				void bind(const nv::vulkan::command_buffer &cb, const uint32_t n,
+				          const VkDescriptorSet *sets, const uint32_t count,
+				          const uint32_t *offsets = nullptr, const uint32_t offset_count = 0) const;
+
+				void push(const nv::vulkan::command_buffer &cb, const uint32_t n,
+				          const VkShaderStageFlags stages, const uint32_t offset,
+				          const uint32_t size, const void *data) const;
+
+				nv::vulkan::draw_state capture() const;
+
+				void apply(const nv::vulkan::device &d, const nv::vulkan::command_buffer &cb, const uint32_t n,
+				           const VkViewport &v, const VkRect2D &scissor, const nv::vulkan::draw_state &s) const;
 
 				void destroy(const nv::vulkan::device &d);
 
@@ -322,9 +640,25 @@
 				VkPipelineCache cache;
 				VkPipelineBindPoint usage;
 				VkGraphicsPipelineCreateInfo setup;
+				VkComputePipelineCreateInfo compute;
 				VkPipelineVertexInputStateCreateInfo input;
+				std::vector<VkVertexInputBindingDescription> bindings;
+				std::vector<VkVertexInputAttributeDescription> attributes;
 				VkPipelineInputAssemblyStateCreateInfo assembly;
+				VkPipelineDynamicStateCreateInfo dynamic;
+				std::vector<VkDynamicState> state;
 				std::vector<VkPipelineShaderStageCreateInfo> stage;
+				std::vector<nv::vulkan::specialization> constants;
+				std::vector<std::shared_ptr<const nv::vulkan::spirv>> code;
+
+				struct variant
+				{
+					uint64_t hash;
+					std::vector<nv::vulkan::specialization> constants;
+					VkPipeline handle;
+				};
+
+				std::vector<variant> variants;
 			};
 		}
 	}
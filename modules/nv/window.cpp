@@ -205,6 +205,94 @@ void nv::window::use_triple_buffer()
 		if (this->surface.mode[n] == VK_PRESENT_MODE_MAILBOX_KHR) this->surface.mode_index = n;
 }
 
+bool nv::window::support_present_mode(const VkPresentModeKHR mode) const
+{
+	for (uint32_t n = 0; n < this->surface.mode.size(); ++n)
+		if (this->surface.mode[n] == mode) return true;
+
+	return false;
+}
+
+bool nv::window::use_present_mode(const VkPresentModeKHR mode)
+{
+	for (uint32_t n = 0; n < this->surface.mode.size(); ++n)
+	{
+		if (this->surface.mode[n] == mode)
+		{
+			this->surface.mode_index = n;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+VkPresentModeKHR nv::window::use_present_policy(const nv::present_policy policy)
+{
+	// NOTE: the first mode supported in order of preference, FIFO being
+	// the last resort as the only mode that every surface supports.
+
+	static const VkPresentModeKHR vsync[] = {VK_PRESENT_MODE_FIFO_KHR};
+
+	static const VkPresentModeKHR low_latency[] = {VK_PRESENT_MODE_MAILBOX_KHR,
+	                                               VK_PRESENT_MODE_FIFO_KHR};
+
+	static const VkPresentModeKHR adaptive[] = {VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+	                                            VK_PRESENT_MODE_FIFO_KHR};
+
+	static const VkPresentModeKHR uncapped[] = {VK_PRESENT_MODE_IMMEDIATE_KHR,
+	                                            VK_PRESENT_MODE_MAILBOX_KHR,
+	                                            VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+	                                            VK_PRESENT_MODE_FIFO_KHR};
+
+	const VkPresentModeKHR *order = vsync;
+	uint32_t count = 1;
+
+	switch (policy)
+	{
+		case NV_PRESENT_LOW_LATENCY:
+			order = low_latency;
+			count = 2;
+			break;
+
+		case NV_PRESENT_ADAPTIVE:
+			order = adaptive;
+			count = 2;
+			break;
+
+		case NV_PRESENT_UNCAPPED:
+			order = uncapped;
+			count = 4;
+			break;
+
+		default:
+			break;
+	}
+
+	for (uint32_t n = 0; n < count; ++n)
+		if (this->use_present_mode(order[n])) return order[n];
+
+	return this->present_mode();
+}
+
+VkPresentModeKHR nv::window::present_mode() const
+{
+	ASSERT(this->surface.mode_index < this->surface.mode.size())
+
+	return this->surface.mode[this->surface.mode_index];
+}
+
+uint32_t nv::window::refresh_rate() const
+{
+	GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+
+	if (monitor == nullptr) return 0;
+
+	const GLFWvidmode *video = glfwGetVideoMode(monitor);
+
+	return (video != nullptr)? static_cast<uint32_t>(video->refreshRate) : 0;
+}
+
 nv::window::~window()
 {
 	if (this->handle != nullptr)
@@ -11,6 +11,16 @@
 	{
 		class renderer;
 
+		// NOTE: from no tearing with frames queued (FIFO), to tearing with the
+		// lowest latency (IMMEDIATE), see nv::window::use_present_policy().
+		enum present_policy
+		{
+			NV_PRESENT_VSYNC,
+			NV_PRESENT_LOW_LATENCY,
+			NV_PRESENT_ADAPTIVE,
+			NV_PRESENT_UNCAPPED
+		};
+
 		class window
 		{
 			public:
@@ -66,11 +76,25 @@
 
 			void use_triple_buffer();
 
+			bool support_present_mode(const VkPresentModeKHR mode) const;
+
+			bool use_present_mode(const VkPresentModeKHR mode);
+
+			// NOTE: to be called before nv::device::renderer_startup(), or followed
+			// by nv::device::renderer_resize() to take effect.
+			VkPresentModeKHR use_present_policy(const nv::present_policy policy);
+
+			VkPresentModeKHR present_mode() const;
+
+			// NOTE: of the primary monitor in Hz, 0 if unknown.
+			uint32_t refresh_rate() const;
+
 			~window();
 
 			friend void nv::device::attach_surface(nv::window &w) const;
 			friend void nv::device::detach_surface(nv::window &w) const;
 			friend void nv::device::renderer_startup(nv::renderer &r, const nv::window &w) const;
+			friend bool nv::device::renderer_resize(nv::renderer &r, nv::window &w) const;
 
 			private:
 			GLFWwindow *handle;
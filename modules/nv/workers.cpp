@@ -0,0 +1,122 @@
+#include "debug.hpp"
+#include "workers.hpp"
+
+nv::workers::workers(const uint32_t n):
+	quit(false),
+	next(0),
+	total(0),
+	finished(0),
+	generation(0),
+	job(nullptr)
+{
+	// NOTE: n = 0 means one thread per core, the calling thread included.
+	const uint32_t count = (n > 0)? n : std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (uint32_t k = 1; k < count; ++k)
+		this->thread.emplace_back(&nv::workers::loop, this);
+}
+
+uint32_t nv::workers::size() const
+{
+	return this->thread.size() + 1;
+}
+
+bool nv::workers::take(const uint64_t g, uint32_t &n)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if ((this->generation != g) || (this->next >= this->total)) return false;
+
+	n = this->next++;
+	return true;
+}
+
+void nv::workers::run(const uint32_t count, const std::function<void(const uint32_t)> &job)
+{
+	if (count == 0) return;
+
+	uint64_t g = 0;
+
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+
+		this->job = &job;
+		this->next = 0;
+		this->total = count;
+		this->finished = 0;
+		g = ++this->generation;
+	}
+
+	this->wake.notify_all();
+
+	uint32_t n = 0;
+	uint32_t counter = 0;
+
+	while (this->take(g, n))
+	{
+		job(n);
+		++counter;
+	}
+
+	std::unique_lock<std::mutex> guard(this->lock);
+
+	this->finished += counter;
+	this->done.wait(guard, [this] { return (this->finished == this->total); });
+
+	this->job = nullptr;
+}
+
+void nv::workers::loop()
+{
+	uint64_t seen = 0;
+
+	while (true)
+	{
+		const std::function<void(const uint32_t)> *batch = nullptr;
+
+		{
+			std::unique_lock<std::mutex> guard(this->lock);
+
+			this->wake.wait(guard, [this, seen] { return this->quit || (this->generation != seen); });
+
+			if (this->quit) return;
+
+			seen = this->generation;
+			batch = this->job;
+		}
+
+		uint32_t n = 0;
+		uint32_t counter = 0;
+
+		// NOTE: the batch stays valid as long as this thread takes its jobs, as
+		// run() waits for all of them.
+
+		while (this->take(seen, n))
+		{
+			(*batch)(n);
+			++counter;
+		}
+
+		if (counter == 0) continue;
+
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->finished += counter;
+		}
+
+		this->done.notify_all();
+	}
+}
+
+nv::workers::~workers()
+{
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->quit = true;
+	}
+
+	this->wake.notify_all();
+
+	for (auto &t : this->thread)
+		t.join();
+}
@@ -0,0 +1,44 @@
+#if !defined(NV_WORKERS_HEADER)
+	#define NV_WORKERS_HEADER
+	#include <mutex>
+	#include <thread>
+	#include <vector>
+	#include <functional>
+	#include <condition_variable>
+
+	namespace nv
+	{
+		// NOTE: a fixed set of threads that run the jobs [0, count) of a single
+		// batch at a time, the calling thread taking jobs as well.
+
+		class workers
+		{
+			public:
+			explicit workers(const uint32_t n = 0);
+
+			uint32_t size() const;
+
+			void run(const uint32_t count, const std::function<void(const uint32_t)> &job);
+
+			~workers();
+
+			private:
+			void loop();
+
+			// NOTE: false once the batch of the given generation has no job left,
+			// or is over, thus a late thread never takes a job of the next one.
+			bool take(const uint64_t g, uint32_t &n);
+
+			bool quit;
+			uint32_t next;
+			uint32_t total;
+			uint32_t finished;
+			uint64_t generation;
+			std::mutex lock;
+			std::condition_variable wake;
+			std::condition_variable done;
+			std::vector<std::thread> thread;
+			const std::function<void(const uint32_t)> *job;
+		};
+	}
+#endif